@@ -0,0 +1,115 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <bson/bson.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * This is a test for comparing the performance of bson_utf8_validate() to
+ * walking the same string one code point at a time with
+ * bson_utf8_get_char() and bson_utf8_next_char().
+ *
+ * Run it on ASCII and on mixed text, for example:
+ *
+ * ./bson-utf8-speed 100000 ascii
+ * ./bson-utf8-speed 100000 mixed
+ */
+
+
+static bool
+validate_per_char (const char *str, size_t len)
+{
+   const char *end = str + len;
+   bson_unichar_t c;
+
+   while (str < end) {
+      c = bson_utf8_get_char (str);
+      if (!c || c > 0x10FFFF) {
+         return false;
+      }
+      str = bson_utf8_next_char (str);
+   }
+
+   return str == end;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+   static const char euro[] = "\xe2\x82\xac";
+   const size_t len = 4096;
+   char *str;
+   size_t i;
+   int n;
+   int j;
+   bool mixed;
+   int64_t start;
+   int64_t validate_usec;
+   int64_t per_char_usec;
+
+   if (argc != 3) {
+      fprintf (stderr,
+               "usage: bson-utf8-speed NUM_ITERATIONS [ascii|mixed]\n"
+               "\n"
+               "  ascii = validate a 4 KB ASCII string\n"
+               "  mixed = validate a 4 KB string with a multibyte character\n"
+               "          every 32 bytes\n"
+               "\n");
+      return EXIT_FAILURE;
+   }
+
+   n = atoi (argv[1]);
+   mixed = !strcmp (argv[2], "mixed");
+
+   str = bson_malloc (len + 1);
+   for (i = 0; i < len; i++) {
+      str[i] = (char) ('a' + i % 26);
+   }
+
+   if (mixed) {
+      for (i = 0; i + 3 <= len; i += 32) {
+         memcpy (str + i, euro, 3);
+      }
+   }
+
+   str[len] = '\0';
+
+   start = bson_get_monotonic_time ();
+   for (j = 0; j < n; j++) {
+      BSON_ASSERT (bson_utf8_validate (str, len, false));
+   }
+   validate_usec = bson_get_monotonic_time () - start;
+
+   start = bson_get_monotonic_time ();
+   for (j = 0; j < n; j++) {
+      BSON_ASSERT (validate_per_char (str, len));
+   }
+   per_char_usec = bson_get_monotonic_time () - start;
+
+   printf ("bson_utf8_validate: %" PRId64 " usec (%.1f MB/s)\n",
+           validate_usec,
+           validate_usec ? (double) len * n / validate_usec : 0.0);
+   printf ("per code point:     %" PRId64 " usec (%.1f MB/s)\n",
+           per_char_usec,
+           per_char_usec ? (double) len * n / per_char_usec : 0.0);
+
+   bson_free (str);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,367 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "bson-arena.h"
+#include "bson-private.h"
+
+
+#define BSON_ARENA_DEFAULT_BLOCK_SIZE 4096
+#define BSON_ARENA_INITIAL_DOC_SIZE 128
+#define BSON_ARENA_ALIGN(_n) (((size_t) (_n) + 7) & ~((size_t) 7))
+#define BSON_ARENA_HEADER_SIZE BSON_ARENA_ALIGN (sizeof (size_t))
+
+
+typedef struct _bson_arena_block_t {
+   struct _bson_arena_block_t *next;
+   size_t size; /* usable bytes following the block header */
+   size_t used; /* bytes handed out from this block */
+} bson_arena_block_t;
+
+
+#define BSON_ARENA_BLOCK_DATA(_b) \
+   (((uint8_t *) (_b)) + BSON_ARENA_ALIGN (sizeof (bson_arena_block_t)))
+
+
+struct _bson_arena_t {
+   size_t block_size;
+   bson_arena_block_t *head;    /* first block, never freed until destroy */
+   bson_arena_block_t *current; /* block allocations are served from */
+   uint8_t *last;               /* header of the most recent allocation */
+};
+
+
+static bson_arena_block_t *
+_bson_arena_block_new (size_t size)
+{
+   bson_arena_block_t *block;
+
+   block = bson_malloc (BSON_ARENA_ALIGN (sizeof *block) + size);
+   block->next = NULL;
+   block->size = size;
+   block->used = 0;
+
+   return block;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_arena_new --
+ *
+ *       Creates a new bson_arena_t that hands out memory from blocks of
+ *       @block_size bytes. Requests larger than @block_size get a block of
+ *       their own. If @block_size is zero a default is used.
+ *
+ * Returns:
+ *       A newly allocated bson_arena_t that should be freed with
+ *       bson_arena_destroy().
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bson_arena_t *
+bson_arena_new (size_t block_size) /* IN */
+{
+   bson_arena_t *arena;
+
+   if (!block_size) {
+      block_size = BSON_ARENA_DEFAULT_BLOCK_SIZE;
+   }
+
+   arena = bson_malloc0 (sizeof *arena);
+   arena->block_size = BSON_ARENA_ALIGN (block_size);
+   arena->head = _bson_arena_block_new (arena->block_size);
+   arena->current = arena->head;
+   arena->last = NULL;
+
+   return arena;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_arena_destroy --
+ *
+ *       Releases every block owned by @arena. Any bson_t or memory obtained
+ *       from @arena is invalid afterwards.
+ *
+ * Returns:
+ *       None.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_arena_destroy (bson_arena_t *arena) /* IN */
+{
+   bson_arena_block_t *block;
+   bson_arena_block_t *next;
+
+   if (!arena) {
+      return;
+   }
+
+   for (block = arena->head; block; block = next) {
+      next = block->next;
+      bson_free (block);
+   }
+
+   bson_free (arena);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_arena_reset --
+ *
+ *       Rewinds @arena so that its blocks are reused by later allocations.
+ *       Blocks are kept, so an arena that has warmed up does not call
+ *       malloc() again. Any bson_t or memory obtained from @arena is
+ *       invalid afterwards.
+ *
+ * Returns:
+ *       None.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_arena_reset (bson_arena_t *arena) /* IN */
+{
+   BSON_ASSERT (arena);
+
+   /* later blocks are rewound lazily, as allocation advances into them */
+   arena->current = arena->head;
+   arena->current->used = 0;
+   arena->last = NULL;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_arena_alloc --
+ *
+ *       Allocates @num_bytes from @arena. The memory is aligned to eight
+ *       bytes and lives until the next bson_arena_reset() or
+ *       bson_arena_destroy().
+ *
+ * Returns:
+ *       A pointer to @num_bytes of uninitialized memory.
+ *
+ * Side effects:
+ *       May allocate a new block.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void *
+bson_arena_alloc (bson_arena_t *arena, /* IN */
+                  size_t num_bytes)    /* IN */
+{
+   bson_arena_block_t *block;
+   bson_arena_block_t *fresh;
+   size_t need;
+   uint8_t *header;
+
+   BSON_ASSERT (arena);
+
+   need = BSON_ARENA_HEADER_SIZE + BSON_ARENA_ALIGN (num_bytes);
+   block = arena->current;
+
+   while (block->used + need > block->size) {
+      if (!block->next) {
+         fresh = _bson_arena_block_new (BSON_MAX (arena->block_size, need));
+         block->next = fresh;
+      }
+
+      block = block->next;
+      block->used = 0;
+   }
+
+   header = BSON_ARENA_BLOCK_DATA (block) + block->used;
+   memcpy (header, &num_bytes, sizeof num_bytes);
+   block->used += need;
+
+   arena->current = block;
+   arena->last = header;
+
+   return header + BSON_ARENA_HEADER_SIZE;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_arena_realloc_ctx --
+ *
+ *       A bson_realloc_func that allocates from the bson_arena_t passed as
+ *       @ctx. The most recent allocation is grown in place when the current
+ *       block has room; otherwise the contents are copied to a new region.
+ *       The old region is not reclaimed until the arena is reset.
+ *
+ * Returns:
+ *       A pointer to at least @num_bytes, or NULL if @num_bytes is zero.
+ *
+ * Side effects:
+ *       May allocate a new block.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void *
+bson_arena_realloc_ctx (void *mem,        /* IN */
+                        size_t num_bytes, /* IN */
+                        void *ctx)        /* IN */
+{
+   bson_arena_t *arena = (bson_arena_t *) ctx;
+   bson_arena_block_t *block;
+   uint8_t *header;
+   size_t old_size;
+   size_t extra;
+   void *ret;
+
+   BSON_ASSERT (arena);
+
+   if (!mem) {
+      return num_bytes ? bson_arena_alloc (arena, num_bytes) : NULL;
+   }
+
+   if (!num_bytes) {
+      return NULL;
+   }
+
+   header = (uint8_t *) mem - BSON_ARENA_HEADER_SIZE;
+   memcpy (&old_size, header, sizeof old_size);
+
+   if (num_bytes <= old_size) {
+      return mem;
+   }
+
+   if (header == arena->last) {
+      block = arena->current;
+      extra = BSON_ARENA_ALIGN (num_bytes) - BSON_ARENA_ALIGN (old_size);
+
+      if (block->used + extra <= block->size) {
+         block->used += extra;
+         memcpy (header, &num_bytes, sizeof num_bytes);
+         return mem;
+      }
+   }
+
+   ret = bson_arena_alloc (arena, num_bytes);
+   memcpy (ret, mem, old_size);
+
+   return ret;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_arena_strdup --
+ *
+ *       Copies @str into memory owned by @arena.
+ *
+ * Returns:
+ *       A copy of @str that lives until the arena is reset, or NULL if
+ *       @str is NULL.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+char *
+bson_arena_strdup (bson_arena_t *arena, /* IN */
+                   const char *str)     /* IN */
+{
+   size_t len;
+   char *ret;
+
+   if (!str) {
+      return NULL;
+   }
+
+   len = strlen (str);
+   ret = bson_arena_alloc (arena, len + 1);
+   memcpy (ret, str, len + 1);
+
+   return ret;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_init_with_arena --
+ *
+ *       Initializes @bson as an empty document whose buffer, and the
+ *       buffers of any child documents appended to it, are allocated
+ *       from @arena. bson_destroy() does not free the buffer; it is
+ *       reclaimed by bson_arena_reset().
+ *
+ * Returns:
+ *       None.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_init_with_arena (bson_t *bson,        /* OUT */
+                      bson_arena_t *arena) /* IN */
+{
+   bson_impl_alloc_t *impl = (bson_impl_alloc_t *) bson;
+
+   BSON_ASSERT (bson);
+   BSON_ASSERT (arena);
+
+   impl->flags = BSON_FLAG_STATIC | BSON_FLAG_NO_FREE;
+   impl->len = 5;
+   impl->parent = NULL;
+   impl->depth = 0;
+   impl->buf = &impl->alloc;
+   impl->buflen = &impl->alloclen;
+   impl->offset = 0;
+   impl->alloclen = BSON_ARENA_INITIAL_DOC_SIZE;
+   impl->alloc = bson_arena_alloc (arena, impl->alloclen);
+   impl->alloc[0] = 5;
+   impl->alloc[1] = 0;
+   impl->alloc[2] = 0;
+   impl->alloc[3] = 0;
+   impl->alloc[4] = 0;
+   impl->realloc = bson_arena_realloc_ctx;
+   impl->realloc_func_ctx = arena;
+}
@@ -39,6 +39,12 @@ struct _bson_context_t {
    void (*oid_set_seq32) (bson_context_t *context, bson_oid_t *oid);
    void (*oid_set_seq64) (bson_context_t *context, bson_oid_t *oid);
 
+   /* returns the first of @n consecutive 32-bit sequence numbers */
+   uint32_t (*oid_reserve_seq32) (bson_context_t *context, uint32_t n);
+
+   /* the fork count when the pid was last checked */
+   int32_t fork_generation;
+
    /* this function pointer allows us to mock gethostname for testing. */
    void (*gethostname) (char *out);
 };
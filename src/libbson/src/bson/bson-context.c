@@ -44,6 +44,29 @@
  */
 static bson_context_t gContextDefault;
 
+/* the number of times this process has been forked, counted in the child */
+static volatile int32_t gForkGeneration;
+static bool gForkHandlerInstalled;
+
+/* sequence numbers a thread reserves at once with BSON_CONTEXT_THREAD_LOCAL */
+#define BSON_CONTEXT_SEQ_BLOCK 256
+
+#if defined(_MSC_VER)
+#define BSON_CONTEXT_TLS __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define BSON_CONTEXT_TLS __thread
+#endif
+
+#ifdef BSON_CONTEXT_TLS
+typedef struct {
+   bson_context_t *context;
+   uint32_t next;
+   uint32_t end;
+} bson_context_seq_block_t;
+
+static BSON_CONTEXT_TLS bson_context_seq_block_t gSeqBlock;
+#endif
+
 static BSON_INLINE uint16_t
 _bson_getpid (void)
 {
@@ -171,6 +194,170 @@ _bson_context_set_oid_seq64_threadsafe (bson_context_t *context, /* IN */
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_context_reserve_seq32 --
+ *
+ *       Reserve @n consecutive 32-bit sequence numbers, non-thread-safe
+ *       version.
+ *
+ * Returns:
+ *       The first sequence number reserved.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static uint32_t
+_bson_context_reserve_seq32 (bson_context_t *context, /* IN */
+                             uint32_t n)              /* IN */
+{
+   uint32_t seq = (uint32_t) context->seq32;
+
+   context->seq32 = (int32_t) (seq + n);
+
+   return seq;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_context_reserve_seq32_threadsafe --
+ *
+ *       Reserve @n consecutive 32-bit sequence numbers, thread-safe
+ *       version.
+ *
+ * Returns:
+ *       The first sequence number reserved.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static uint32_t
+_bson_context_reserve_seq32_threadsafe (bson_context_t *context, /* IN */
+                                        uint32_t n)              /* IN */
+{
+   /* like _bson_context_set_oid_seq32_threadsafe, use the values up to and
+    * including the incremented counter */
+   return (uint32_t) bson_atomic_int_add (&context->seq32, (int32_t) n) - n + 1;
+}
+
+
+#ifdef BSON_CONTEXT_TLS
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_context_reserve_seq32_thread_local --
+ *
+ *       Reserve @n consecutive 32-bit sequence numbers from the calling
+ *       thread's block, refilling the block from the shared counter when
+ *       it runs out. Threads only touch the shared counter once per
+ *       BSON_CONTEXT_SEQ_BLOCK numbers.
+ *
+ * Returns:
+ *       The first sequence number reserved.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static uint32_t
+_bson_context_reserve_seq32_thread_local (bson_context_t *context, /* IN */
+                                          uint32_t n)              /* IN */
+{
+   bson_context_seq_block_t *block = &gSeqBlock;
+   uint32_t seq;
+
+   if (block->context != context || block->end - block->next < n) {
+      if (n > BSON_CONTEXT_SEQ_BLOCK) {
+         return _bson_context_reserve_seq32_threadsafe (context, n);
+      }
+
+      /* the rest of the old block, if any, is skipped */
+      block->context = context;
+      block->next = _bson_context_reserve_seq32_threadsafe (
+         context, BSON_CONTEXT_SEQ_BLOCK);
+      block->end = block->next + BSON_CONTEXT_SEQ_BLOCK;
+   }
+
+   seq = block->next;
+   block->next += n;
+
+   return seq;
+}
+
+
+static void
+_bson_context_set_oid_seq32_thread_local (bson_context_t *context, /* IN */
+                                          bson_oid_t *oid)         /* OUT */
+{
+   uint32_t seq = _bson_context_reserve_seq32_thread_local (context, 1);
+
+   seq = BSON_UINT32_TO_BE (seq);
+   memcpy (&oid->bytes[9], ((uint8_t *) &seq) + 1, 3);
+}
+#endif
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_context_may_have_forked --
+ *
+ *       Whether the process may have forked since @context last checked
+ *       its pid. getpid() is a system call on most platforms, so where
+ *       pthread_atfork() is available, only check after a fork.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static BSON_INLINE bool
+_bson_context_may_have_forked (bson_context_t *context) /* IN */
+{
+   int32_t generation;
+
+   if (!gForkHandlerInstalled) {
+      return true;
+   }
+
+   generation = gForkGeneration;
+
+   if (context->fork_generation == generation) {
+      return false;
+   }
+
+   context->fork_generation = generation;
+
+   return true;
+}
+
+
+#ifdef BSON_OS_UNIX
+static void
+_bson_context_atfork_child (void)
+{
+   gForkGeneration++;
+}
+
+
+static BSON_ONCE_FUN (_bson_context_install_fork_handler)
+{
+   gForkHandlerInstalled =
+      (0 == pthread_atfork (NULL, NULL, _bson_context_atfork_child));
+   BSON_ONCE_RETURN;
+}
+#endif
+
+
 static void
 _bson_context_init_random (bson_context_t *context, bool init_sequence);
 
@@ -195,7 +382,8 @@ _bson_context_set_oid_rand (bson_context_t *context, bson_oid_t *oid)
    BSON_ASSERT (context);
    BSON_ASSERT (oid);
 
-   if (context->flags & BSON_CONTEXT_DISABLE_PID_CACHE) {
+   if ((context->flags & BSON_CONTEXT_DISABLE_PID_CACHE) &&
+       _bson_context_may_have_forked (context)) {
       uint16_t pid = _bson_getpid ();
 
       if (pid != context->pid) {
@@ -322,16 +510,32 @@ _bson_context_init_random (bson_context_t *context, bool init_sequence)
 static void
 _bson_context_init (bson_context_t *context, bson_context_flags_t flags)
 {
+#ifdef BSON_OS_UNIX
+   static bson_once_t once = BSON_ONCE_INIT;
+
+   bson_once (&once, _bson_context_install_fork_handler);
+#endif
+
    context->flags = (int) flags;
    context->oid_set_seq32 = _bson_context_set_oid_seq32;
    context->oid_set_seq64 = _bson_context_set_oid_seq64;
+   context->oid_reserve_seq32 = _bson_context_reserve_seq32;
    context->gethostname = _bson_context_get_hostname;
 
-   if ((flags & BSON_CONTEXT_THREAD_SAFE)) {
+   if ((flags & (BSON_CONTEXT_THREAD_SAFE | BSON_CONTEXT_THREAD_LOCAL))) {
       context->oid_set_seq32 = _bson_context_set_oid_seq32_threadsafe;
       context->oid_set_seq64 = _bson_context_set_oid_seq64_threadsafe;
+      context->oid_reserve_seq32 = _bson_context_reserve_seq32_threadsafe;
    }
 
+#ifdef BSON_CONTEXT_TLS
+   if ((flags & BSON_CONTEXT_THREAD_LOCAL)) {
+      context->oid_set_seq32 = _bson_context_set_oid_seq32_thread_local;
+      context->oid_reserve_seq32 = _bson_context_reserve_seq32_thread_local;
+   }
+#endif
+
+   context->fork_generation = gForkGeneration;
    context->pid = _bson_getpid ();
    _bson_context_init_random (context, true);
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bson-prelude.h"
+
+
+#ifndef BSON_DTOA_PRIVATE_H
+#define BSON_DTOA_PRIVATE_H
+
+
+#include "bson-compat.h"
+#include "bson-macros.h"
+
+
+BSON_BEGIN_DECLS
+
+
+/* large enough for any finite double formatted by _bson_dtoa */
+#define BSON_DTOA_BUFSIZE 32
+
+
+/**
+ * _bson_dtoa:
+ * @d: A finite double.
+ * @buf: A buffer of at least BSON_DTOA_BUFSIZE bytes.
+ *
+ * Writes the shortest decimal string that reads back as @d, laid out like
+ * printf's "%.20g": positional notation for decimal exponents from -5 to 19,
+ * otherwise scientific with at least two exponent digits, e.g. "1e+99".
+ *
+ * Returns the length of the NUL-terminated string written to @buf.
+ */
+size_t
+_bson_dtoa (double d, char *buf);
+
+/**
+ * _bson_strtod_fast:
+ * @str: A string, not necessarily NUL-terminated.
+ * @len: The length of @str.
+ * @out: A location for the parsed value.
+ *
+ * Parses a plain JSON number of the form -?[0-9]+(.[0-9]*)?([eE][+-]?[0-9]+)?
+ * when its value can be computed exactly with a single floating-point
+ * multiply or divide. This is independent of the C locale.
+ *
+ * Returns true if @out was set, or false if the caller must fall back to
+ * strtod().
+ */
+bool
+_bson_strtod_fast (const char *str, size_t len, double *out);
+
+/**
+ * _bson_strtoll_fast:
+ * @str: A string, not necessarily NUL-terminated.
+ * @len: The length of @str.
+ * @out: A location for the parsed value.
+ *
+ * Parses a plain decimal integer, -?[0-9]{1,18}, that cannot overflow.
+ *
+ * Returns true if @out was set, or false if the caller must fall back to
+ * bson_ascii_strtoll().
+ */
+bool
+_bson_strtoll_fast (const char *str, size_t len, int64_t *out);
+
+
+BSON_END_DECLS
+
+
+#endif /* BSON_DTOA_PRIVATE_H */
@@ -0,0 +1,600 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <float.h>
+#include <string.h>
+
+#include "bson-dtoa-private.h"
+
+
+/*
+ * Double to string conversion with Florian Loitsch's Grisu2 algorithm,
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers",
+ * PLDI 2010. The output always reads back as the same double and is the
+ * shortest such string for all but a tiny fraction of inputs, where it may
+ * have one digit more than necessary.
+ */
+
+#define BSON_DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define BSON_DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define BSON_DP_HIDDEN_BIT 0x0010000000000000ULL
+#define BSON_DP_SIGN_BIT 0x8000000000000000ULL
+#define BSON_DP_EXPONENT_BIAS (0x3FF + 52)
+
+
+typedef struct {
+   uint64_t f;
+   int e;
+} bson_diy_fp_t;
+
+
+/* normalized 64-bit approximations of 10^-348, 10^-340, ..., 10^340 */
+static const bson_diy_fp_t gCachedPowers[] = {
+   {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193},
+   {0x8b16fb203055ac76ULL, -1166}, {0xcf42894a5dce35eaULL, -1140},
+   {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+   {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034},
+   {0xbe5691ef416bd60cULL, -1007}, {0x8dd01fad907ffc3cULL, -980},
+   {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+   {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874},
+   {0x823c12795db6ce57ULL, -847}, {0xc21094364dfb5637ULL, -821},
+   {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+   {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715},
+   {0xb23867fb2a35b28eULL, -688}, {0x84c8d4dfd2c63f3bULL, -661},
+   {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+   {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555},
+   {0xf3e2f893dec3f126ULL, -529}, {0xb5b5ada8aaff80b8ULL, -502},
+   {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+   {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396},
+   {0xa6dfbd9fb8e5b88fULL, -369}, {0xf8a95fcf88747d94ULL, -343},
+   {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+   {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236},
+   {0xe45c10c42a2b3b06ULL, -210}, {0xaa242499697392d3ULL, -183},
+   {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+   {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77},
+   {0x9c40000000000000ULL, -50}, {0xe8d4a51000000000ULL, -24},
+   {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+   {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83},
+   {0xd5d238a4abe98068ULL, 109}, {0x9f4f2726179a2245ULL, 136},
+   {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+   {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242},
+   {0x924d692ca61be758ULL, 269}, {0xda01ee641a708deaULL, 295},
+   {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+   {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402},
+   {0xc83553c5c8965d3dULL, 428}, {0x952ab45cfa97a0b3ULL, 455},
+   {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+   {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561},
+   {0x88fcf317f22241e2ULL, 588}, {0xcc20ce9bd35c78a5ULL, 614},
+   {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+   {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720},
+   {0xbb764c4ca7a44410ULL, 747}, {0x8bab8eefb6409c1aULL, 774},
+   {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+   {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880},
+   {0x80444b5e7aa7cf85ULL, 907}, {0xbf21e44003acdd2dULL, 933},
+   {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+   {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039},
+   {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+
+static const uint64_t gPow10[] = {1ULL,
+                                  10ULL,
+                                  100ULL,
+                                  1000ULL,
+                                  10000ULL,
+                                  100000ULL,
+                                  1000000ULL,
+                                  10000000ULL,
+                                  100000000ULL,
+                                  1000000000ULL,
+                                  10000000000ULL,
+                                  100000000000ULL,
+                                  1000000000000ULL,
+                                  10000000000000ULL,
+                                  100000000000000ULL,
+                                  1000000000000000ULL,
+                                  10000000000000000ULL,
+                                  100000000000000000ULL,
+                                  1000000000000000000ULL,
+                                  10000000000000000000ULL};
+
+
+static BSON_INLINE bson_diy_fp_t
+_bson_diy_fp (uint64_t f, int e)
+{
+   bson_diy_fp_t r;
+
+   r.f = f;
+   r.e = e;
+
+   return r;
+}
+
+
+/* the product's upper 64 bits, rounded */
+static BSON_INLINE bson_diy_fp_t
+_bson_diy_fp_mul (bson_diy_fp_t x, bson_diy_fp_t y)
+{
+   const uint64_t m32 = 0xFFFFFFFFULL;
+   uint64_t a = x.f >> 32;
+   uint64_t b = x.f & m32;
+   uint64_t c = y.f >> 32;
+   uint64_t d = y.f & m32;
+   uint64_t ac = a * c;
+   uint64_t bc = b * c;
+   uint64_t ad = a * d;
+   uint64_t bd = b * d;
+   uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+
+   tmp += 1ULL << 31;
+
+   return _bson_diy_fp (ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+                        x.e + y.e + 64);
+}
+
+
+static BSON_INLINE bson_diy_fp_t
+_bson_diy_fp_normalize (bson_diy_fp_t x)
+{
+   while (!(x.f & BSON_DP_SIGN_BIT)) {
+      x.f <<= 1;
+      x.e--;
+   }
+
+   return x;
+}
+
+
+/* the upper and lower boundaries of the interval of decimals that round to
+ * @v, both with the binary exponent of the normalized upper boundary */
+static void
+_bson_diy_fp_boundaries (bson_diy_fp_t v,
+                         bson_diy_fp_t *minus,
+                         bson_diy_fp_t *plus)
+{
+   bson_diy_fp_t pl = _bson_diy_fp ((v.f << 1) + 1, v.e - 1);
+   bson_diy_fp_t mi;
+
+   while (!(pl.f & (BSON_DP_HIDDEN_BIT << 1))) {
+      pl.f <<= 1;
+      pl.e--;
+   }
+
+   pl.f <<= 10;
+   pl.e -= 10;
+
+   /* the gap below a power of two is half as wide */
+   if (v.f == BSON_DP_HIDDEN_BIT) {
+      mi = _bson_diy_fp ((v.f << 2) - 1, v.e - 2);
+   } else {
+      mi = _bson_diy_fp ((v.f << 1) - 1, v.e - 1);
+   }
+
+   mi.f <<= mi.e - pl.e;
+   mi.e = pl.e;
+
+   *minus = mi;
+   *plus = pl;
+}
+
+
+/* a cached power c = 10^-K such that e + c.e lands in [-60, -32] */
+static bson_diy_fp_t
+_bson_cached_power (int e, int *K)
+{
+   double dk = (-61 - e) * 0.30102999566398114 + 347;
+   int k = (int) dk;
+   unsigned index;
+
+   if (dk - k > 0.0) {
+      k++;
+   }
+
+   index = (unsigned) ((k >> 3) + 1);
+   *K = -(-348 + (int) (index << 3));
+
+   return gCachedPowers[index];
+}
+
+
+static BSON_INLINE void
+_bson_grisu_round (char *buf,
+                   int len,
+                   uint64_t delta,
+                   uint64_t rest,
+                   uint64_t ten_kappa,
+                   uint64_t wp_w)
+{
+   while (rest < wp_w && delta - rest >= ten_kappa &&
+          (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+      buf[len - 1]--;
+      rest += ten_kappa;
+   }
+}
+
+
+static BSON_INLINE int
+_bson_count_digits (uint32_t n)
+{
+   int i;
+
+   for (i = 1; i < 10; i++) {
+      if (n < gPow10[i]) {
+         return i;
+      }
+   }
+
+   return 10;
+}
+
+
+static void
+_bson_grisu_digits (bson_diy_fp_t w,
+                    bson_diy_fp_t mp,
+                    uint64_t delta,
+                    char *buf,
+                    int *len,
+                    int *K)
+{
+   const bson_diy_fp_t one = _bson_diy_fp (1ULL << -mp.e, mp.e);
+   const uint64_t wp_w = mp.f - w.f;
+   uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+   uint64_t p2 = mp.f & (one.f - 1);
+   int kappa = _bson_count_digits (p1);
+   uint32_t d;
+   uint64_t rest;
+
+   *len = 0;
+
+   /* integral part */
+   while (kappa > 0) {
+      d = p1 / (uint32_t) gPow10[kappa - 1];
+      p1 %= (uint32_t) gPow10[kappa - 1];
+
+      if (d || *len) {
+         buf[(*len)++] = (char) ('0' + d);
+      }
+
+      kappa--;
+      rest = ((uint64_t) p1 << -one.e) + p2;
+
+      if (rest <= delta) {
+         *K += kappa;
+         _bson_grisu_round (
+            buf, *len, delta, rest, gPow10[kappa] << -one.e, wp_w);
+         return;
+      }
+   }
+
+   /* fractional part */
+   for (;;) {
+      p2 *= 10;
+      delta *= 10;
+      d = (uint32_t) (p2 >> -one.e);
+
+      if (d || *len) {
+         buf[(*len)++] = (char) ('0' + d);
+      }
+
+      p2 &= one.f - 1;
+      kappa--;
+
+      if (p2 < delta) {
+         *K += kappa;
+         _bson_grisu_round (buf,
+                            *len,
+                            delta,
+                            p2,
+                            one.f,
+                            -kappa < 20 ? wp_w * gPow10[-kappa] : 0);
+         return;
+      }
+   }
+}
+
+
+/* the digits of positive, finite @bits and the decimal exponent K such that
+ * the value is digits * 10^K */
+static void
+_bson_grisu2 (uint64_t bits, char *buf, int *len, int *K)
+{
+   int biased_e = (int) ((bits & BSON_DP_EXPONENT_MASK) >> 52);
+   uint64_t significand = bits & BSON_DP_SIGNIFICAND_MASK;
+   bson_diy_fp_t v;
+   bson_diy_fp_t w_m;
+   bson_diy_fp_t w_p;
+   bson_diy_fp_t c_mk;
+   bson_diy_fp_t w;
+
+   if (biased_e) {
+      v = _bson_diy_fp (significand + BSON_DP_HIDDEN_BIT,
+                        biased_e - BSON_DP_EXPONENT_BIAS);
+   } else {
+      v = _bson_diy_fp (significand, 1 - BSON_DP_EXPONENT_BIAS);
+   }
+
+   _bson_diy_fp_boundaries (v, &w_m, &w_p);
+   c_mk = _bson_cached_power (w_p.e, K);
+
+   w = _bson_diy_fp_mul (_bson_diy_fp_normalize (v), c_mk);
+   w_p = _bson_diy_fp_mul (w_p, c_mk);
+   w_m = _bson_diy_fp_mul (w_m, c_mk);
+
+   /* stay strictly inside the rounding interval despite the imprecise
+    * cached power */
+   w_m.f++;
+   w_p.f--;
+
+   _bson_grisu_digits (w, w_p, w_p.f - w_m.f, buf, len, K);
+}
+
+
+size_t
+_bson_dtoa (double d, char *buf)
+{
+   char digits[20];
+   char *p = buf;
+   uint64_t bits;
+   int len;
+   int K;
+   int x;
+   int i;
+
+   memcpy (&bits, &d, sizeof bits);
+
+   if (bits & BSON_DP_SIGN_BIT) {
+      *p++ = '-';
+      bits &= ~BSON_DP_SIGN_BIT;
+   }
+
+   if (bits == 0) {
+      *p++ = '0';
+      *p = '\0';
+      return (size_t) (p - buf);
+   }
+
+   _bson_grisu2 (bits, digits, &len, &K);
+
+   /* the decimal exponent of the first digit */
+   x = len + K - 1;
+
+   if (x < -4 || x >= 20) {
+      *p++ = digits[0];
+
+      if (len > 1) {
+         *p++ = '.';
+         memcpy (p, digits + 1, (size_t) len - 1);
+         p += len - 1;
+      }
+
+      *p++ = 'e';
+      if (x < 0) {
+         *p++ = '-';
+         x = -x;
+      } else {
+         *p++ = '+';
+      }
+
+      if (x >= 100) {
+         *p++ = (char) ('0' + x / 100);
+         x %= 100;
+      }
+
+      *p++ = (char) ('0' + x / 10);
+      *p++ = (char) ('0' + x % 10);
+   } else if (x >= 0) {
+      if (len <= x + 1) {
+         /* an integer, pad with zeros */
+         memcpy (p, digits, (size_t) len);
+         p += len;
+
+         for (i = len; i <= x; i++) {
+            *p++ = '0';
+         }
+      } else {
+         memcpy (p, digits, (size_t) x + 1);
+         p += x + 1;
+         *p++ = '.';
+         memcpy (p, digits + x + 1, (size_t) (len - x - 1));
+         p += len - x - 1;
+      }
+   } else {
+      *p++ = '0';
+      *p++ = '.';
+
+      for (i = -1; i > x; i--) {
+         *p++ = '0';
+      }
+
+      memcpy (p, digits, (size_t) len);
+      p += len;
+   }
+
+   *p = '\0';
+
+   return (size_t) (p - buf);
+}
+
+
+/*
+ * The fast path of string to double conversion from William Clinger, "How to
+ * Read Floating Point Numbers Accurately", PLDI 1990: when the decimal
+ * significand and the power of ten are both exactly representable, one IEEE
+ * multiply or divide gives the correctly rounded result. This only holds if
+ * the FPU rounds each operation to double precision, which x87 code with
+ * FLT_EVAL_METHOD == 2 does not.
+ */
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0 || FLT_EVAL_METHOD == 1)
+#define BSON_HAVE_EXACT_DOUBLE_MATH 1
+#endif
+
+#define BSON_MAX_EXACT_INT 9007199254740992ULL /* 2^53 */
+
+static const double gExactPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22};
+
+
+bool
+_bson_strtod_fast (const char *str, size_t len, double *out)
+{
+#ifdef BSON_HAVE_EXACT_DOUBLE_MATH
+   const char *p = str;
+   const char *end = str + len;
+   uint64_t mantissa = 0;
+   int ndigits = 0;
+   int exp10 = 0;
+   int e = 0;
+   bool neg = false;
+   bool eneg = false;
+   double v;
+
+   if (p < end && *p == '-') {
+      neg = true;
+      p++;
+   }
+
+   if (p == end || *p < '0' || *p > '9') {
+      return false;
+   }
+
+   for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (mantissa == 0 && *p == '0') {
+         continue;
+      }
+
+      if (++ndigits > 19) {
+         return false;
+      }
+
+      mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+   }
+
+   if (p < end && *p == '.') {
+      for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+         exp10--;
+
+         if (mantissa == 0 && *p == '0') {
+            continue;
+         }
+
+         if (++ndigits > 19) {
+            return false;
+         }
+
+         mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+      }
+   }
+
+   if (p < end && (*p == 'e' || *p == 'E')) {
+      p++;
+
+      if (p < end && (*p == '-' || *p == '+')) {
+         eneg = *p == '-';
+         p++;
+      }
+
+      if (p == end || *p < '0' || *p > '9') {
+         return false;
+      }
+
+      for (; p < end && *p >= '0' && *p <= '9'; p++) {
+         e = e * 10 + (*p - '0');
+
+         if (e > 1000) {
+            return false;
+         }
+      }
+
+      exp10 += eneg ? -e : e;
+   }
+
+   if (p != end) {
+      return false;
+   }
+
+   if (mantissa == 0) {
+      *out = neg ? -0.0 : 0.0;
+      return true;
+   }
+
+   if (mantissa > BSON_MAX_EXACT_INT) {
+      return false;
+   }
+
+   if (exp10 < 0) {
+      if (exp10 < -22) {
+         return false;
+      }
+
+      v = (double) mantissa / gExactPow10[-exp10];
+   } else if (exp10 <= 22) {
+      v = (double) mantissa * gExactPow10[exp10];
+   } else {
+      /* e.g. 12e30: move exponent into the significand while it stays
+       * exact, as 12000000000e22 */
+      for (; exp10 > 22; exp10--) {
+         mantissa *= 10;
+
+         if (mantissa > BSON_MAX_EXACT_INT) {
+            return false;
+         }
+      }
+
+      v = (double) mantissa * gExactPow10[22];
+   }
+
+   *out = neg ? -v : v;
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+
+bool
+_bson_strtoll_fast (const char *str, size_t len, int64_t *out)
+{
+   const char *p = str;
+   const char *end = str + len;
+   int64_t v = 0;
+   bool neg = false;
+
+   if (p < end && *p == '-') {
+      neg = true;
+      p++;
+   }
+
+   /* 18 digits can't overflow */
+   if (p == end || end - p > 18) {
+      return false;
+   }
+
+   for (; p < end; p++) {
+      if (*p < '0' || *p > '9') {
+         return false;
+      }
+
+      v = v * 10 + (*p - '0');
+   }
+
+   *out = neg ? -v : v;
+
+   return true;
+}
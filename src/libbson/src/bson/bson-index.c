@@ -0,0 +1,310 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "bson-index.h"
+#include "bson-private.h"
+
+
+#define BSON_INDEX_INITIAL_SLOTS 16
+
+typedef struct {
+   uint32_t hash;
+   uint32_t keylen;
+   uint32_t offset; /* offset of the element, zero if the slot is empty */
+} bson_index_slot_t;
+
+
+struct _bson_index_t {
+   const uint8_t *data;
+   uint32_t len;
+   uint32_t count;
+   uint32_t mask; /* number of slots minus one, a power of two */
+   bson_index_slot_t *slots;
+   bson_index_slot_t inline_slots[BSON_INDEX_INITIAL_SLOTS];
+};
+
+
+/* FNV-1a */
+static BSON_INLINE uint32_t
+_bson_index_hash (const char *key, uint32_t keylen)
+{
+   uint32_t hash = 2166136261u;
+   uint32_t i;
+
+   for (i = 0; i < keylen; i++) {
+      hash ^= (uint8_t) key[i];
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+
+static const bson_index_slot_t *
+_bson_index_lookup (const bson_index_t *index,
+                    const char *key,
+                    uint32_t keylen,
+                    uint32_t hash)
+{
+   const bson_index_slot_t *slot;
+   uint32_t i;
+
+   for (i = hash & index->mask;; i = (i + 1) & index->mask) {
+      slot = &index->slots[i];
+
+      if (!slot->offset) {
+         return slot;
+      }
+
+      /* the key starts just past the element's type byte */
+      if (slot->hash == hash && slot->keylen == keylen &&
+          0 == memcmp (index->data + slot->offset + 1, key, keylen)) {
+         return slot;
+      }
+   }
+}
+
+
+/* double the table and reinsert, keeping the load factor at most one half */
+static void
+_bson_index_grow (bson_index_t *index)
+{
+   bson_index_slot_t *old_slots = index->slots;
+   uint32_t old_n_slots = index->mask + 1;
+   uint32_t i;
+   uint32_t j;
+
+   index->mask = 2 * old_n_slots - 1;
+   index->slots = bson_malloc0 (2 * old_n_slots * sizeof (bson_index_slot_t));
+
+   for (i = 0; i < old_n_slots; i++) {
+      if (!old_slots[i].offset) {
+         continue;
+      }
+
+      for (j = old_slots[i].hash & index->mask; index->slots[j].offset;
+           j = (j + 1) & index->mask) {
+      }
+
+      index->slots[j] = old_slots[i];
+   }
+
+   if (old_slots != index->inline_slots) {
+      bson_free (old_slots);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_index_new --
+ *
+ *       Builds a hash index of the top-level keys of @bson in a single
+ *       pass. If a key appears more than once, the first occurrence is
+ *       indexed, matching bson_iter_find().
+ *
+ * Returns:
+ *       A newly allocated bson_index_t that should be freed with
+ *       bson_index_destroy(), or NULL if @bson is corrupt.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bson_index_t *
+bson_index_new (const bson_t *bson) /* IN */
+{
+   bson_index_slot_t *slot;
+   bson_index_t *index;
+   bson_iter_t iter;
+   uint32_t keylen;
+   uint32_t hash;
+   const char *key;
+
+   BSON_ASSERT (bson);
+
+   if (!bson_iter_init (&iter, bson)) {
+      return NULL;
+   }
+
+   /* small documents fit in the slots allocated along with the index */
+   index = bson_malloc0 (sizeof *index);
+   index->data = bson_get_data (bson);
+   index->len = bson->len;
+   index->count = 0;
+   index->mask = BSON_INDEX_INITIAL_SLOTS - 1;
+   index->slots = index->inline_slots;
+
+   while (bson_iter_next (&iter)) {
+      key = bson_iter_key (&iter);
+      keylen = bson_iter_key_len (&iter);
+      hash = _bson_index_hash (key, keylen);
+      slot = (bson_index_slot_t *) _bson_index_lookup (
+         index, key, keylen, hash);
+
+      if (slot->offset) {
+         /* duplicate key */
+         continue;
+      }
+
+      slot->hash = hash;
+      slot->keylen = keylen;
+      slot->offset = bson_iter_offset (&iter);
+      index->count++;
+
+      if (2 * index->count > index->mask + 1) {
+         _bson_index_grow (index);
+      }
+   }
+
+   if (iter.err_off) {
+      bson_index_destroy (index);
+      return NULL;
+   }
+
+   return index;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_index_destroy --
+ *
+ *       Frees @index. The indexed document is not affected.
+ *
+ * Returns:
+ *       None.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_index_destroy (bson_index_t *index) /* IN */
+{
+   if (index) {
+      if (index->slots != index->inline_slots) {
+         bson_free (index->slots);
+      }
+      bson_free (index);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_index_count --
+ *
+ *       Counts the distinct top-level keys in the indexed document.
+ *
+ * Returns:
+ *       The number of keys.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+uint32_t
+bson_index_count (const bson_index_t *index) /* IN */
+{
+   BSON_ASSERT (index);
+
+   return index->count;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_index_find --
+ *
+ *       Looks up @key in @index and initializes @iter on that field.
+ *
+ * Returns:
+ *       true if @key was found; otherwise false.
+ *
+ * Side effects:
+ *       @iter is initialized if true is returned.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_index_find (const bson_index_t *index, /* IN */
+                 const char *key,           /* IN */
+                 bson_iter_t *iter)         /* OUT */
+{
+   return bson_index_find_w_len (index, key, -1, iter);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_index_find_w_len --
+ *
+ *       Like bson_index_find(), @keylen indicates the length of @key, or
+ *       -1 to determine the length with strlen().
+ *
+ * Returns:
+ *       true if @key was found; otherwise false.
+ *
+ * Side effects:
+ *       @iter is initialized if true is returned.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_index_find_w_len (const bson_index_t *index, /* IN */
+                       const char *key,           /* IN */
+                       int keylen,                /* IN */
+                       bson_iter_t *iter)         /* OUT */
+{
+   const bson_index_slot_t *slot;
+
+   BSON_ASSERT (index);
+   BSON_ASSERT (key);
+   BSON_ASSERT (iter);
+
+   if (keylen < 0) {
+      keylen = (int) strlen (key);
+   }
+
+   slot = _bson_index_lookup (index,
+                              key,
+                              (uint32_t) keylen,
+                              _bson_index_hash (key, (uint32_t) keylen));
+
+   if (!slot->offset) {
+      return false;
+   }
+
+   return bson_iter_init_from_data_at_offset (
+      iter, index->data, index->len, slot->offset, slot->keylen);
+}
@@ -23,6 +23,7 @@
 #include "bson.h"
 #include "bson-config.h"
 #include "bson-json.h"
+#include "bson-dtoa-private.h"
 #include "bson-iso8601-private.h"
 
 #include "common-b64-private.h"
@@ -717,6 +718,10 @@ _bson_json_parse_double (bson_json_reader_t *reader,
                          size_t vlen,
                          double *d)
 {
+   if (_bson_strtod_fast (val, vlen, d)) {
+      return true;
+   }
+
    errno = 0;
    *d = strtod (val, NULL);
 
@@ -797,6 +802,11 @@ _bson_json_read_int64_or_set_error (bson_json_reader_t *reader, /* IN */
    char *endptr = NULL;
 
    _bson_json_read_fixup_key (bson);
+
+   if (_bson_strtoll_fast ((const char *) val, vlen, v64)) {
+      return true;
+   }
+
    errno = 0;
    *v64 = bson_ascii_strtoll ((const char *) val, &endptr, 10);
 
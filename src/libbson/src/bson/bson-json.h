@@ -30,17 +30,39 @@ BSON_BEGIN_DECLS
 typedef struct _bson_json_reader_t bson_json_reader_t;
 
 
+/**
+ * bson_json_writer_t:
+ *
+ * The bson_json_writer_t structure converts a series of BSON documents to
+ * extended JSON and hands the output to a callback in chunks of roughly
+ * chunk_size bytes, so a document is never materialized as one string.
+ */
+typedef struct _bson_json_writer_t bson_json_writer_t;
+
+
 typedef enum {
    BSON_JSON_ERROR_READ_CORRUPT_JS = 1,
    BSON_JSON_ERROR_READ_INVALID_PARAM,
    BSON_JSON_ERROR_READ_CB_FAILURE,
+   BSON_JSON_ERROR_WRITE_CORRUPT_BSON,
+   BSON_JSON_ERROR_WRITE_CB_FAILURE,
 } bson_json_error_code_t;
 
 
+typedef enum {
+   BSON_JSON_MODE_LEGACY,
+   BSON_JSON_MODE_CANONICAL,
+   BSON_JSON_MODE_RELAXED,
+} bson_json_mode_t;
+
+
 typedef ssize_t (*bson_json_reader_cb) (void *handle,
                                         uint8_t *buf,
                                         size_t count);
 typedef void (*bson_json_destroy_cb) (void *handle);
+typedef bool (*bson_json_writer_cb) (void *handle,
+                                     const char *data,
+                                     size_t len);
 
 
 BSON_EXPORT (bson_json_reader_t *)
@@ -65,6 +87,17 @@ BSON_EXPORT (void)
 bson_json_data_reader_ingest (bson_json_reader_t *reader,
                               const uint8_t *data,
                               size_t len);
+BSON_EXPORT (bson_json_writer_t *)
+bson_json_writer_new (void *data,
+                      bson_json_writer_cb cb,
+                      bson_json_mode_t mode,
+                      size_t chunk_size);
+BSON_EXPORT (void)
+bson_json_writer_destroy (bson_json_writer_t *writer);
+BSON_EXPORT (bool)
+bson_json_writer_write (bson_json_writer_t *writer,
+                        const bson_t *bson,
+                        bson_error_t *error);
 
 
 BSON_END_DECLS
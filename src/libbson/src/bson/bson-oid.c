@@ -124,6 +124,63 @@ bson_oid_init (bson_oid_t *oid,         /* OUT */
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_oid_init_n --
+ *
+ *       Generate @n new ObjectIds into @oids, as if by calling
+ *       bson_oid_init() @n times, but reading the clock once and reserving
+ *       the counters from @context in bulk.
+ *
+ * Returns:
+ *       None.
+ *
+ * Side effects:
+ *       @oids is initialized.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_oid_init_n (bson_oid_t *oids,        /* OUT */
+                 size_t n,                /* IN */
+                 bson_context_t *context) /* IN */
+{
+   uint32_t now = (uint32_t) (time (NULL));
+   uint32_t seq;
+   uint32_t chunk;
+   size_t i = 0;
+
+   BSON_ASSERT (oids || !n);
+
+   if (!n) {
+      return;
+   }
+
+   if (!context) {
+      context = bson_context_get_default ();
+   }
+
+   now = BSON_UINT32_TO_BE (now);
+   memcpy (&oids[0].bytes[0], &now, sizeof (now));
+   _bson_context_set_oid_rand (context, &oids[0]);
+
+   while (i < n) {
+      /* the counter is 24 bits, reserve at most a fraction of it at once */
+      chunk = (uint32_t) BSON_MIN (n - i, (size_t) 0x10000);
+      seq = context->oid_reserve_seq32 (context, chunk);
+
+      for (; chunk > 0; chunk--, i++, seq++) {
+         memcpy (&oids[i].bytes[0], &oids[0].bytes[0], 9);
+         oids[i].bytes[9] = (uint8_t) (seq >> 16);
+         oids[i].bytes[10] = (uint8_t) (seq >> 8);
+         oids[i].bytes[11] = (uint8_t) seq;
+      }
+   }
+}
+
+
 void
 bson_oid_init_from_data (bson_oid_t *oid,     /* OUT */
                          const uint8_t *data) /* IN */
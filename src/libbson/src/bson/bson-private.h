@@ -102,6 +102,10 @@ BSON_STATIC_ASSERT2 (impl_alloc_t, sizeof (bson_impl_alloc_t) <= 128);
 
 #define BSON_REGEX_OPTIONS_SORTED "ilmsux"
 
+uint8_t *
+_bson_append_reserve (bson_t *bson, uint32_t n_bytes);
+
+
 BSON_END_DECLS
 
 
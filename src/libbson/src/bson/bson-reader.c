@@ -26,6 +26,10 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifndef BSON_OS_WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "bson-reader.h"
 #include "bson-memory.h"
@@ -34,6 +38,7 @@
 typedef enum {
    BSON_READER_HANDLE = 1,
    BSON_READER_DATA = 2,
+   BSON_READER_MMAP = 3,
 } bson_reader_type_t;
 
 
@@ -68,6 +73,18 @@ typedef struct {
 } bson_reader_data_t;
 
 
+/* a BSON_READER_DATA reader over a read-only mapping of a file */
+typedef struct {
+   bson_reader_data_t data;
+#ifdef BSON_OS_WIN32
+   HANDLE file;
+   HANDLE mapping;
+#endif
+   void *map;
+   size_t map_len;
+} bson_reader_mmap_t;
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -578,7 +595,7 @@ _bson_reader_data_read (bson_reader_data_t *reader, /* IN */
          return NULL;
       }
 
-      if (blen > (int32_t) (reader->length - reader->offset)) {
+      if ((size_t) blen > reader->length - reader->offset) {
          return NULL;
       }
 
@@ -624,6 +641,45 @@ _bson_reader_data_tell (bson_reader_data_t *reader) /* IN */
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_reader_mmap_destroy --
+ *
+ *       Unmap the file mapped by bson_reader_new_from_mmap().
+ *
+ * Returns:
+ *       None.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static void
+_bson_reader_mmap_destroy (bson_reader_mmap_t *reader) /* IN */
+{
+#ifdef BSON_OS_WIN32
+   if (reader->map) {
+      UnmapViewOfFile (reader->map);
+   }
+
+   if (reader->mapping) {
+      CloseHandle (reader->mapping);
+   }
+
+   if (reader->file != INVALID_HANDLE_VALUE) {
+      CloseHandle (reader->file);
+   }
+#else
+   if (reader->map) {
+      munmap (reader->map, reader->map_len);
+   }
+#endif
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -662,6 +718,9 @@ bson_reader_destroy (bson_reader_t *reader) /* IN */
    } break;
    case BSON_READER_DATA:
       break;
+   case BSON_READER_MMAP:
+      _bson_reader_mmap_destroy ((bson_reader_mmap_t *) reader);
+      break;
    default:
       fprintf (stderr, "No such reader type: %02x\n", reader->type);
       break;
@@ -713,6 +772,7 @@ bson_reader_read (bson_reader_t *reader, /* IN */
                                        reached_eof);
 
    case BSON_READER_DATA:
+   case BSON_READER_MMAP:
       return _bson_reader_data_read ((bson_reader_data_t *) reader,
                                      reached_eof);
 
@@ -752,6 +812,7 @@ bson_reader_tell (bson_reader_t *reader) /* IN */
       return _bson_reader_handle_tell ((bson_reader_handle_t *) reader);
 
    case BSON_READER_DATA:
+   case BSON_READER_MMAP:
       return _bson_reader_data_tell ((bson_reader_data_t *) reader);
 
    default:
@@ -809,13 +870,180 @@ bson_reader_new_from_file (const char *path,    /* IN */
 }
 
 
+#ifdef BSON_OS_WIN32
+static void
+_bson_reader_mmap_set_error (bson_error_t *error)
+{
+   char errmsg_buf[BSON_ERROR_BUFFER_SIZE];
+   DWORD err = GetLastError ();
+
+   if (!FormatMessageA (FORMAT_MESSAGE_FROM_SYSTEM |
+                           FORMAT_MESSAGE_IGNORE_INSERTS,
+                        NULL,
+                        err,
+                        0,
+                        errmsg_buf,
+                        sizeof errmsg_buf,
+                        NULL)) {
+      bson_snprintf (errmsg_buf, sizeof errmsg_buf, "error %lu", err);
+   }
+
+   bson_set_error (
+      error, BSON_ERROR_READER, BSON_ERROR_READER_BADFD, "%s", errmsg_buf);
+}
+#else
+static void
+_bson_reader_mmap_set_error (bson_error_t *error)
+{
+   char errmsg_buf[BSON_ERROR_BUFFER_SIZE];
+   char *errmsg;
+
+   errmsg = bson_strerror_r (errno, errmsg_buf, sizeof errmsg_buf);
+   bson_set_error (
+      error, BSON_ERROR_READER, BSON_ERROR_READER_BADFD, "%s", errmsg);
+}
+#endif
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_reader_new_from_mmap --
+ *
+ *       Map the file at @path read-only and read the bson documents it
+ *       contains straight out of the mapping, without copying them
+ *       into a buffer as bson_reader_new_from_file() does.
+ *
+ *       The mapping is advised for sequential access, so the kernel
+ *       reads ahead aggressively and drops pages once they are read.
+ *
+ * Returns:
+ *       A new bson_reader_t if successful, otherwise NULL and
+ *       @error is set. Free the non-NULL result with
+ *       bson_reader_destroy().
+ *
+ * Side effects:
+ *       @error may be set.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bson_reader_t *
+bson_reader_new_from_mmap (const char *path,    /* IN */
+                           bson_error_t *error) /* OUT */
+{
+   /* the empty file has nothing to map */
+   static const uint8_t empty[1] = {0};
+   bson_reader_mmap_t *real;
+#ifdef BSON_OS_WIN32
+   LARGE_INTEGER size;
+#else
+   struct stat st;
+   int fd;
+#endif
+
+   BSON_ASSERT (path);
+
+   real = (bson_reader_mmap_t *) bson_malloc0 (sizeof *real);
+   real->data.type = BSON_READER_MMAP;
+   real->data.data = empty;
+
+#ifdef BSON_OS_WIN32
+   real->file = CreateFileA (path,
+                             GENERIC_READ,
+                             FILE_SHARE_READ,
+                             NULL,
+                             OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN,
+                             NULL);
+
+   if (real->file == INVALID_HANDLE_VALUE || !GetFileSizeEx (real->file, &size)) {
+      goto fail;
+   }
+
+   if ((uint64_t) size.QuadPart > (uint64_t) SIZE_MAX) {
+      SetLastError (ERROR_FILE_TOO_LARGE);
+      goto fail;
+   }
+
+   if (size.QuadPart > 0) {
+      real->mapping =
+         CreateFileMappingA (real->file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (!real->mapping) {
+         goto fail;
+      }
+
+      real->map = MapViewOfFile (real->mapping, FILE_MAP_READ, 0, 0, 0);
+      if (!real->map) {
+         goto fail;
+      }
+
+      real->map_len = (size_t) size.QuadPart;
+   }
+#else
+   fd = open (path, O_RDONLY);
+
+   if (fd == -1) {
+      goto fail;
+   }
+
+   if (fstat (fd, &st) == -1) {
+      close (fd);
+      goto fail;
+   }
+
+   if ((uint64_t) st.st_size > (uint64_t) SIZE_MAX) {
+      close (fd);
+      errno = EFBIG;
+      goto fail;
+   }
+
+   if (st.st_size > 0) {
+      real->map =
+         mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (real->map == MAP_FAILED) {
+         real->map = NULL;
+         close (fd);
+         goto fail;
+      }
+
+      real->map_len = (size_t) st.st_size;
+
+#ifdef MADV_SEQUENTIAL
+      /* only a hint, ignore failure */
+      (void) madvise (real->map, real->map_len, MADV_SEQUENTIAL);
+#endif
+   }
+
+   /* the mapping holds its own reference to the file */
+   close (fd);
+#endif
+
+   if (real->map) {
+      real->data.data = (const uint8_t *) real->map;
+      real->data.length = real->map_len;
+   }
+
+   return (bson_reader_t *) real;
+
+fail:
+   _bson_reader_mmap_set_error (error);
+   _bson_reader_mmap_destroy (real);
+   bson_free (real);
+
+   return NULL;
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
  * bson_reader_reset --
  *
  *       Restore the reader to its initial state. Valid only for readers
- *       created with bson_reader_new_from_data.
+ *       created with bson_reader_new_from_data or
+ *       bson_reader_new_from_mmap.
  *
  *--------------------------------------------------------------------------
  */
@@ -825,10 +1053,50 @@ bson_reader_reset (bson_reader_t *reader)
 {
    bson_reader_data_t *real = (bson_reader_data_t *) reader;
 
-   if (real->type != BSON_READER_DATA) {
+   if (real->type != BSON_READER_DATA && real->type != BSON_READER_MMAP) {
       fprintf (stderr, "Reader type cannot be reset\n");
       return;
    }
 
    real->offset = 0;
 }
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_reader_seek --
+ *
+ *       Move the reader to @offset, which should be the start of a
+ *       document, e.g. a position previously returned by
+ *       bson_reader_tell(). Valid only for readers created with
+ *       bson_reader_new_from_data or bson_reader_new_from_mmap.
+ *
+ * Returns:
+ *       true if successful, false if @offset is past the end of the data
+ *       or the reader cannot seek.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_reader_seek (bson_reader_t *reader, /* IN */
+                  off_t offset)          /* IN */
+{
+   bson_reader_data_t *real = (bson_reader_data_t *) reader;
+
+   BSON_ASSERT (reader);
+
+   if (real->type != BSON_READER_DATA && real->type != BSON_READER_MMAP) {
+      fprintf (stderr, "Reader type cannot seek\n");
+      return false;
+   }
+
+   if (offset < 0 || (uint64_t) offset > (uint64_t) real->length) {
+      return false;
+   }
+
+   real->offset = (size_t) offset;
+
+   return true;
+}
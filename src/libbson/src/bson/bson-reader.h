@@ -97,6 +97,8 @@ BSON_EXPORT (bson_reader_t *)
 bson_reader_new_from_file (const char *path, bson_error_t *error);
 BSON_EXPORT (bson_reader_t *)
 bson_reader_new_from_data (const uint8_t *data, size_t length);
+BSON_EXPORT (bson_reader_t *)
+bson_reader_new_from_mmap (const char *path, bson_error_t *error);
 BSON_EXPORT (void)
 bson_reader_destroy (bson_reader_t *reader);
 BSON_EXPORT (void)
@@ -110,6 +112,8 @@ BSON_EXPORT (off_t)
 bson_reader_tell (bson_reader_t *reader);
 BSON_EXPORT (void)
 bson_reader_reset (bson_reader_t *reader);
+BSON_EXPORT (bool)
+bson_reader_seek (bson_reader_t *reader, off_t offset);
 
 BSON_END_DECLS
 
@@ -0,0 +1,455 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef BSON_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "bson.h"
+#include "bson-stream-index.h"
+#include "common-thread-private.h"
+
+
+/* documents a worker claims at a time */
+#define BSON_STREAM_INDEX_BATCH 64
+
+
+typedef struct {
+   size_t offset;
+   bson_error_t error;
+} bson_stream_index_error_t;
+
+
+struct _bson_stream_index_t {
+   const uint8_t *data;
+   size_t *offsets;
+   size_t count;
+   size_t offsets_alloc;
+   bson_stream_index_error_t *errors;
+   size_t n_errors;
+   size_t errors_alloc;
+};
+
+
+typedef struct {
+   bson_stream_index_t *index;
+   bson_validate_flags_t flags;
+   volatile int64_t next;
+   bson_mutex_t mutex;
+} bson_stream_index_work_t;
+
+
+static void
+_bson_stream_index_add_error (bson_stream_index_t *index,
+                              size_t offset,
+                              const bson_error_t *error)
+{
+   if (index->n_errors == index->errors_alloc) {
+      index->errors_alloc = index->errors_alloc ? index->errors_alloc * 2 : 8;
+      index->errors = bson_realloc (
+         index->errors, index->errors_alloc * sizeof *index->errors);
+   }
+
+   index->errors[index->n_errors].offset = offset;
+   memcpy (&index->errors[index->n_errors].error, error, sizeof *error);
+   index->n_errors++;
+}
+
+
+/*
+ * Read only the length prefixes to find where each document starts. Stops
+ * at the first length that does not fit the buffer, since nothing after it
+ * can be framed, and records that as an error.
+ */
+static void
+_bson_stream_index_frame (bson_stream_index_t *index,
+                          const uint8_t *data,
+                          size_t length)
+{
+   bson_error_t error;
+   size_t offset = 0;
+   int32_t blen;
+
+   while (offset < length) {
+      if (length - offset < 5) {
+         bson_set_error (&error,
+                         BSON_ERROR_INVALID,
+                         BSON_VALIDATE_CORRUPT,
+                         "truncated document at offset %" PRIu64,
+                         (uint64_t) offset);
+         _bson_stream_index_add_error (index, offset, &error);
+         return;
+      }
+
+      memcpy (&blen, data + offset, sizeof blen);
+      blen = BSON_UINT32_FROM_LE (blen);
+
+      if (blen < 5 || (size_t) blen > length - offset) {
+         bson_set_error (&error,
+                         BSON_ERROR_INVALID,
+                         BSON_VALIDATE_CORRUPT,
+                         "invalid document length %d at offset %" PRIu64,
+                         (int) blen,
+                         (uint64_t) offset);
+         _bson_stream_index_add_error (index, offset, &error);
+         return;
+      }
+
+      if (index->count == index->offsets_alloc) {
+         index->offsets_alloc =
+            index->offsets_alloc ? index->offsets_alloc * 2 : 64;
+         index->offsets = bson_realloc (
+            index->offsets, index->offsets_alloc * sizeof *index->offsets);
+      }
+
+      index->offsets[index->count++] = offset;
+      offset += (size_t) blen;
+   }
+}
+
+
+static void
+_bson_stream_index_validate_one (bson_stream_index_work_t *work, size_t i)
+{
+   bson_stream_index_t *index = work->index;
+   size_t offset = index->offsets[i];
+   bson_error_t error;
+   int32_t blen;
+   bson_t b;
+
+   memcpy (&blen, index->data + offset, sizeof blen);
+   blen = BSON_UINT32_FROM_LE (blen);
+
+   if (!bson_init_static (&b, index->data + offset, (uint32_t) blen)) {
+      bson_set_error (&error,
+                      BSON_ERROR_INVALID,
+                      BSON_VALIDATE_CORRUPT,
+                      "corrupt BSON at offset %" PRIu64,
+                      (uint64_t) offset);
+   } else if (bson_validate_with_error (&b, work->flags, &error)) {
+      return;
+   }
+
+   bson_mutex_lock (&work->mutex);
+   _bson_stream_index_add_error (index, offset, &error);
+   bson_mutex_unlock (&work->mutex);
+}
+
+
+static void *
+_bson_stream_index_worker (void *data)
+{
+   bson_stream_index_work_t *work = (bson_stream_index_work_t *) data;
+   size_t count = work->index->count;
+   size_t start;
+   size_t end;
+   size_t i;
+
+   for (;;) {
+      start = (size_t) (bson_atomic_int64_add (&work->next,
+                                               BSON_STREAM_INDEX_BATCH) -
+                        BSON_STREAM_INDEX_BATCH);
+
+      if (start >= count) {
+         break;
+      }
+
+      end = BSON_MIN (start + BSON_STREAM_INDEX_BATCH, count);
+
+      for (i = start; i < end; i++) {
+         _bson_stream_index_validate_one (work, i);
+      }
+   }
+
+   return NULL;
+}
+
+
+static int
+_bson_stream_index_error_cmp (const void *a, const void *b)
+{
+   const bson_stream_index_error_t *ea = (const bson_stream_index_error_t *) a;
+   const bson_stream_index_error_t *eb = (const bson_stream_index_error_t *) b;
+
+   if (ea->offset == eb->offset) {
+      return 0;
+   }
+
+   return ea->offset < eb->offset ? -1 : 1;
+}
+
+
+static uint32_t
+_bson_stream_index_cpu_count (void)
+{
+#if defined(BSON_OS_WIN32)
+   SYSTEM_INFO si;
+
+   GetSystemInfo (&si);
+
+   return si.dwNumberOfProcessors ? (uint32_t) si.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+
+   return ncpu > 0 ? (uint32_t) ncpu : 1;
+#else
+   return 1;
+#endif
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_stream_index_new --
+ *
+ *       Split @data into BSON documents and validate each one with
+ *       bson_validate_with_error() and @flags, using @n_threads threads
+ *       including the calling thread. If @n_threads is 0, one thread per
+ *       online processor is used.
+ *
+ *       Framing stops at the first length prefix that is less than five
+ *       or runs past the end of @data, which is reported as an error at
+ *       that offset.
+ *
+ * Returns:
+ *       A newly allocated bson_stream_index_t that should be freed with
+ *       bson_stream_index_destroy().
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bson_stream_index_t *
+bson_stream_index_new (const uint8_t *data,         /* IN */
+                       size_t length,               /* IN */
+                       bson_validate_flags_t flags, /* IN */
+                       uint32_t n_threads)          /* IN */
+{
+   bson_stream_index_t *index;
+   bson_stream_index_work_t work;
+   bson_thread_t *threads;
+   uint32_t n_spawned = 0;
+   uint32_t i;
+
+   BSON_ASSERT (data || !length);
+
+   index = bson_malloc0 (sizeof *index);
+   index->data = data;
+
+   _bson_stream_index_frame (index, data, length);
+
+   if (!n_threads) {
+      n_threads = _bson_stream_index_cpu_count ();
+   }
+
+   /* no more threads than batches */
+   if ((size_t) n_threads >
+       (index->count + BSON_STREAM_INDEX_BATCH - 1) / BSON_STREAM_INDEX_BATCH) {
+      n_threads = (uint32_t) ((index->count + BSON_STREAM_INDEX_BATCH - 1) /
+                              BSON_STREAM_INDEX_BATCH);
+   }
+
+   work.index = index;
+   work.flags = flags;
+   work.next = 0;
+   bson_mutex_init (&work.mutex);
+
+   threads = NULL;
+
+   if (n_threads > 1) {
+      threads = bson_malloc (sizeof *threads * (n_threads - 1));
+
+      for (i = 0; i < n_threads - 1; i++) {
+         if (bson_thread_create (
+                &threads[n_spawned], _bson_stream_index_worker, &work)) {
+            /* carry on with the threads we have */
+            break;
+         }
+
+         n_spawned++;
+      }
+   }
+
+   _bson_stream_index_worker (&work);
+
+   for (i = 0; i < n_spawned; i++) {
+      bson_thread_join (threads[i]);
+   }
+
+   bson_free (threads);
+   bson_mutex_destroy (&work.mutex);
+
+   /* workers report errors in completion order */
+   if (index->n_errors > 1) {
+      qsort (index->errors,
+             index->n_errors,
+             sizeof *index->errors,
+             _bson_stream_index_error_cmp);
+   }
+
+   return index;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_stream_index_destroy --
+ *
+ *       Free a bson_stream_index_t. Does nothing if @index is NULL.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_stream_index_destroy (bson_stream_index_t *index) /* IN */
+{
+   if (index) {
+      bson_free (index->offsets);
+      bson_free (index->errors);
+      bson_free (index);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_stream_index_count --
+ *
+ *       Returns the number of documents framed in the stream, valid or
+ *       not.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+bson_stream_index_count (const bson_stream_index_t *index) /* IN */
+{
+   BSON_ASSERT (index);
+
+   return index->count;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_stream_index_get --
+ *
+ *       Get the @i'th document in the stream. If @bson is not NULL, it is
+ *       initialized with bson_init_static() to point into the stream.
+ *       If @offset is not NULL, it is set to the document's offset.
+ *
+ * Returns:
+ *       true if @i is less than bson_stream_index_count() and, if @bson
+ *       was given, the document could be initialized.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_stream_index_get (const bson_stream_index_t *index, /* IN */
+                       size_t i,                         /* IN */
+                       bson_t *bson,                     /* OUT */
+                       size_t *offset)                   /* OUT */
+{
+   int32_t blen;
+
+   BSON_ASSERT (index);
+
+   if (i >= index->count) {
+      return false;
+   }
+
+   if (offset) {
+      *offset = index->offsets[i];
+   }
+
+   if (bson) {
+      memcpy (&blen, index->data + index->offsets[i], sizeof blen);
+      blen = BSON_UINT32_FROM_LE (blen);
+
+      return bson_init_static (
+         bson, index->data + index->offsets[i], (uint32_t) blen);
+   }
+
+   return true;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_stream_index_n_errors --
+ *
+ *       Returns the number of invalid documents, plus one if the stream
+ *       could not be framed to the end.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+bson_stream_index_n_errors (const bson_stream_index_t *index) /* IN */
+{
+   BSON_ASSERT (index);
+
+   return index->n_errors;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_stream_index_get_error --
+ *
+ *       Get the @i'th error, in order of offset. @offset is set to the
+ *       offset of the invalid document and @error to the reason.
+ *
+ * Returns:
+ *       true if @i is less than bson_stream_index_n_errors().
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_stream_index_get_error (const bson_stream_index_t *index, /* IN */
+                             size_t i,                         /* IN */
+                             size_t *offset,                   /* OUT */
+                             bson_error_t *error)              /* OUT */
+{
+   BSON_ASSERT (index);
+
+   if (i >= index->n_errors) {
+      return false;
+   }
+
+   if (offset) {
+      *offset = index->errors[i].offset;
+   }
+
+   if (error) {
+      memcpy (error, &index->errors[i].error, sizeof *error);
+   }
+
+   return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bson-prelude.h"
+
+
+#ifndef BSON_STREAM_INDEX_H
+#define BSON_STREAM_INDEX_H
+
+
+#include "bson-error.h"
+#include "bson-macros.h"
+#include "bson-types.h"
+
+
+BSON_BEGIN_DECLS
+
+
+/**
+ * bson_stream_index_t:
+ *
+ * The result of splitting a buffer of concatenated BSON documents, like a
+ * mongodump file, at document boundaries and validating every document.
+ * bson_stream_index_new() frames the stream in one pass over the length
+ * prefixes, then validates the documents on a pool of threads. The index
+ * holds the offset of each document and the offset and error of each
+ * invalid one.
+ *
+ * The index refers to the buffer, which must not be modified or freed
+ * while the index is in use.
+ */
+typedef struct _bson_stream_index_t bson_stream_index_t;
+
+
+BSON_EXPORT (bson_stream_index_t *)
+bson_stream_index_new (const uint8_t *data,
+                       size_t length,
+                       bson_validate_flags_t flags,
+                       uint32_t n_threads);
+BSON_EXPORT (void)
+bson_stream_index_destroy (bson_stream_index_t *index);
+BSON_EXPORT (size_t)
+bson_stream_index_count (const bson_stream_index_t *index);
+BSON_EXPORT (bool)
+bson_stream_index_get (const bson_stream_index_t *index,
+                       size_t i,
+                       bson_t *bson,
+                       size_t *offset);
+BSON_EXPORT (size_t)
+bson_stream_index_n_errors (const bson_stream_index_t *index);
+BSON_EXPORT (bool)
+bson_stream_index_get_error (const bson_stream_index_t *index,
+                             size_t i,
+                             size_t *offset,
+                             bson_error_t *error);
+
+
+BSON_END_DECLS
+
+
+#endif /* BSON_STREAM_INDEX_H */
@@ -0,0 +1,519 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "bson.h"
+#include "bson-private.h"
+#include "bson-template.h"
+
+
+typedef struct {
+   bson_type_t type;
+   uint32_t element_offset; /* offset of the type byte in the skeleton */
+   uint32_t value_offset;   /* offset of the value in the skeleton */
+   uint32_t value_size;     /* size of a fixed-size value, or zero */
+   bool fixed;
+} bson_template_field_t;
+
+
+struct _bson_template_t {
+   bson_template_field_t *fields;
+   uint32_t n_fields;
+   uint32_t fields_alloc;
+   /* the type byte and key of each element, followed by space for its
+    * value if the value has a fixed size */
+   uint8_t *skeleton;
+   uint32_t skeleton_len;
+   uint32_t skeleton_alloc;
+   uint32_t n_variable;
+};
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_template_value_size --
+ *
+ *       Determine the encoded size of values of @type.
+ *
+ * Returns:
+ *       true if @type is supported. @size is set to the size of every
+ *       value of @type, or zero if the size varies.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_bson_template_value_size (bson_type_t type, /* IN */
+                           uint32_t *size)   /* OUT */
+{
+   switch (type) {
+   case BSON_TYPE_DOUBLE:
+   case BSON_TYPE_DATE_TIME:
+   case BSON_TYPE_TIMESTAMP:
+   case BSON_TYPE_INT64:
+      *size = 8;
+      return true;
+   case BSON_TYPE_INT32:
+      *size = 4;
+      return true;
+   case BSON_TYPE_BOOL:
+      *size = 1;
+      return true;
+   case BSON_TYPE_NULL:
+      *size = 0;
+      return true;
+   case BSON_TYPE_OID:
+      *size = 12;
+      return true;
+   case BSON_TYPE_DECIMAL128:
+      *size = 16;
+      return true;
+   case BSON_TYPE_UTF8:
+   case BSON_TYPE_DOCUMENT:
+   case BSON_TYPE_ARRAY:
+   case BSON_TYPE_BINARY:
+      *size = 0;
+      return true;
+   case BSON_TYPE_EOD:
+   case BSON_TYPE_UNDEFINED:
+   case BSON_TYPE_REGEX:
+   case BSON_TYPE_DBPOINTER:
+   case BSON_TYPE_CODE:
+   case BSON_TYPE_SYMBOL:
+   case BSON_TYPE_CODEWSCOPE:
+   case BSON_TYPE_MAXKEY:
+   case BSON_TYPE_MINKEY:
+   default:
+      return false;
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_template_variable_size --
+ *
+ *       Determine the encoded size of a variable-size @value.
+ *
+ * Returns:
+ *       true if @value can be encoded; otherwise false.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_bson_template_variable_size (const bson_value_t *value, /* IN */
+                              uint32_t *size)            /* OUT */
+{
+   switch (value->value_type) {
+   case BSON_TYPE_UTF8:
+      if (value->value.v_utf8.len > BSON_MAX_SIZE - 5) {
+         return false;
+      }
+      *size = 4 + value->value.v_utf8.len + 1;
+      return true;
+   case BSON_TYPE_DOCUMENT:
+   case BSON_TYPE_ARRAY:
+      if (value->value.v_doc.data_len < 5 ||
+          value->value.v_doc.data_len > BSON_MAX_SIZE) {
+         return false;
+      }
+      *size = value->value.v_doc.data_len;
+      return true;
+   case BSON_TYPE_BINARY:
+      /* the deprecated subtype has a second length prefix */
+      if (value->value.v_binary.subtype == BSON_SUBTYPE_BINARY_DEPRECATED ||
+          value->value.v_binary.data_len > BSON_MAX_SIZE - 5) {
+         return false;
+      }
+      *size = 4 + 1 + value->value.v_binary.data_len;
+      return true;
+   case BSON_TYPE_EOD:
+   case BSON_TYPE_DOUBLE:
+   case BSON_TYPE_UNDEFINED:
+   case BSON_TYPE_OID:
+   case BSON_TYPE_BOOL:
+   case BSON_TYPE_DATE_TIME:
+   case BSON_TYPE_NULL:
+   case BSON_TYPE_REGEX:
+   case BSON_TYPE_DBPOINTER:
+   case BSON_TYPE_CODE:
+   case BSON_TYPE_SYMBOL:
+   case BSON_TYPE_CODEWSCOPE:
+   case BSON_TYPE_INT32:
+   case BSON_TYPE_TIMESTAMP:
+   case BSON_TYPE_INT64:
+   case BSON_TYPE_DECIMAL128:
+   case BSON_TYPE_MAXKEY:
+   case BSON_TYPE_MINKEY:
+   default:
+      return false;
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_template_store --
+ *
+ *       Encode @value, of any supported type, at @buf.
+ *
+ * Returns:
+ *       The number of bytes written.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static uint32_t
+_bson_template_store (uint8_t *buf,              /* OUT */
+                      const bson_value_t *value) /* IN */
+{
+   uint32_t u32;
+   uint64_t u64;
+   double d;
+
+   switch (value->value_type) {
+   case BSON_TYPE_DOUBLE:
+      d = BSON_DOUBLE_TO_LE (value->value.v_double);
+      memcpy (buf, &d, 8);
+      return 8;
+   case BSON_TYPE_DATE_TIME:
+      u64 = BSON_UINT64_TO_LE ((uint64_t) value->value.v_datetime);
+      memcpy (buf, &u64, 8);
+      return 8;
+   case BSON_TYPE_TIMESTAMP:
+      u64 = BSON_UINT64_TO_LE (
+         (((uint64_t) value->value.v_timestamp.timestamp) << 32) |
+         ((uint64_t) value->value.v_timestamp.increment));
+      memcpy (buf, &u64, 8);
+      return 8;
+   case BSON_TYPE_INT64:
+      u64 = BSON_UINT64_TO_LE ((uint64_t) value->value.v_int64);
+      memcpy (buf, &u64, 8);
+      return 8;
+   case BSON_TYPE_INT32:
+      u32 = BSON_UINT32_TO_LE ((uint32_t) value->value.v_int32);
+      memcpy (buf, &u32, 4);
+      return 4;
+   case BSON_TYPE_BOOL:
+      *buf = value->value.v_bool ? 1 : 0;
+      return 1;
+   case BSON_TYPE_OID:
+      memcpy (buf, value->value.v_oid.bytes, 12);
+      return 12;
+   case BSON_TYPE_DECIMAL128:
+      u64 = BSON_UINT64_TO_LE (value->value.v_decimal128.low);
+      memcpy (buf, &u64, 8);
+      u64 = BSON_UINT64_TO_LE (value->value.v_decimal128.high);
+      memcpy (buf + 8, &u64, 8);
+      return 16;
+   case BSON_TYPE_UTF8:
+      u32 = BSON_UINT32_TO_LE (value->value.v_utf8.len + 1);
+      memcpy (buf, &u32, 4);
+      if (value->value.v_utf8.len) {
+         memcpy (buf + 4, value->value.v_utf8.str, value->value.v_utf8.len);
+      }
+      buf[4 + value->value.v_utf8.len] = '\0';
+      return 4 + value->value.v_utf8.len + 1;
+   case BSON_TYPE_DOCUMENT:
+   case BSON_TYPE_ARRAY:
+      memcpy (buf, value->value.v_doc.data, value->value.v_doc.data_len);
+      return value->value.v_doc.data_len;
+   case BSON_TYPE_BINARY:
+      u32 = BSON_UINT32_TO_LE (value->value.v_binary.data_len);
+      memcpy (buf, &u32, 4);
+      buf[4] = (uint8_t) value->value.v_binary.subtype;
+      if (value->value.v_binary.data_len) {
+         memcpy (buf + 5,
+                 value->value.v_binary.data,
+                 value->value.v_binary.data_len);
+      }
+      return 4 + 1 + value->value.v_binary.data_len;
+   case BSON_TYPE_NULL:
+   case BSON_TYPE_EOD:
+   case BSON_TYPE_UNDEFINED:
+   case BSON_TYPE_REGEX:
+   case BSON_TYPE_DBPOINTER:
+   case BSON_TYPE_CODE:
+   case BSON_TYPE_SYMBOL:
+   case BSON_TYPE_CODEWSCOPE:
+   case BSON_TYPE_MAXKEY:
+   case BSON_TYPE_MINKEY:
+   default:
+      return 0;
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_template_new --
+ *
+ *       Create an empty template. Add elements with bson_template_add().
+ *
+ * Returns:
+ *       A newly allocated bson_template_t that should be freed with
+ *       bson_template_destroy().
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bson_template_t *
+bson_template_new (void)
+{
+   return bson_malloc0 (sizeof (bson_template_t));
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_template_destroy --
+ *
+ *       Free a template created with bson_template_new().
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+bson_template_destroy (bson_template_t *tmpl) /* IN */
+{
+   if (tmpl) {
+      bson_free (tmpl->fields);
+      bson_free (tmpl->skeleton);
+      bson_free (tmpl);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_template_add --
+ *
+ *       Add an element with @key and a value of @type to the end of
+ *       @tmpl. Supported types are double, UTF-8, document, array,
+ *       binary, ObjectId, bool, datetime, null, int32, timestamp, int64,
+ *       and decimal128.
+ *
+ * Returns:
+ *       true if successful; false if @type is not supported or @key is
+ *       too long.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_template_add (bson_template_t *tmpl, /* IN */
+                   const char *key,       /* IN */
+                   bson_type_t type)      /* IN */
+{
+   bson_template_field_t *field;
+   uint32_t value_size;
+   size_t key_len;
+   size_t needed;
+
+   BSON_ASSERT (tmpl);
+   BSON_ASSERT (key);
+
+   if (!_bson_template_value_size (type, &value_size)) {
+      return false;
+   }
+
+   key_len = strlen (key);
+   needed = (size_t) tmpl->skeleton_len + 1 + key_len + 1 + value_size;
+
+   if (needed > BSON_MAX_SIZE - 5) {
+      return false;
+   }
+
+   if (tmpl->n_fields == tmpl->fields_alloc) {
+      tmpl->fields_alloc = tmpl->fields_alloc ? tmpl->fields_alloc * 2 : 8;
+      tmpl->fields = bson_realloc (
+         tmpl->fields, tmpl->fields_alloc * sizeof (bson_template_field_t));
+   }
+
+   if (needed > tmpl->skeleton_alloc) {
+      tmpl->skeleton_alloc = (uint32_t) bson_next_power_of_two (needed);
+      tmpl->skeleton = bson_realloc (tmpl->skeleton, tmpl->skeleton_alloc);
+   }
+
+   field = &tmpl->fields[tmpl->n_fields++];
+   field->type = type;
+   field->element_offset = tmpl->skeleton_len;
+   field->value_offset = (uint32_t) (tmpl->skeleton_len + 1 + key_len + 1);
+   field->value_size = value_size;
+   field->fixed = (value_size > 0 || type == BSON_TYPE_NULL);
+
+   if (!field->fixed) {
+      tmpl->n_variable++;
+   }
+
+   tmpl->skeleton[field->element_offset] = (uint8_t) type;
+   memcpy (&tmpl->skeleton[field->element_offset + 1], key, key_len + 1);
+   memset (&tmpl->skeleton[field->value_offset], 0, value_size);
+   tmpl->skeleton_len = (uint32_t) needed;
+
+   return true;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_template_n_fields --
+ *
+ *       The number of elements added to @tmpl.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+uint32_t
+bson_template_n_fields (const bson_template_t *tmpl) /* IN */
+{
+   BSON_ASSERT (tmpl);
+
+   return tmpl->n_fields;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_template_size --
+ *
+ *       The number of bytes bson_template_append() adds to a document,
+ *       not counting the values of variable-size types. If @tmpl has only
+ *       fixed-size types, this is exactly the number of bytes appended.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+uint32_t
+bson_template_size (const bson_template_t *tmpl) /* IN */
+{
+   BSON_ASSERT (tmpl);
+
+   return tmpl->skeleton_len;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_template_append --
+ *
+ *       Append the elements of @tmpl to @bson, with values from @values,
+ *       which must have bson_template_n_fields() entries whose types
+ *       match the template.
+ *
+ * Returns:
+ *       true if successful; false if a value does not match the type in
+ *       the template or @bson would exceed the maximum BSON size.
+ *
+ * Side effects:
+ *       On failure @bson is unchanged.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_template_append (const bson_template_t *tmpl, /* IN */
+                      bson_t *bson,                /* IN */
+                      const bson_value_t *values)  /* IN */
+{
+   const bson_template_field_t *field;
+   uint64_t n_bytes;
+   uint32_t size;
+   uint32_t i;
+   uint8_t *buf;
+   uint8_t *out;
+
+   BSON_ASSERT (tmpl);
+   BSON_ASSERT (bson);
+   BSON_ASSERT (values || !tmpl->n_fields);
+
+   n_bytes = tmpl->skeleton_len;
+
+   for (i = 0; i < tmpl->n_fields; i++) {
+      field = &tmpl->fields[i];
+
+      if (values[i].value_type != field->type) {
+         return false;
+      }
+
+      if (!field->fixed) {
+         if (!_bson_template_variable_size (&values[i], &size)) {
+            return false;
+         }
+
+         n_bytes += size;
+      }
+   }
+
+   if (!tmpl->n_fields) {
+      return true;
+   }
+
+   if (n_bytes > BSON_MAX_SIZE) {
+      return false;
+   }
+
+   buf = _bson_append_reserve (bson, (uint32_t) n_bytes);
+   if (!buf) {
+      return false;
+   }
+
+   if (!tmpl->n_variable) {
+      /* every value is at a fixed offset from the start of the elements */
+      memcpy (buf, tmpl->skeleton, tmpl->skeleton_len);
+
+      for (i = 0; i < tmpl->n_fields; i++) {
+         _bson_template_store (buf + tmpl->fields[i].value_offset, &values[i]);
+      }
+
+      return true;
+   }
+
+   out = buf;
+
+   for (i = 0; i < tmpl->n_fields; i++) {
+      field = &tmpl->fields[i];
+
+      /* the type byte and key */
+      size = field->value_offset - field->element_offset;
+      memcpy (out, &tmpl->skeleton[field->element_offset], size);
+      out += size;
+
+      out += _bson_template_store (out, &values[i]);
+   }
+
+   BSON_ASSERT (out == buf + n_bytes);
+
+   return true;
+}
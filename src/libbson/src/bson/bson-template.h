@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bson-prelude.h"
+
+
+#ifndef BSON_TEMPLATE_H
+#define BSON_TEMPLATE_H
+
+
+#include "bson-macros.h"
+#include "bson-types.h"
+
+
+BSON_BEGIN_DECLS
+
+
+/**
+ * bson_template_t:
+ *
+ * A planned sequence of elements with fixed keys and types, for building
+ * the same shape of document many times. The type byte and key of every
+ * element are encoded once, when the template is built, and the offset of
+ * each fixed-size value is computed in advance. bson_template_append()
+ * then grows the destination document once and stores the values
+ * directly, without the per-element capacity checks, key length
+ * computations, and length updates of the bson_append_*() functions.
+ */
+typedef struct _bson_template_t bson_template_t;
+
+
+BSON_EXPORT (bson_template_t *)
+bson_template_new (void);
+BSON_EXPORT (void)
+bson_template_destroy (bson_template_t *tmpl);
+BSON_EXPORT (bool)
+bson_template_add (bson_template_t *tmpl, const char *key, bson_type_t type);
+BSON_EXPORT (uint32_t)
+bson_template_n_fields (const bson_template_t *tmpl);
+BSON_EXPORT (uint32_t)
+bson_template_size (const bson_template_t *tmpl);
+BSON_EXPORT (bool)
+bson_template_append (const bson_template_t *tmpl,
+                      bson_t *bson,
+                      const bson_value_t *values);
+
+
+BSON_END_DECLS
+
+
+#endif /* BSON_TEMPLATE_H */
@@ -61,6 +61,9 @@ typedef uint32_t bson_unichar_t;
  *   result of getpid() when initializing the context.
  * %BSON_CONTEXT_DISABLE_HOST_CACHE: Call gethostname() instead of caching the
  *   result of gethostname() when initializing the context.
+ * %BSON_CONTEXT_THREAD_LOCAL: Context will be called from multiple threads,
+ *   each of which reserves blocks of sequence numbers so that generating
+ *   ObjectIds does not contend on a shared counter.
  */
 typedef enum {
    BSON_CONTEXT_NONE = 0,
@@ -70,6 +73,7 @@ typedef enum {
 #ifdef BSON_HAVE_SYSCALL_TID
    BSON_CONTEXT_USE_TASK_ID = (1 << 3),
 #endif
+   BSON_CONTEXT_THREAD_LOCAL = (1 << 4),
 } bson_context_flags_t;
 
 
@@ -226,6 +230,16 @@ typedef enum {
 } bson_validate_flags_t;
 
 
+/**
+ * BSON_VALIDATE_CORRUPT:
+ *
+ * The error code, in the %BSON_ERROR_INVALID domain, for a document that
+ * cannot be read at all, as opposed to one failing a bson_validate_flags_t
+ * check. It does not overlap any of the flags.
+ */
+#define BSON_VALIDATE_CORRUPT (1 << 5)
+
+
 /**
  * bson_type_t:
  *
@@ -19,6 +19,7 @@
 #include "bson-config.h"
 #include "bson-private.h"
 #include "bson-string.h"
+#include "bson-dtoa-private.h"
 #include "bson-iso8601-private.h"
 
 #include "common-b64-private.h"
@@ -44,11 +45,7 @@ typedef enum {
 } bson_validate_phase_t;
 
 
-typedef enum {
-   BSON_JSON_MODE_LEGACY,
-   BSON_JSON_MODE_CANONICAL,
-   BSON_JSON_MODE_RELAXED,
-} bson_json_mode_t;
+#define BSON_JSON_WRITER_DEFAULT_CHUNK_SIZE (1 << 14)
 
 
 /*
@@ -69,9 +66,20 @@ typedef struct {
    uint32_t depth;
    bson_string_t *str;
    bson_json_mode_t mode;
+   bson_json_writer_t *writer; /* flush target for str, or NULL */
 } bson_json_state_t;
 
 
+struct _bson_json_writer_t {
+   bson_json_writer_cb cb;
+   void *ctx;
+   bson_json_mode_t mode;
+   size_t chunk_size;
+   bson_string_t *str; /* staging buffer, reused across documents */
+   bool cb_failed;
+};
+
+
 /*
  * Forward declarations.
  */
@@ -419,6 +427,51 @@ _bson_append (bson_t *bson,              /* IN */
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _bson_append_reserve --
+ *
+ *       Grow @bson by @n_bytes of elements that the caller will write
+ *       into the returned buffer. The document's length and trailing
+ *       byte are updated immediately.
+ *
+ * Returns:
+ *       A pointer to @n_bytes of uninitialized data at the end of the
+ *       document, or NULL if the document would exceed BSON_MAX_SIZE.
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+uint8_t *
+_bson_append_reserve (bson_t *bson,     /* IN */
+                      uint32_t n_bytes) /* IN */
+{
+   uint8_t *buf;
+
+   BSON_ASSERT (!(bson->flags & BSON_FLAG_IN_CHILD));
+   BSON_ASSERT (!(bson->flags & BSON_FLAG_RDONLY));
+
+   if (BSON_UNLIKELY (n_bytes > (BSON_MAX_SIZE - bson->len))) {
+      return NULL;
+   }
+
+   if (BSON_UNLIKELY (!_bson_grow (bson, n_bytes))) {
+      return NULL;
+   }
+
+   buf = _bson_data (bson) + bson->len - 1;
+   bson->len += n_bytes;
+   _bson_encode_length (bson);
+   buf[n_bytes] = '\0';
+
+   return buf;
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -2036,6 +2089,47 @@ bson_init_static (bson_t *bson, const uint8_t *data, size_t length)
 }
 
 
+bool
+bson_init_adopt (bson_t *bson, uint8_t *buf, size_t buflen, size_t offset)
+{
+   bson_impl_alloc_t *impl = (bson_impl_alloc_t *) bson;
+   uint32_t len_le;
+   size_t length;
+
+   BSON_ASSERT (bson);
+   BSON_ASSERT (buf);
+
+   if ((buflen > INT_MAX) || (offset > buflen) || (buflen - offset < 5)) {
+      return false;
+   }
+
+   memcpy (&len_le, buf + offset, sizeof (len_le));
+   length = (size_t) BSON_UINT32_FROM_LE (len_le);
+
+   if ((length < 5) || (length > buflen - offset)) {
+      return false;
+   }
+
+   if (buf[offset + length - 1]) {
+      return false;
+   }
+
+   impl->flags = BSON_FLAG_STATIC;
+   impl->len = (uint32_t) length;
+   impl->parent = NULL;
+   impl->depth = 0;
+   impl->buf = &impl->alloc;
+   impl->buflen = &impl->alloclen;
+   impl->offset = offset;
+   impl->alloc = buf;
+   impl->alloclen = buflen;
+   impl->realloc = bson_realloc_ctx;
+   impl->realloc_func_ctx = NULL;
+
+   return true;
+}
+
+
 bson_t *
 bson_new (void)
 {
@@ -2439,8 +2533,20 @@ bson_destroy_with_steal (bson_t *bson, bool steal, uint32_t *length)
       bson_impl_alloc_t *alloc;
 
       alloc = (bson_impl_alloc_t *) bson;
-      ret = *alloc->buf;
-      *alloc->buf = NULL;
+
+      if (alloc->realloc == bson_arena_realloc_ctx) {
+         /* the arena owns the buffer, hand back a copy the caller can free */
+         ret = bson_malloc (bson->len);
+         memcpy (ret, _bson_data (bson), bson->len);
+      } else {
+         ret = *alloc->buf;
+         *alloc->buf = NULL;
+
+         if (alloc->offset) {
+            /* adopted with bson_init_adopt, move the document to the front */
+            memmove (ret, ret + alloc->offset, bson->len);
+         }
+      }
    }
 
    bson_destroy (bson);
@@ -2530,6 +2636,41 @@ bson_equal (const bson_t *bson, const bson_t *other)
 }
 
 
+static BSON_INLINE bool
+_bson_double_is_neg_zero (double value)
+{
+   uint64_t bits;
+
+   memcpy (&bits, &value, sizeof bits);
+
+   return bits == 0x8000000000000000ULL;
+}
+
+
+/* append the decimal form of @value without going through printf */
+static void
+_bson_json_append_int64 (bson_string_t *str, int64_t value)
+{
+   char buf[21];
+   char *p = buf + sizeof buf - 1;
+   uint64_t u;
+
+   u = value < 0 ? (uint64_t) 0 - (uint64_t) value : (uint64_t) value;
+   *p = '\0';
+
+   do {
+      *--p = (char) ('0' + (u % 10));
+      u /= 10;
+   } while (u);
+
+   if (value < 0) {
+      *--p = '-';
+   }
+
+   bson_string_append (str, p);
+}
+
+
 static bool
 _bson_as_json_visit_utf8 (const bson_iter_t *iter,
                           const char *key,
@@ -2563,10 +2704,11 @@ _bson_as_json_visit_int32 (const bson_iter_t *iter,
    bson_json_state_t *state = data;
 
    if (state->mode == BSON_JSON_MODE_CANONICAL) {
-      bson_string_append_printf (
-         state->str, "{ \"$numberInt\" : \"%" PRId32 "\" }", v_int32);
+      bson_string_append (state->str, "{ \"$numberInt\" : \"");
+      _bson_json_append_int64 (state->str, v_int32);
+      bson_string_append (state->str, "\" }");
    } else {
-      bson_string_append_printf (state->str, "%" PRId32, v_int32);
+      _bson_json_append_int64 (state->str, v_int32);
    }
 
    return false;
@@ -2582,10 +2724,11 @@ _bson_as_json_visit_int64 (const bson_iter_t *iter,
    bson_json_state_t *state = data;
 
    if (state->mode == BSON_JSON_MODE_CANONICAL) {
-      bson_string_append_printf (
-         state->str, "{ \"$numberLong\" : \"%" PRId64 "\"}", v_int64);
+      bson_string_append (state->str, "{ \"$numberLong\" : \"");
+      _bson_json_append_int64 (state->str, v_int64);
+      bson_string_append (state->str, "\"}");
    } else {
-      bson_string_append_printf (state->str, "%" PRId64, v_int64);
+      _bson_json_append_int64 (state->str, v_int64);
    }
 
    return false;
@@ -2620,6 +2763,7 @@ _bson_as_json_visit_double (const bson_iter_t *iter,
    bson_string_t *str = state->str;
    uint32_t start_len;
    bool legacy;
+   char buf[BSON_DTOA_BUFSIZE];
 
    /* Determine if legacy (i.e. unwrapped) output should be used. Relaxed mode
     * will use this for nan and inf values, which we check manually since old
@@ -2640,9 +2784,24 @@ _bson_as_json_visit_double (const bson_iter_t *iter,
       } else {
          bson_string_append (str, "-Infinity");
       }
+   } else if (v_double >= -9223372036854775808.0 &&
+              v_double < 9223372036854775808.0 &&
+              v_double == (double) (int64_t) v_double &&
+              !_bson_double_is_neg_zero (v_double)) {
+      /* integral values in int64 range print exactly as integers, like
+       * "%.20g" did, rather than padding the shortest digits with zeros */
+      _bson_json_append_int64 (str, (int64_t) v_double);
+      bson_string_append (str, ".0");
    } else {
+      if (v_double * 0 == 0) {
+         _bson_dtoa (v_double, buf);
+      } else {
+         /* legacy output of nan and inf is platform-specific */
+         bson_snprintf (buf, sizeof buf, "%.20g", v_double);
+      }
+
       start_len = str->len;
-      bson_string_append_printf (str, "%.20g", v_double);
+      bson_string_append (str, buf);
 
       /* ensure trailing ".0" to distinguish "3" from "3.0" */
       if (strspn (&str->str[start_len], "0123456789-") ==
@@ -2763,7 +2922,7 @@ _bson_as_json_visit_date_time (const bson_iter_t *iter,
    if (state->mode == BSON_JSON_MODE_CANONICAL ||
        (state->mode == BSON_JSON_MODE_RELAXED && msec_since_epoch < 0)) {
       bson_string_append (state->str, "{ \"$date\" : { \"$numberLong\" : \"");
-      bson_string_append_printf (state->str, "%" PRId64, msec_since_epoch);
+      _bson_json_append_int64 (state->str, msec_since_epoch);
       bson_string_append (state->str, "\" } }");
    } else if (state->mode == BSON_JSON_MODE_RELAXED) {
       bson_string_append (state->str, "{ \"$date\" : \"");
@@ -2771,7 +2930,7 @@ _bson_as_json_visit_date_time (const bson_iter_t *iter,
       bson_string_append (state->str, "\" }");
    } else {
       bson_string_append (state->str, "{ \"$date\" : ");
-      bson_string_append_printf (state->str, "%" PRId64, msec_since_epoch);
+      _bson_json_append_int64 (state->str, msec_since_epoch);
       bson_string_append (state->str, " }");
    }
 
@@ -2826,9 +2985,9 @@ _bson_as_json_visit_timestamp (const bson_iter_t *iter,
    bson_json_state_t *state = data;
 
    bson_string_append (state->str, "{ \"$timestamp\" : { \"t\" : ");
-   bson_string_append_printf (state->str, "%u", v_timestamp);
+   _bson_json_append_int64 (state->str, v_timestamp);
    bson_string_append (state->str, ", \"i\" : ");
-   bson_string_append_printf (state->str, "%u", v_increment);
+   _bson_json_append_int64 (state->str, v_increment);
    bson_string_append (state->str, " } }");
 
    return false;
@@ -2943,6 +3102,25 @@ _bson_as_json_visit_before (const bson_iter_t *iter,
 }
 
 
+static bool
+_bson_json_writer_flush (bson_json_writer_t *writer);
+
+
+static bool
+_bson_as_json_visit_after (const bson_iter_t *iter,
+                           const char *key,
+                           void *data)
+{
+   bson_json_state_t *state = data;
+
+   if (state->writer && state->str->len >= state->writer->chunk_size) {
+      return !_bson_json_writer_flush (state->writer);
+   }
+
+   return false;
+}
+
+
 static void
 _bson_as_json_visit_corrupt (const bson_iter_t *iter, void *data)
 {
@@ -3045,7 +3223,7 @@ _bson_as_json_visit_codewscope (const bson_iter_t *iter,
 
 
 static const bson_visitor_t bson_as_json_visitors = {
-   _bson_as_json_visit_before,     NULL, /* visit_after */
+   _bson_as_json_visit_before,     _bson_as_json_visit_after,
    _bson_as_json_visit_corrupt,    _bson_as_json_visit_double,
    _bson_as_json_visit_utf8,       _bson_as_json_visit_document,
    _bson_as_json_visit_array,      _bson_as_json_visit_binary,
@@ -3077,17 +3255,18 @@ _bson_as_json_visit_document (const bson_iter_t *iter,
    }
 
    if (bson_iter_init (&child, v_document)) {
-      child_state.str = bson_string_new ("{ ");
+      /* write straight into the parent's string, on failure the caller
+       * discards the whole output */
+      child_state.str = state->str;
       child_state.depth = state->depth + 1;
       child_state.mode = state->mode;
+      child_state.writer = state->writer;
+      bson_string_append (child_state.str, "{ ");
       if (bson_iter_visit_all (&child, &bson_as_json_visitors, &child_state)) {
-         bson_string_free (child_state.str, true);
          return true;
       }
 
       bson_string_append (child_state.str, " }");
-      bson_string_append (state->str, child_state.str->str);
-      bson_string_free (child_state.str, true);
    }
 
    return false;
@@ -3110,17 +3289,18 @@ _bson_as_json_visit_array (const bson_iter_t *iter,
    }
 
    if (bson_iter_init (&child, v_array)) {
-      child_state.str = bson_string_new ("[ ");
+      /* write straight into the parent's string, on failure the caller
+       * discards the whole output */
+      child_state.str = state->str;
       child_state.depth = state->depth + 1;
       child_state.mode = state->mode;
+      child_state.writer = state->writer;
+      bson_string_append (child_state.str, "[ ");
       if (bson_iter_visit_all (&child, &bson_as_json_visitors, &child_state)) {
-         bson_string_free (child_state.str, true);
          return true;
       }
 
       bson_string_append (child_state.str, " ]");
-      bson_string_append (state->str, child_state.str->str);
-      bson_string_free (child_state.str, true);
    }
 
    return false;
@@ -3160,6 +3340,7 @@ _bson_as_json_visit_all (const bson_t *bson,
    state.depth = 0;
    state.err_offset = &err_offset;
    state.mode = mode;
+   state.writer = NULL;
 
    if (bson_iter_visit_all (&iter, &bson_as_json_visitors, &state) ||
        err_offset != -1) {
@@ -3235,6 +3416,7 @@ bson_array_as_json (const bson_t *bson, size_t *length)
    state.depth = 0;
    state.err_offset = &err_offset;
    state.mode = BSON_JSON_MODE_LEGACY;
+   state.writer = NULL;
 
    if (bson_iter_visit_all (&iter, &bson_as_json_visitors, &state) ||
        err_offset != -1) {
@@ -3258,6 +3440,166 @@ bson_array_as_json (const bson_t *bson, size_t *length)
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_json_writer_new --
+ *
+ *       Creates a new bson_json_writer_t that converts documents to JSON
+ *       in @mode and passes the output to @cb in chunks. Output is staged
+ *       in a buffer that is flushed to @cb once it holds @chunk_size bytes
+ *       or more, and at the end of each document. A single string value
+ *       larger than @chunk_size is passed in one call.
+ *
+ * Parameters:
+ *       @data: A user-defined pointer passed to @cb.
+ *       @cb: A callback that consumes output, returning false to abort.
+ *       @mode: The JSON format to write.
+ *       @chunk_size: The staging buffer size, or 0 for a default.
+ *
+ * Returns:
+ *       A newly allocated bson_json_writer_t that should be freed with
+ *       bson_json_writer_destroy().
+ *
+ * Side effects:
+ *       None.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bson_json_writer_t *
+bson_json_writer_new (void *data,             /* IN */
+                      bson_json_writer_cb cb, /* IN */
+                      bson_json_mode_t mode,  /* IN */
+                      size_t chunk_size)      /* IN */
+{
+   bson_json_writer_t *writer;
+
+   BSON_ASSERT (cb);
+
+   writer = bson_malloc0 (sizeof *writer);
+   writer->cb = cb;
+   writer->ctx = data;
+   writer->mode = mode;
+   writer->chunk_size =
+      chunk_size ? chunk_size : BSON_JSON_WRITER_DEFAULT_CHUNK_SIZE;
+   writer->str = bson_string_new (NULL);
+
+   return writer;
+}
+
+
+void
+bson_json_writer_destroy (bson_json_writer_t *writer) /* IN */
+{
+   if (writer) {
+      bson_string_free (writer->str, true);
+      bson_free (writer);
+   }
+}
+
+
+/* hand the staged output to the callback and empty the buffer */
+static bool
+_bson_json_writer_flush (bson_json_writer_t *writer)
+{
+   if (writer->str->len) {
+      if (!writer->cb (writer->ctx, writer->str->str, writer->str->len)) {
+         writer->cb_failed = true;
+      }
+
+      bson_string_truncate (writer->str, 0);
+   }
+
+   return !writer->cb_failed;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * bson_json_writer_write --
+ *
+ *       Writes @bson as a JSON object through @writer. All output for
+ *       @bson has been passed to the callback when this returns.
+ *
+ * Returns:
+ *       true if successful. false if @bson is corrupt or the callback
+ *       returned false, and @error is set. Output for the part of @bson
+ *       before the failure may already have been passed to the callback.
+ *
+ * Side effects:
+ *       @error is set if false is returned.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+bson_json_writer_write (bson_json_writer_t *writer, /* IN */
+                        const bson_t *bson,         /* IN */
+                        bson_error_t *error)        /* OUT */
+{
+   bson_json_state_t state;
+   bson_iter_t iter;
+   ssize_t err_offset = -1;
+
+   BSON_ASSERT (writer);
+   BSON_ASSERT (bson);
+
+   writer->cb_failed = false;
+
+   if (!bson_iter_init (&iter, bson)) {
+      bson_set_error (error,
+                      BSON_ERROR_JSON,
+                      BSON_JSON_ERROR_WRITE_CORRUPT_BSON,
+                      "corrupt BSON");
+      return false;
+   }
+
+   state.count = 0;
+   state.keys = true;
+   state.str = writer->str;
+   state.depth = 0;
+   state.err_offset = &err_offset;
+   state.mode = writer->mode;
+   state.writer = writer;
+
+   bson_string_append (state.str, "{ ");
+
+   if (bson_iter_visit_all (&iter, &bson_as_json_visitors, &state) ||
+       err_offset != -1) {
+      bson_string_truncate (writer->str, 0);
+
+      if (writer->cb_failed) {
+         bson_set_error (error,
+                         BSON_ERROR_JSON,
+                         BSON_JSON_ERROR_WRITE_CB_FAILURE,
+                         "JSON writer callback failed");
+      } else {
+         bson_set_error (error,
+                         BSON_ERROR_JSON,
+                         BSON_JSON_ERROR_WRITE_CORRUPT_BSON,
+                         "corrupt BSON");
+      }
+
+      return false;
+   }
+
+   /* an empty document is written as "{ }" like bson_as_json */
+   bson_string_append (state.str, bson_empty (bson) ? "}" : " }");
+
+   if (!_bson_json_writer_flush (writer)) {
+      bson_set_error (error,
+                      BSON_ERROR_JSON,
+                      BSON_JSON_ERROR_WRITE_CB_FAILURE,
+                      "JSON writer callback failed");
+      return false;
+   }
+
+   return true;
+}
+
+
 #define VALIDATION_ERR(_flag, _msg, ...) \
    bson_set_error (&state->error, BSON_ERROR_INVALID, _flag, _msg, __VA_ARGS__)
 
@@ -27,11 +27,13 @@
 
 #include "bson-macros.h"
 #include "bson-config.h"
+#include "bson-arena.h"
 #include "bson-atomic.h"
 #include "bson-context.h"
 #include "bson-clock.h"
 #include "bson-decimal128.h"
 #include "bson-error.h"
+#include "bson-index.h"
 #include "bson-iter.h"
 #include "bson-json.h"
 #include "bson-keys.h"
@@ -39,7 +41,9 @@
 #include "bson-memory.h"
 #include "bson-oid.h"
 #include "bson-reader.h"
+#include "bson-stream-index.h"
 #include "bson-string.h"
+#include "bson-template.h"
 #include "bson-types.h"
 #include "bson-utf8.h"
 #include "bson-value.h"
@@ -217,6 +221,27 @@ BSON_EXPORT (bool)
 bson_init_static (bson_t *b, const uint8_t *data, size_t length);
 
 
+/**
+ * bson_init_adopt:
+ * @b: A pointer to a bson_t.
+ * @buf: A buffer allocated with bson_malloc() or bson_realloc().
+ * @buflen: The allocated size of @buf.
+ * @offset: The position of the document within @buf.
+ *
+ * Initializes a bson_t that takes ownership of @buf, whose document starts
+ * @offset bytes in. No bytes are copied; @b may be appended to and
+ * bson_destroy() frees @buf. This lets a buffer read from a file or a
+ * socket become a document without copying it out of its framing.
+ *
+ * If the document is invalid, @b is not initialized and the caller still
+ * owns @buf.
+ *
+ * Returns: true if initialized successfully; otherwise false.
+ */
+BSON_EXPORT (bool)
+bson_init_adopt (bson_t *b, uint8_t *buf, size_t buflen, size_t offset);
+
+
 /**
  * bson_init:
  * @b: A pointer to a bson_t.
@@ -2029,6 +2029,61 @@ test_bson_destroy_with_steal (void)
 }
 
 
+static void
+test_bson_init_adopt (void)
+{
+   bson_t *src;
+   bson_t b;
+   bson_t steal;
+   uint8_t *buf;
+   uint8_t *data;
+   size_t buflen;
+   uint32_t len;
+   bson_iter_t iter;
+
+   /* a document after a 16-byte header, with room to spare */
+   src = BCON_NEW ("a", BCON_INT32 (1), "b", BCON_UTF8 ("two"));
+   buflen = 16 + src->len + 3;
+   buf = bson_malloc0 (buflen);
+   memcpy (buf + 16, bson_get_data (src), src->len);
+
+   BSON_ASSERT (bson_init_adopt (&b, buf, buflen, 16));
+   BSON_ASSERT (bson_get_data (&b) == buf + 16);
+   BSON_ASSERT (bson_equal (&b, src));
+
+   /* appending grows the adopted buffer */
+   BSON_APPEND_INT32 (&b, "c", 3);
+   BSON_APPEND_UTF8 (&b, "d", "a string too long to fit in the spare bytes");
+   ASSERT_CMPUINT32 (bson_count_keys (&b), ==, 4);
+   BSON_ASSERT (bson_iter_init_find (&iter, &b, "d"));
+   ASSERT_CMPSTR (bson_iter_utf8 (&iter, NULL),
+                  "a string too long to fit in the spare bytes");
+
+   /* stealing moves the document to the front of the buffer */
+   BSON_ASSERT (bson_steal (&steal, &b));
+   len = steal.len;
+   data = bson_destroy_with_steal (&steal, true, NULL);
+   BSON_ASSERT (data);
+   bson_init_static (&b, data, len);
+   BSON_ASSERT (bson_has_field (&b, "d"));
+   bson_free (data);
+
+   /* on error the caller keeps the buffer */
+   buf = bson_malloc0 (16 + src->len);
+   memcpy (buf + 16, bson_get_data (src), src->len);
+   BSON_ASSERT (!bson_init_adopt (&b, buf, 16 + src->len, 17));
+   BSON_ASSERT (!bson_init_adopt (&b, buf, 16 + src->len - 1, 16));
+   BSON_ASSERT (!bson_init_adopt (&b, buf, 16 + src->len, 16 + src->len));
+   buf[15 + src->len] = 1;
+   BSON_ASSERT (!bson_init_adopt (&b, buf, 16 + src->len, 16));
+   buf[15 + src->len] = 0;
+   BSON_ASSERT (bson_init_adopt (&b, buf, 16 + src->len, 16));
+   bson_destroy (&b);
+
+   bson_destroy (src);
+}
+
+
 static void
 test_bson_has_field (void)
 {
@@ -2461,6 +2516,272 @@ test_bson_append_null_from_utf8_or_symbol (void) {
    bson_destroy (&bson);
 }
 
+static void
+test_bson_arena (void)
+{
+   bson_arena_t *arena;
+   bson_t parent;
+   bson_t child;
+   bson_t *expected;
+   uint8_t *stolen;
+   uint32_t doc_len;
+   uint32_t len;
+   char *str;
+   int i;
+
+   arena = bson_arena_new (256);
+
+   for (i = 0; i < 3; i++) {
+      bson_init_with_arena (&parent, arena);
+      BSON_ASSERT (BSON_APPEND_UTF8 (&parent, "find", "collection"));
+      BSON_ASSERT (BSON_APPEND_DOCUMENT_BEGIN (&parent, "filter", &child));
+      BSON_ASSERT (BSON_APPEND_INT32 (&child, "x", i));
+      BSON_ASSERT (bson_append_document_end (&parent, &child));
+
+      /* grow well past the arena's block size */
+      str = bson_malloc0 (1024);
+      memset (str, 'a', 1023);
+      BSON_ASSERT (BSON_APPEND_UTF8 (&parent, "comment", str));
+      bson_free (str);
+
+      expected = BCON_NEW ("find",
+                           "collection",
+                           "filter",
+                           "{",
+                           "x",
+                           BCON_INT32 (i),
+                           "}",
+                           "comment",
+                           BCON_UTF8 (""));
+      BSON_ASSERT (bson_validate (&parent, BSON_VALIDATE_NONE, NULL));
+      ASSERT_CMPUINT32 (parent.len, ==, expected->len + 1023);
+      bson_destroy (expected);
+
+      if (i == 2) {
+         /* stealing copies out of the arena */
+         doc_len = parent.len;
+         stolen = bson_destroy_with_steal (&parent, true, &len);
+         ASSERT_CMPUINT32 (len, ==, doc_len);
+         memcpy (&len, stolen, sizeof len);
+         ASSERT_CMPUINT32 (BSON_UINT32_FROM_LE (len), ==, doc_len);
+         bson_free (stolen);
+      } else {
+         bson_destroy (&parent);
+      }
+
+      str = bson_arena_strdup (arena, "lsid");
+      ASSERT_CMPSTR (str, "lsid");
+
+      bson_arena_reset (arena);
+   }
+
+   bson_arena_destroy (arena);
+}
+
+
+static void
+test_bson_arena_realloc (void)
+{
+   bson_arena_t *arena;
+   uint8_t *a;
+   uint8_t *b;
+   uint8_t *c;
+
+   arena = bson_arena_new (64);
+
+   /* the most recent allocation grows in place */
+   a = bson_arena_realloc_ctx (NULL, 8, arena);
+   memset (a, 'a', 8);
+   b = bson_arena_realloc_ctx (a, 16, arena);
+   BSON_ASSERT (a == b);
+
+   /* an older allocation is copied */
+   c = bson_arena_alloc (arena, 8);
+   b = bson_arena_realloc_ctx (a, 24, arena);
+   BSON_ASSERT (a != b);
+   BSON_ASSERT (c != b);
+   BSON_ASSERT (!memcmp (b, "aaaaaaaa", 8));
+
+   /* oversized requests get a block of their own */
+   a = bson_arena_alloc (arena, 1000);
+   memset (a, 0, 1000);
+
+   bson_arena_reset (arena);
+   c = bson_arena_alloc (arena, 8);
+   BSON_ASSERT (c != NULL);
+
+   bson_arena_destroy (arena);
+}
+
+
+static void
+test_bson_template (void)
+{
+   bson_template_t *tmpl;
+   bson_value_t values[4];
+   bson_t expected = BSON_INITIALIZER;
+   bson_t bson = BSON_INITIALIZER;
+   int i;
+
+   tmpl = bson_template_new ();
+   BSON_ASSERT (bson_template_add (tmpl, "getMore", BSON_TYPE_INT64));
+   BSON_ASSERT (bson_template_add (tmpl, "batchSize", BSON_TYPE_INT32));
+   BSON_ASSERT (bson_template_add (tmpl, "ok", BSON_TYPE_BOOL));
+   BSON_ASSERT (bson_template_add (tmpl, "n", BSON_TYPE_NULL));
+   ASSERT_CMPUINT32 (bson_template_n_fields (tmpl), ==, 4);
+   ASSERT_CMPUINT32 (bson_template_size (tmpl), ==, 40);
+
+   values[0].value_type = BSON_TYPE_INT64;
+   values[1].value_type = BSON_TYPE_INT32;
+   values[2].value_type = BSON_TYPE_BOOL;
+   values[3].value_type = BSON_TYPE_NULL;
+
+   /* append the same shape many times, crossing from inline to heap */
+   for (i = 0; i < 100; i++) {
+      values[0].value.v_int64 = 1234567890123LL + i;
+      values[1].value.v_int32 = -i;
+      values[2].value.v_bool = i % 2;
+      BSON_ASSERT (bson_template_append (tmpl, &bson, values));
+
+      BSON_ASSERT (
+         bson_append_int64 (&expected, "getMore", -1, 1234567890123LL + i));
+      BSON_ASSERT (bson_append_int32 (&expected, "batchSize", -1, -i));
+      BSON_ASSERT (bson_append_bool (&expected, "ok", -1, i % 2));
+      BSON_ASSERT (bson_append_null (&expected, "n", -1));
+
+      ASSERT_CMPUINT32 (bson.len, ==, 5 + (i + 1) * 40);
+   }
+
+   bson_eq_bson (&bson, &expected);
+
+   bson_destroy (&bson);
+   bson_destroy (&expected);
+   bson_template_destroy (tmpl);
+}
+
+
+static void
+test_bson_template_variable (void)
+{
+   bson_template_t *tmpl;
+   bson_value_t values[9];
+   bson_t expected = BSON_INITIALIZER;
+   bson_t bson = BSON_INITIALIZER;
+   bson_t *doc;
+   bson_t *arr;
+   bson_oid_t oid;
+   bson_decimal128_t dec;
+   uint8_t uuid[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+   doc = BCON_NEW ("a", BCON_INT32 (1));
+   arr = BCON_NEW ("0", "x", "1", "y");
+   bson_oid_init_from_string (&oid, "000102030405060708090a0b");
+   BSON_ASSERT (bson_decimal128_from_string ("1.5", &dec));
+
+   tmpl = bson_template_new ();
+   BSON_ASSERT (bson_template_add (tmpl, "find", BSON_TYPE_UTF8));
+   BSON_ASSERT (bson_template_add (tmpl, "filter", BSON_TYPE_DOCUMENT));
+   BSON_ASSERT (bson_template_add (tmpl, "d", BSON_TYPE_DOUBLE));
+   BSON_ASSERT (bson_template_add (tmpl, "arr", BSON_TYPE_ARRAY));
+   BSON_ASSERT (bson_template_add (tmpl, "_id", BSON_TYPE_OID));
+   BSON_ASSERT (bson_template_add (tmpl, "id", BSON_TYPE_BINARY));
+   BSON_ASSERT (bson_template_add (tmpl, "when", BSON_TYPE_DATE_TIME));
+   BSON_ASSERT (bson_template_add (tmpl, "ts", BSON_TYPE_TIMESTAMP));
+   BSON_ASSERT (bson_template_add (tmpl, "dec", BSON_TYPE_DECIMAL128));
+
+   values[0].value_type = BSON_TYPE_UTF8;
+   values[0].value.v_utf8.str = "coll";
+   values[0].value.v_utf8.len = 4;
+   values[1].value_type = BSON_TYPE_DOCUMENT;
+   values[1].value.v_doc.data = (uint8_t *) bson_get_data (doc);
+   values[1].value.v_doc.data_len = doc->len;
+   values[2].value_type = BSON_TYPE_DOUBLE;
+   values[2].value.v_double = 1.25;
+   values[3].value_type = BSON_TYPE_ARRAY;
+   values[3].value.v_doc.data = (uint8_t *) bson_get_data (arr);
+   values[3].value.v_doc.data_len = arr->len;
+   values[4].value_type = BSON_TYPE_OID;
+   bson_oid_copy (&oid, &values[4].value.v_oid);
+   values[5].value_type = BSON_TYPE_BINARY;
+   values[5].value.v_binary.subtype = BSON_SUBTYPE_UUID;
+   values[5].value.v_binary.data = uuid;
+   values[5].value.v_binary.data_len = sizeof uuid;
+   values[6].value_type = BSON_TYPE_DATE_TIME;
+   values[6].value.v_datetime = 1500000000000LL;
+   values[7].value_type = BSON_TYPE_TIMESTAMP;
+   values[7].value.v_timestamp.timestamp = 100;
+   values[7].value.v_timestamp.increment = 7;
+   values[8].value_type = BSON_TYPE_DECIMAL128;
+   values[8].value.v_decimal128 = dec;
+
+   /* appending after existing elements */
+   BSON_ASSERT (bson_append_int32 (&bson, "first", -1, 0));
+   BSON_ASSERT (bson_template_append (tmpl, &bson, values));
+
+   BSON_ASSERT (bson_append_int32 (&expected, "first", -1, 0));
+   BSON_ASSERT (bson_append_utf8 (&expected, "find", -1, "coll", 4));
+   BSON_ASSERT (bson_append_document (&expected, "filter", -1, doc));
+   BSON_ASSERT (bson_append_double (&expected, "d", -1, 1.25));
+   BSON_ASSERT (bson_append_array (&expected, "arr", -1, arr));
+   BSON_ASSERT (bson_append_oid (&expected, "_id", -1, &oid));
+   BSON_ASSERT (bson_append_binary (
+      &expected, "id", -1, BSON_SUBTYPE_UUID, uuid, sizeof uuid));
+   BSON_ASSERT (bson_append_date_time (&expected, "when", -1, 1500000000000LL));
+   BSON_ASSERT (bson_append_timestamp (&expected, "ts", -1, 100, 7));
+   BSON_ASSERT (bson_append_decimal128 (&expected, "dec", -1, &dec));
+
+   bson_eq_bson (&bson, &expected);
+   BSON_ASSERT (bson_validate (&bson, BSON_VALIDATE_NONE, NULL));
+
+   bson_destroy (&bson);
+   bson_destroy (&expected);
+   bson_destroy (doc);
+   bson_destroy (arr);
+   bson_template_destroy (tmpl);
+}
+
+
+static void
+test_bson_template_errors (void)
+{
+   bson_template_t *tmpl;
+   bson_value_t values[2];
+   bson_t bson = BSON_INITIALIZER;
+
+   tmpl = bson_template_new ();
+   BSON_ASSERT (!bson_template_add (tmpl, "r", BSON_TYPE_REGEX));
+   BSON_ASSERT (!bson_template_add (tmpl, "c", BSON_TYPE_CODE));
+   BSON_ASSERT (!bson_template_add (tmpl, "e", BSON_TYPE_EOD));
+   ASSERT_CMPUINT32 (bson_template_n_fields (tmpl), ==, 0);
+
+   /* an empty template appends nothing */
+   BSON_ASSERT (bson_template_append (tmpl, &bson, NULL));
+   ASSERT_CMPUINT32 (bson.len, ==, 5);
+
+   BSON_ASSERT (bson_template_add (tmpl, "a", BSON_TYPE_INT32));
+   BSON_ASSERT (bson_template_add (tmpl, "b", BSON_TYPE_DOCUMENT));
+
+   /* a value of the wrong type */
+   values[0].value_type = BSON_TYPE_INT64;
+   values[0].value.v_int64 = 1;
+   values[1].value_type = BSON_TYPE_DOCUMENT;
+   values[1].value.v_doc.data = (uint8_t *) bson_get_data (&bson);
+   values[1].value.v_doc.data_len = bson.len;
+   BSON_ASSERT (!bson_template_append (tmpl, &bson, values));
+
+   /* a document that is too short */
+   values[0].value_type = BSON_TYPE_INT32;
+   values[0].value.v_int32 = 1;
+   values[1].value.v_doc.data_len = 4;
+   BSON_ASSERT (!bson_template_append (tmpl, &bson, values));
+
+   ASSERT_CMPUINT32 (bson.len, ==, 5);
+
+   bson_destroy (&bson);
+   bson_template_destroy (tmpl);
+}
+
+
 void
 test_bson_install (TestSuite *suite)
 {
@@ -2534,6 +2855,7 @@ test_bson_install (TestSuite *suite)
       suite, "/bson/reserve_buffer/errors", test_bson_reserve_buffer_errors);
    TestSuite_Add (
       suite, "/bson/destroy_with_steal", test_bson_destroy_with_steal);
+   TestSuite_Add (suite, "/bson/init_adopt", test_bson_init_adopt);
    TestSuite_Add (suite, "/bson/has_field", test_bson_has_field);
    TestSuite_Add (
       suite, "/bson/visit_invalid_field", test_bson_visit_invalid_field);
@@ -2556,4 +2878,10 @@ test_bson_install (TestSuite *suite)
    TestSuite_Add (
       suite, "/bson/value/null_handling", test_bson_binary_null_handling);
    TestSuite_Add (suite, "/bson/append_null_from_utf8_or_symbol", test_bson_append_null_from_utf8_or_symbol);
+   TestSuite_Add (suite, "/bson/arena", test_bson_arena);
+   TestSuite_Add (suite, "/bson/arena/realloc", test_bson_arena_realloc);
+   TestSuite_Add (suite, "/bson/template", test_bson_template);
+   TestSuite_Add (
+      suite, "/bson/template/variable", test_bson_template_variable);
+   TestSuite_Add (suite, "/bson/template/errors", test_bson_template_errors);
 }
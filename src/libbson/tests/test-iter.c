@@ -723,6 +723,79 @@ test_bson_iter_from_data (void)
    ASSERT (bson_iter_bool (&iter));
 }
 
+static void
+test_bson_index (void)
+{
+   bson_index_t *index;
+   bson_iter_t iter;
+   bson_iter_t expected;
+   char key[16];
+   bson_t b;
+   int i;
+
+   bson_init (&b);
+
+   for (i = 0; i < 500; i++) {
+      bson_snprintf (key, sizeof key, "key%d", i);
+      BSON_ASSERT (bson_append_int32 (&b, key, -1, i));
+   }
+
+   /* the first of two duplicate keys wins, as with bson_iter_find */
+   BSON_ASSERT (BSON_APPEND_INT32 (&b, "key7", -1));
+   BSON_ASSERT (BSON_APPEND_UTF8 (&b, "", "empty"));
+
+   index = bson_index_new (&b);
+   BSON_ASSERT (index);
+   ASSERT_CMPUINT32 (bson_index_count (index), ==, 501);
+
+   for (i = 0; i < 500; i++) {
+      bson_snprintf (key, sizeof key, "key%d", i);
+      BSON_ASSERT (bson_index_find (index, key, &iter));
+      BSON_ASSERT (bson_iter_init_find (&expected, &b, key));
+      ASSERT_CMPINT32 (bson_iter_int32 (&iter), ==, i);
+      ASSERT_CMPUINT32 (
+         bson_iter_offset (&iter), ==, bson_iter_offset (&expected));
+
+      /* the iterator continues from the found field */
+      if (i < 499) {
+         BSON_ASSERT (bson_iter_next (&iter));
+         ASSERT_CMPINT32 (bson_iter_int32 (&iter), ==, i + 1);
+      }
+   }
+
+   BSON_ASSERT (bson_index_find (index, "", &iter));
+   ASSERT_CMPSTR (bson_iter_utf8 (&iter, NULL), "empty");
+   BSON_ASSERT (bson_index_find_w_len (index, "key12345", 5, &iter));
+   ASSERT_CMPINT32 (bson_iter_int32 (&iter), ==, 12);
+   BSON_ASSERT (!bson_index_find (index, "key500", &iter));
+   BSON_ASSERT (!bson_index_find (index, "key", &iter));
+
+   bson_index_destroy (index);
+   bson_destroy (&b);
+
+   bson_init (&b);
+   index = bson_index_new (&b);
+   BSON_ASSERT (index);
+   ASSERT_CMPUINT32 (bson_index_count (index), ==, 0);
+   BSON_ASSERT (!bson_index_find (index, "a", &iter));
+   bson_index_destroy (index);
+   bson_destroy (&b);
+}
+
+
+static void
+test_bson_index_corrupt (void)
+{
+   /* {"a": 1, "b": 1} with the second element's type byte corrupted */
+   uint8_t data[] = "\x13\x00\x00\x00\x10\x61\x00\x01\x00\x00\x00"
+                    "\xff\x62\x00\x01\x00\x00\x00";
+   bson_t b;
+
+   BSON_ASSERT (bson_init_static (&b, data, sizeof data));
+   BSON_ASSERT (!bson_index_new (&b));
+}
+
+
 void
 test_iter_install (TestSuite *suite)
 {
@@ -774,4 +847,6 @@ test_iter_install (TestSuite *suite)
       suite, "/bson/iter/binary_deprecated", test_bson_iter_binary_deprecated);
    TestSuite_Add (suite, "/bson/iter/from_data", test_bson_iter_from_data);
    TestSuite_Add (suite, "/bson/iter/empty_key", test_bson_iter_empty_key);
+   TestSuite_Add (suite, "/bson/index", test_bson_index);
+   TestSuite_Add (suite, "/bson/index/corrupt", test_bson_index_corrupt);
 }
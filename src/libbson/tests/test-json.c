@@ -351,7 +351,6 @@ test_bson_as_json_double (void)
    size_t len;
    bson_t *b;
    char *str;
-   char *expected;
 
    b = bson_new ();
    BSON_ASSERT (bson_append_double (b, "foo", -1, 123.5));
@@ -359,19 +358,39 @@ test_bson_as_json_double (void)
    BSON_ASSERT (bson_append_double (b, "baz", -1, -1));
    BSON_ASSERT (bson_append_double (b, "quux", -1, 0.03125));
    BSON_ASSERT (bson_append_double (b, "huge", -1, 1e99));
+   BSON_ASSERT (bson_append_double (b, "zero", -1, 0.0));
+   BSON_ASSERT (bson_append_double (b, "negzero", -1, -0.0));
+   BSON_ASSERT (bson_append_double (b, "big", -1, 9007199254740991.0));
+   BSON_ASSERT (bson_append_double (b, "bigger", -1, 9007199254740992.0));
+   BSON_ASSERT (bson_append_double (b, "int64", -1, 1234567890123456768.0));
+   BSON_ASSERT (bson_append_double (b, "tenth", -1, 0.1));
+   BSON_ASSERT (bson_append_double (b, "small", -1, 1e-5));
+   BSON_ASSERT (bson_append_double (b, "tiny", -1, 4.9406564584124654e-324));
+   BSON_ASSERT (bson_append_double (b, "max", -1, 1.7976931348623157e308));
+   BSON_ASSERT (bson_append_double (b, "e19", -1, 1e19));
+   BSON_ASSERT (bson_append_double (b, "e20", -1, 1e20));
    str = bson_as_json (b, &len);
 
-   expected = bson_strdup_printf ("{"
-                                  " \"foo\" : 123.5,"
-                                  " \"bar\" : 3.0,"
-                                  " \"baz\" : -1.0,"
-                                  " \"quux\" : 0.03125,"
-                                  " \"huge\" : %.20g }",
-                                  1e99);
-
-   ASSERT_CMPSTR (str, expected);
+   /* the shortest string that reads back as the same double */
+   ASSERT_CMPSTR (str,
+                  "{"
+                  " \"foo\" : 123.5,"
+                  " \"bar\" : 3.0,"
+                  " \"baz\" : -1.0,"
+                  " \"quux\" : 0.03125,"
+                  " \"huge\" : 1e+99,"
+                  " \"zero\" : 0.0,"
+                  " \"negzero\" : -0.0,"
+                  " \"big\" : 9007199254740991.0,"
+                  " \"bigger\" : 9007199254740992.0,"
+                  " \"int64\" : 1234567890123456768.0,"
+                  " \"tenth\" : 0.1,"
+                  " \"small\" : 1e-05,"
+                  " \"tiny\" : 5e-324,"
+                  " \"max\" : 1.7976931348623157e+308,"
+                  " \"e19\" : 10000000000000000000.0,"
+                  " \"e20\" : 1e+20 }");
 
-   bson_free (expected);
    bson_free (str);
    bson_destroy (b);
 }
@@ -2065,6 +2084,77 @@ test_bson_json_double (void)
 }
 
 
+/* every double written by bson_as_json reads back unchanged */
+static void
+test_bson_json_double_roundtrip (void)
+{
+   const char *nums[] = {"0.1",
+                         "-0.0",
+                         "1.5e-7",
+                         "12e30",
+                         "1e23",
+                         "0.000123",
+                         "9007199254740993.0",
+                         "123456789012345678901234.5",
+                         "2.2250738585072011e-308",
+                         "4.9406564584124654e-324",
+                         "1.7976931348623157e308",
+                         NULL};
+   const char **p;
+   bson_t *b;
+   bson_t *b2;
+   bson_iter_t iter;
+   bson_iter_t iter2;
+   bson_error_t error;
+   char *json;
+   char *str;
+   double d;
+   double d2;
+   int i;
+
+   b = bson_new ();
+
+   for (p = nums; *p; p++) {
+      BSON_ASSERT (bson_append_double (b, *p, -1, strtod (*p, NULL)));
+   }
+
+   for (i = 0; i < 1000; i++) {
+      str = bson_strdup_printf ("%d", i);
+      d = (i * 7919 + 1) / (double) (i % 997 + 1) * pow (10, i % 600 - 300);
+      BSON_ASSERT (bson_append_double (b, str, -1, d));
+      bson_free (str);
+   }
+
+   json = bson_as_relaxed_extended_json (b, NULL);
+   b2 = bson_new_from_json ((const uint8_t *) json, -1, &error);
+   ASSERT_OR_PRINT (b2, error);
+
+   BSON_ASSERT (bson_iter_init (&iter, b));
+   BSON_ASSERT (bson_iter_init (&iter2, b2));
+
+   while (bson_iter_next (&iter)) {
+      BSON_ASSERT (bson_iter_next (&iter2));
+      ASSERT_CMPSTR (bson_iter_key (&iter), bson_iter_key (&iter2));
+      BSON_ASSERT (BSON_ITER_HOLDS_DOUBLE (&iter2));
+      /* compare bits, to distinguish 0.0 and -0.0 */
+      d = bson_iter_double (&iter);
+      d2 = bson_iter_double (&iter2);
+      if (memcmp (&d, &d2, sizeof d)) {
+         fprintf (stderr,
+                  "%s: %.17g != %.17g\n",
+                  bson_iter_key (&iter),
+                  d,
+                  d2);
+         abort ();
+      }
+   }
+
+   bson_free (json);
+   bson_destroy (b2);
+   bson_destroy (b);
+}
+
+
 static void
 test_bson_json_double_overflow (void)
 {
@@ -2841,6 +2931,132 @@ test_bson_as_json_multi_object (void)
    TEST_JSON_PRODUCES_MULTIPLE ("[],[{'a': 1}]", 1, NULL);
 }
 
+static bool
+_json_writer_append_cb (void *handle, const char *data, size_t len)
+{
+   bson_string_t *out = (bson_string_t *) handle;
+   char *chunk;
+
+   chunk = bson_strndup (data, len);
+   bson_string_append (out, chunk);
+   bson_free (chunk);
+
+   return true;
+}
+
+
+static bool
+_json_writer_fail_cb (void *handle, const char *data, size_t len)
+{
+   int *calls = (int *) handle;
+
+   (*calls)++;
+
+   return false;
+}
+
+
+static void
+test_bson_json_writer (void)
+{
+   bson_json_writer_t *writer;
+   bson_string_t *out;
+   bson_error_t error;
+   bson_t *b;
+   bson_t empty = BSON_INITIALIZER;
+   char *expected;
+   int calls = 0;
+   int i;
+
+   b = tmp_bson ("{'a': [1, {'b': {'$numberLong': '-9223372036854775808'}}],"
+                 " 'c': {'$timestamp': {'t': 4294967295, 'i': 1}},"
+                 " 'd': {'$date': {'$numberLong': '-1'}},"
+                 " 'e': 1.5, 'f': 'string'}");
+
+   for (i = 0; i < 3; i++) {
+      out = bson_string_new (NULL);
+
+      /* a tiny chunk size flushes after every element */
+      writer = bson_json_writer_new (
+         out, _json_writer_append_cb, (bson_json_mode_t) i, 1);
+
+      ASSERT_OR_PRINT (bson_json_writer_write (writer, b, &error), error);
+      ASSERT_OR_PRINT (bson_json_writer_write (writer, &empty, &error), error);
+
+      switch ((bson_json_mode_t) i) {
+      case BSON_JSON_MODE_LEGACY:
+         expected = bson_as_json (b, NULL);
+         break;
+      case BSON_JSON_MODE_CANONICAL:
+         expected = bson_as_canonical_extended_json (b, NULL);
+         break;
+      case BSON_JSON_MODE_RELAXED:
+      default:
+         expected = bson_as_relaxed_extended_json (b, NULL);
+         break;
+      }
+
+      ASSERT_CMPSTR (out->str + out->len - 3, "{ }");
+      out->len -= 3;
+      out->str[out->len] = '\0';
+      ASSERT_CMPSTR (out->str, expected);
+
+      bson_free (expected);
+      bson_string_free (out, true);
+      bson_json_writer_destroy (writer);
+   }
+
+   /* the callback can abort */
+   writer = bson_json_writer_new (
+      &calls, _json_writer_fail_cb, BSON_JSON_MODE_RELAXED, 1);
+   BSON_ASSERT (!bson_json_writer_write (writer, b, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          BSON_ERROR_JSON,
+                          BSON_JSON_ERROR_WRITE_CB_FAILURE,
+                          "JSON writer callback failed");
+   ASSERT_CMPINT (calls, ==, 1);
+   bson_json_writer_destroy (writer);
+}
+
+
+static void
+test_bson_json_writer_corrupt (void)
+{
+   bson_json_writer_t *writer;
+   bson_string_t *out;
+   bson_error_t error;
+   uint8_t *buf;
+   bson_t b;
+   size_t buflen = 1024;
+   int fd;
+   ssize_t r;
+
+   buf = bson_malloc0 (buflen);
+
+   fd = bson_open (BSON_BINARY_DIR "/test57.bson", O_RDONLY);
+   BSON_ASSERT (-1 != fd);
+
+   r = bson_read (fd, buf, buflen);
+   BSON_ASSERT (r == 26);
+   BSON_ASSERT (bson_init_static (&b, buf, (uint32_t) r));
+
+   out = bson_string_new (NULL);
+   writer = bson_json_writer_new (
+      out, _json_writer_append_cb, BSON_JSON_MODE_CANONICAL, 0);
+
+   BSON_ASSERT (!bson_json_writer_write (writer, &b, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          BSON_ERROR_JSON,
+                          BSON_JSON_ERROR_WRITE_CORRUPT_BSON,
+                          "corrupt BSON");
+
+   bson_json_writer_destroy (writer);
+   bson_string_free (out, true);
+   bson_destroy (&b);
+   bson_free (buf);
+}
+
+
 void
 test_json_install (TestSuite *suite)
 {
@@ -2947,6 +3163,9 @@ test_json_install (TestSuite *suite)
    TestSuite_Add (suite, "/bson/json/read/int32", test_bson_json_int32);
    TestSuite_Add (suite, "/bson/json/read/int64", test_bson_json_int64);
    TestSuite_Add (suite, "/bson/json/read/double", test_bson_json_double);
+   TestSuite_Add (suite,
+                  "/bson/json/read/double/roundtrip",
+                  test_bson_json_double_roundtrip);
    TestSuite_Add (
       suite, "/bson/json/read/double/overflow", test_bson_json_double_overflow);
    TestSuite_Add (suite, "/bson/json/read/double/nan", test_bson_json_nan);
@@ -2965,4 +3184,7 @@ test_json_install (TestSuite *suite)
       suite, "/bson/json/read/null_in_str", test_bson_json_null_in_str);
    TestSuite_Add (
       suite, "/bson/as_json/multi_object", test_bson_as_json_multi_object);
+   TestSuite_Add (suite, "/bson/json/writer", test_bson_json_writer);
+   TestSuite_Add (
+      suite, "/bson/json/writer/corrupt", test_bson_json_writer_corrupt);
 }
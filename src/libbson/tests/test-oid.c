@@ -372,6 +372,26 @@ test_bson_oid_init_with_threads (void)
 
       bson_context_destroy (context);
    }
+
+   /*
+    * Test threaded generation of oids using a context with per-thread
+    * counter blocks.
+    */
+   {
+      bson_thread_t threads[N_THREADS];
+
+      context = bson_context_new (BSON_CONTEXT_THREAD_LOCAL);
+
+      for (i = 0; i < N_THREADS; i++) {
+         bson_thread_create (&threads[i], oid_worker, context);
+      }
+
+      for (i = 0; i < N_THREADS; i++) {
+         bson_thread_join (threads[i]);
+      }
+
+      bson_context_destroy (context);
+   }
 }
 
 
@@ -421,6 +441,50 @@ _parse_oid (bson_oid_t *oid, _parsed_oid_t *out)
 }
 
 
+static void
+test_bson_oid_init_n (void)
+{
+   bson_context_flags_t flags[] = {BSON_CONTEXT_NONE,
+                                   BSON_CONTEXT_THREAD_SAFE,
+                                   BSON_CONTEXT_THREAD_LOCAL};
+   bson_context_t *ctx;
+   bson_oid_t oids[1000];
+   bson_oid_t oid;
+   _parsed_oid_t first, parsed;
+   size_t i;
+   int j;
+
+   for (j = 0; j < sizeof flags / sizeof flags[0]; j++) {
+      ctx = bson_context_new (flags[j]);
+
+      /* a no-op */
+      bson_oid_init_n (NULL, 0, ctx);
+
+      bson_oid_init_n (oids, 1000, ctx);
+      _parse_oid (&oids[0], &first);
+
+      for (i = 1; i < 1000; i++) {
+         _parse_oid (&oids[i], &parsed);
+         ASSERT_CMPUINT64 (parsed.rand, ==, first.rand);
+         ASSERT_CMPUINT32 (parsed.timestamp, ==, first.timestamp);
+         ASSERT_CMPUINT32 (
+            parsed.counter, ==, (first.counter + (uint32_t) i) & 0xFFFFFF);
+      }
+
+      /* counters are not reused by later calls */
+      bson_oid_init (&oid, ctx);
+      _parse_oid (&oid, &parsed);
+      ASSERT_CMPUINT32 (parsed.counter, ==, (first.counter + 1000) & 0xFFFFFF);
+
+      bson_oid_init_n (oids, 10, ctx);
+      _parse_oid (&oids[0], &first);
+      BSON_ASSERT (((first.counter - parsed.counter) & 0xFFFFFF) > 0);
+
+      bson_context_destroy (ctx);
+   }
+}
+
+
 #ifndef _WIN32
 #include <sys/wait.h>
 
@@ -512,6 +576,34 @@ test_bson_oid_after_fork (void)
       ASSERT_CMPUINT32 (parent_2_parsed.counter, ==, parent_parsed.counter + 1);
    }
    bson_context_destroy (ctx);
+
+   /* per-thread counters still notice the fork. */
+   ctx = bson_context_new (BSON_CONTEXT_THREAD_LOCAL |
+                           BSON_CONTEXT_DISABLE_PID_CACHE);
+   bson_oid_init (&parent_oid, ctx);
+   _parse_oid (&parent_oid, &parent_parsed);
+   pid = fork ();
+   if (pid == 0) {
+      bson_oid_t child_oid;
+      _parsed_oid_t child_parsed;
+
+      bson_oid_init (&child_oid, ctx);
+      _parse_oid (&child_oid, &child_parsed);
+      ASSERT_CMPUINT64 (child_parsed.rand, !=, parent_parsed.rand);
+      BSON_ASSERT (0 != bson_oid_compare (&parent_oid, &child_oid));
+      exit (0);
+   } else {
+      bson_oid_t parent_2_oid;
+      _parsed_oid_t parent_2_parsed;
+
+      BSON_ASSERT (-1 != waitpid (pid, &child_exit_status, 0 /* opts */));
+      BSON_ASSERT (child_exit_status == 0);
+
+      bson_oid_init (&parent_2_oid, ctx);
+      _parse_oid (&parent_2_oid, &parent_2_parsed);
+      ASSERT_CMPUINT64 (parent_2_parsed.rand, ==, parent_parsed.rand);
+   }
+   bson_context_destroy (ctx);
 }
 #endif
 
@@ -581,6 +673,7 @@ test_oid_install (TestSuite *suite)
    TestSuite_Add (suite, "/bson/oid/get_time_t", test_bson_oid_get_time_t);
    TestSuite_Add (
       suite, "/bson/oid/counter_overflow", test_bson_oid_counter_overflow);
+   TestSuite_Add (suite, "/bson/oid/init_n", test_bson_oid_init_n);
 #ifndef _WIN32
    if (!TestSuite_NoFork (suite)) {
       TestSuite_Add (suite, "/bson/oid/after_fork", test_bson_oid_after_fork);
@@ -307,6 +307,235 @@ test_reader_reset (void)
 }
 
 
+static void
+test_reader_from_mmap (void)
+{
+   bson_reader_t *reader;
+   const bson_t *b;
+   const uint8_t *first = NULL;
+   bson_error_t error;
+   uint32_t i;
+   bool eof = true;
+
+   reader = bson_reader_new_from_mmap (BSON_BINARY_DIR "/stream.bson", &error);
+   ASSERT_OR_PRINT (reader, error);
+
+   for (i = 0; i < 1000; i++) {
+      ASSERT_CMPINT (5 * i, ==, (int) bson_reader_tell (reader));
+      eof = true;
+      b = bson_reader_read (reader, &eof);
+      BSON_ASSERT (b);
+      BSON_ASSERT (!eof);
+      ASSERT_CMPUINT32 (b->len, ==, (uint32_t) 5);
+
+      /* documents point into the mapping, not into a copy */
+      if (!i) {
+         first = bson_get_data (b);
+      }
+
+      BSON_ASSERT (bson_get_data (b) == first + 5 * i);
+   }
+
+   b = bson_reader_read (reader, &eof);
+   BSON_ASSERT (!b);
+   BSON_ASSERT (eof);
+   ASSERT_CMPINT (5000, ==, (int) bson_reader_tell (reader));
+
+   /* random access */
+   BSON_ASSERT (bson_reader_seek (reader, 2500));
+   ASSERT_CMPINT (2500, ==, (int) bson_reader_tell (reader));
+   b = bson_reader_read (reader, &eof);
+   BSON_ASSERT (b);
+   ASSERT_CMPINT (2505, ==, (int) bson_reader_tell (reader));
+
+   BSON_ASSERT (bson_reader_seek (reader, 5000));
+   BSON_ASSERT (!bson_reader_read (reader, &eof));
+   BSON_ASSERT (eof);
+
+   BSON_ASSERT (!bson_reader_seek (reader, 5001));
+   BSON_ASSERT (!bson_reader_seek (reader, -1));
+   ASSERT_CMPINT (5000, ==, (int) bson_reader_tell (reader));
+
+   bson_reader_reset (reader);
+   ASSERT_CMPINT (0, ==, (int) bson_reader_tell (reader));
+   BSON_ASSERT (bson_reader_read (reader, &eof));
+
+   bson_reader_destroy (reader);
+}
+
+
+static void
+test_reader_from_mmap_large_doc (void)
+{
+   bson_reader_t *reader;
+   bson_reader_t *file_reader;
+   const bson_t *b;
+   const bson_t *b2;
+   bson_error_t error;
+   bool eof = false;
+
+   reader =
+      bson_reader_new_from_mmap (BSON_BINARY_DIR "/readergrow.bson", &error);
+   ASSERT_OR_PRINT (reader, error);
+   file_reader =
+      bson_reader_new_from_file (BSON_BINARY_DIR "/readergrow.bson", &error);
+   ASSERT_OR_PRINT (file_reader, error);
+
+   b = bson_reader_read (reader, &eof);
+   BSON_ASSERT (b);
+   BSON_ASSERT (!eof);
+   b2 = bson_reader_read (file_reader, &eof);
+   BSON_ASSERT (b2);
+   BSON_ASSERT (bson_equal (b, b2));
+
+   BSON_ASSERT (!bson_reader_read (reader, &eof));
+   BSON_ASSERT (eof);
+
+   bson_reader_destroy (file_reader);
+   bson_reader_destroy (reader);
+}
+
+
+static void
+test_reader_from_mmap_missing (void)
+{
+   bson_error_t error;
+
+   BSON_ASSERT (!bson_reader_new_from_mmap (BSON_BINARY_DIR "/does-not-exist",
+                                            &error));
+   ASSERT_CMPUINT32 (error.domain, ==, (uint32_t) BSON_ERROR_READER);
+   ASSERT_CMPUINT32 (error.code, ==, (uint32_t) BSON_ERROR_READER_BADFD);
+}
+
+
+/* a stream of 1000 documents, where every 100th has a $-prefixed key */
+static uint8_t *
+_make_stream (size_t *len, size_t *offsets)
+{
+   uint8_t *buf = NULL;
+   bson_t *doc;
+   uint32_t i;
+
+   *len = 0;
+
+   for (i = 0; i < 1000; i++) {
+      doc = BCON_NEW (i % 100 == 7 ? "$bad" : "good", BCON_INT32 ((int32_t) i));
+      offsets[i] = *len;
+      buf = bson_realloc (buf, *len + doc->len);
+      memcpy (buf + *len, bson_get_data (doc), doc->len);
+      *len += doc->len;
+      bson_destroy (doc);
+   }
+
+   return buf;
+}
+
+
+static void
+test_stream_index (void)
+{
+   bson_stream_index_t *index;
+   bson_error_t error;
+   bson_iter_t iter;
+   bson_t view;
+   size_t offsets[1000];
+   size_t offset;
+   size_t len;
+   uint8_t *buf;
+   uint32_t n_threads;
+   uint32_t i;
+
+   buf = _make_stream (&len, offsets);
+
+   for (n_threads = 0; n_threads < 5; n_threads++) {
+      index =
+         bson_stream_index_new (buf, len, BSON_VALIDATE_DOLLAR_KEYS, n_threads);
+
+      ASSERT_CMPSIZE_T (bson_stream_index_count (index), ==, (size_t) 1000);
+
+      for (i = 0; i < 1000; i++) {
+         BSON_ASSERT (bson_stream_index_get (index, i, &view, &offset));
+         ASSERT_CMPSIZE_T (offset, ==, offsets[i]);
+         BSON_ASSERT (bson_get_data (&view) == buf + offset);
+         BSON_ASSERT (bson_iter_init (&iter, &view));
+         BSON_ASSERT (bson_iter_next (&iter));
+         ASSERT_CMPINT32 (bson_iter_int32 (&iter), ==, (int32_t) i);
+      }
+
+      BSON_ASSERT (!bson_stream_index_get (index, 1000, &view, &offset));
+
+      /* errors are reported in stream order */
+      ASSERT_CMPSIZE_T (bson_stream_index_n_errors (index), ==, (size_t) 10);
+
+      for (i = 0; i < 10; i++) {
+         BSON_ASSERT (
+            bson_stream_index_get_error (index, i, &offset, &error));
+         ASSERT_CMPSIZE_T (offset, ==, offsets[i * 100 + 7]);
+         ASSERT_ERROR_CONTAINS (error,
+                                BSON_ERROR_INVALID,
+                                BSON_VALIDATE_DOLLAR_KEYS,
+                                "keys cannot begin with \"$\": \"$bad\"");
+      }
+
+      BSON_ASSERT (!bson_stream_index_get_error (index, 10, &offset, &error));
+      bson_stream_index_destroy (index);
+   }
+
+   /* without the flag every document is valid */
+   index = bson_stream_index_new (buf, len, BSON_VALIDATE_NONE, 4);
+   ASSERT_CMPSIZE_T (bson_stream_index_count (index), ==, (size_t) 1000);
+   ASSERT_CMPSIZE_T (bson_stream_index_n_errors (index), ==, (size_t) 0);
+   bson_stream_index_destroy (index);
+
+   bson_free (buf);
+}
+
+
+static void
+test_stream_index_corrupt (void)
+{
+   bson_stream_index_t *index;
+   bson_error_t error;
+   size_t offsets[1000];
+   size_t offset;
+   size_t len;
+   uint8_t *buf;
+
+   buf = _make_stream (&len, offsets);
+
+   /* truncate the stream in the middle of the last document */
+   index = bson_stream_index_new (buf, len - 3, BSON_VALIDATE_NONE, 4);
+   ASSERT_CMPSIZE_T (bson_stream_index_count (index), ==, (size_t) 999);
+   ASSERT_CMPSIZE_T (bson_stream_index_n_errors (index), ==, (size_t) 1);
+   BSON_ASSERT (bson_stream_index_get_error (index, 0, &offset, &error));
+   ASSERT_CMPSIZE_T (offset, ==, offsets[999]);
+   ASSERT_ERROR_CONTAINS (error,
+                          BSON_ERROR_INVALID,
+                          BSON_VALIDATE_CORRUPT,
+                          "invalid document length");
+   bson_stream_index_destroy (index);
+
+   /* break a document's terminating NUL, framing continues past it */
+   buf[offsets[501] - 1] = 1;
+   index = bson_stream_index_new (buf, len, BSON_VALIDATE_NONE, 4);
+   ASSERT_CMPSIZE_T (bson_stream_index_count (index), ==, (size_t) 1000);
+   ASSERT_CMPSIZE_T (bson_stream_index_n_errors (index), ==, (size_t) 1);
+   BSON_ASSERT (bson_stream_index_get_error (index, 0, &offset, &error));
+   ASSERT_CMPSIZE_T (offset, ==, offsets[500]);
+   ASSERT_ERROR_CONTAINS (
+      error, BSON_ERROR_INVALID, BSON_VALIDATE_CORRUPT, "corrupt BSON");
+   bson_stream_index_destroy (index);
+
+   /* an empty stream */
+   index = bson_stream_index_new (buf, 0, BSON_VALIDATE_NONE, 4);
+   ASSERT_CMPSIZE_T (bson_stream_index_count (index), ==, (size_t) 0);
+   ASSERT_CMPSIZE_T (bson_stream_index_n_errors (index), ==, (size_t) 0);
+   bson_stream_index_destroy (index);
+
+   bson_free (buf);
+}
+
+
 void
 test_reader_install (TestSuite *suite)
 {
@@ -328,4 +557,14 @@ test_reader_install (TestSuite *suite)
                   test_reader_from_handle_corrupt);
    TestSuite_Add (suite, "/bson/reader/grow_buffer", test_reader_grow_buffer);
    TestSuite_Add (suite, "/bson/reader/reset", test_reader_reset);
+   TestSuite_Add (suite, "/bson/reader/new_from_mmap", test_reader_from_mmap);
+   TestSuite_Add (suite,
+                  "/bson/reader/new_from_mmap/large_doc",
+                  test_reader_from_mmap_large_doc);
+   TestSuite_Add (suite,
+                  "/bson/reader/new_from_mmap/missing",
+                  test_reader_from_mmap_missing);
+   TestSuite_Add (suite, "/bson/stream_index", test_stream_index);
+   TestSuite_Add (
+      suite, "/bson/stream_index/corrupt", test_stream_index_corrupt);
 }
@@ -58,6 +58,46 @@ test_bson_utf8_validate (void)
 }
 
 
+/* exercise the block-at-a-time ASCII scan with a bad byte at every offset */
+static void
+test_bson_utf8_validate_long (void)
+{
+   char buf[67];
+   size_t i;
+
+   memset (buf, 'a', sizeof buf);
+
+   for (i = 0; i < sizeof buf; i++) {
+      BSON_ASSERT (bson_utf8_validate (buf, i, false));
+      BSON_ASSERT (bson_utf8_validate (buf, sizeof buf, false));
+
+      buf[i] = '\0';
+      BSON_ASSERT (bson_utf8_validate (buf, sizeof buf, true));
+      BSON_ASSERT (!bson_utf8_validate (buf, sizeof buf, false));
+
+      buf[i] = (char) 0x80;
+      BSON_ASSERT (!bson_utf8_validate (buf, sizeof buf, true));
+      BSON_ASSERT (!bson_utf8_validate (buf, sizeof buf, false));
+
+      buf[i] = (char) 0x7f;
+      BSON_ASSERT (bson_utf8_validate (buf, sizeof buf, false));
+
+      if (i + 2 < sizeof buf) {
+         /* a well-formed euro sign, then truncated */
+         buf[i] = (char) 0xe2;
+         buf[i + 1] = (char) 0x82;
+         buf[i + 2] = (char) 0xac;
+         BSON_ASSERT (bson_utf8_validate (buf, sizeof buf, false));
+         BSON_ASSERT (!bson_utf8_validate (buf, i + 2, false));
+         buf[i + 1] = 'a';
+         buf[i + 2] = 'a';
+      }
+
+      buf[i] = 'a';
+   }
+}
+
+
 static void
 test_bson_utf8_escape_for_json (void)
 {
@@ -255,6 +295,8 @@ void
 test_utf8_install (TestSuite *suite)
 {
    TestSuite_Add (suite, "/bson/utf8/validate", test_bson_utf8_validate);
+   TestSuite_Add (
+      suite, "/bson/utf8/validate_long", test_bson_utf8_validate_long);
    TestSuite_Add (suite, "/bson/utf8/invalid", test_bson_utf8_invalid);
    TestSuite_Add (suite, "/bson/utf8/nil", test_bson_utf8_nil);
    TestSuite_Add (
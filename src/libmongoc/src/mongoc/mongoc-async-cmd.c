@@ -454,7 +454,7 @@ _mongoc_async_cmd_phase_recv_rpc (mongoc_async_cmd_t *acmd)
             sizeof (mongoc_rpc_header_t);
 
          buf = bson_malloc0 (len);
-         if (!_mongoc_rpc_decompress (&acmd->rpc, buf, len)) {
+         if (!_mongoc_rpc_decompress (&acmd->rpc, buf, len, NULL)) {
             bson_free (buf);
             bson_set_error (&acmd->error,
                             MONGOC_ERROR_PROTOCOL,
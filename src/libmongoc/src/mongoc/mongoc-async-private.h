@@ -21,6 +21,7 @@
 
 #include <bson/bson.h>
 #include "mongoc-stream.h"
+#include "mongoc-socket-private.h"
 
 BSON_BEGIN_DECLS
 
@@ -30,6 +31,8 @@ typedef struct _mongoc_async {
    struct _mongoc_async_cmd *cmds;
    size_t ncmds;
    uint32_t request_id;
+   /* keeps the streams of the cmds registered between polls and runs */
+   mongoc_socket_poller_t *poller;
 } mongoc_async_t;
 
 typedef enum {
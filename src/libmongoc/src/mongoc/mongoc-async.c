@@ -22,6 +22,7 @@
 #include "utlist.h"
 #include "mongoc.h"
 #include "mongoc-socket-private.h"
+#include "mongoc-stream-private.h"
 #include "mongoc-util-private.h"
 
 #undef MONGOC_LOG_DOMAIN
@@ -33,6 +34,8 @@ mongoc_async_new ()
 {
    mongoc_async_t *async = (mongoc_async_t *) bson_malloc0 (sizeof (*async));
 
+   async->poller = _mongoc_socket_poller_new ();
+
    return async;
 }
 
@@ -46,6 +49,7 @@ mongoc_async_destroy (mongoc_async_t *async)
       mongoc_async_cmd_destroy (acmd);
    }
 
+   _mongoc_socket_poller_destroy (async->poller);
    bson_free (async);
 }
 
@@ -55,6 +59,9 @@ mongoc_async_run (mongoc_async_t *async)
    mongoc_async_cmd_t *acmd, *tmp;
    mongoc_async_cmd_t **acmds_polled = NULL;
    mongoc_stream_poll_t *poller = NULL;
+   mongoc_socket_poll_t *sds = NULL;
+   mongoc_stream_t *root;
+   bool all_sockets;
    int nstreams, i;
    ssize_t nactive = 0;
    int64_t now;
@@ -78,11 +85,14 @@ mongoc_async_run (mongoc_async_t *async)
             poller, sizeof (*poller) * async->ncmds);
          acmds_polled = (mongoc_async_cmd_t **) bson_realloc (
             acmds_polled, sizeof (*acmds_polled) * async->ncmds);
+         sds = (mongoc_socket_poll_t *) bson_realloc (
+            sds, sizeof (*sds) * async->ncmds);
          poll_size = async->ncmds;
       }
 
       expire_at = INT64_MAX;
       nstreams = 0;
+      all_sockets = true;
 
       /* check if any cmds are ready to be initiated. */
       DL_FOREACH_SAFE (async->cmds, acmd, tmp)
@@ -109,6 +119,14 @@ mongoc_async_run (mongoc_async_t *async)
             poller[nstreams].stream = acmd->stream;
             poller[nstreams].events = acmd->events;
             poller[nstreams].revents = 0;
+            root = mongoc_stream_get_root_stream (acmd->stream);
+            if (root->type == MONGOC_STREAM_SOCKET) {
+               sds[nstreams].socket = mongoc_stream_socket_get_socket (
+                  (mongoc_stream_socket_t *) root);
+               sds[nstreams].events = acmd->events;
+            } else {
+               all_sockets = false;
+            }
             expire_at = BSON_MIN (
                expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
             ++nstreams;
@@ -123,7 +141,15 @@ mongoc_async_run (mongoc_async_t *async)
       poll_timeout_msec = BSON_MAX (0, (expire_at - now) / 1000);
       BSON_ASSERT (poll_timeout_msec < INT32_MAX);
 
-      if (nstreams > 0) {
+      if (nstreams > 0 && all_sockets) {
+         /* poll the sockets with async->poller, which keeps them registered
+          * from one poll to the next */
+         nactive = _mongoc_socket_poller_poll (
+            async->poller, sds, nstreams, (int32_t) poll_timeout_msec);
+         for (i = 0; nactive > 0 && i < nstreams; i++) {
+            poller[i].revents = sds[i].revents;
+         }
+      } else if (nstreams > 0) {
          /* we need at least one stream to poll. */
          nactive =
             mongoc_stream_poll (poller, nstreams, (int32_t) poll_timeout_msec);
@@ -202,4 +228,5 @@ mongoc_async_run (mongoc_async_t *async)
 
    bson_free (poller);
    bson_free (acmds_polled);
+   bson_free (sds);
 }
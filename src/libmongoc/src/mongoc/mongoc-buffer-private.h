@@ -51,6 +51,9 @@ _mongoc_buffer_append (mongoc_buffer_t *buffer,
                        const uint8_t *data,
                        size_t data_size);
 
+void
+_mongoc_buffer_reserve (mongoc_buffer_t *buffer, size_t size);
+
 bool
 _mongoc_buffer_append_from_stream (mongoc_buffer_t *buffer,
                                    mongoc_stream_t *stream,
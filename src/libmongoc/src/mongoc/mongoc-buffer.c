@@ -121,6 +121,28 @@ _mongoc_buffer_clear (mongoc_buffer_t *buffer, bool zero)
 }
 
 
+/**
+ * _mongoc_buffer_reserve:
+ * @buffer: A mongoc_buffer_t.
+ * @size: The number of bytes to make room for.
+ *
+ * Grows @buffer, if needed, so that @size bytes can be written at
+ * buffer->data + buffer->len.
+ */
+void
+_mongoc_buffer_reserve (mongoc_buffer_t *buffer, size_t size)
+{
+   BSON_ASSERT (buffer);
+   BSON_ASSERT (buffer->len + size >= buffer->len);
+
+   if (!SPACE_FOR (buffer, size)) {
+      buffer->datalen = bson_next_power_of_two (buffer->len + size);
+      buffer->data = (uint8_t *) buffer->realloc_func (
+         buffer->data, buffer->datalen, buffer->realloc_data);
+   }
+}
+
+
 bool
 _mongoc_buffer_append (mongoc_buffer_t *buffer,
                        const uint8_t *data,
@@ -0,0 +1,714 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-client-async.h"
+#include "mongoc-buffer-private.h"
+#include "mongoc-client-private.h"
+#include "mongoc-cluster-private.h"
+#include "mongoc-cmd-private.h"
+#include "mongoc-error.h"
+#include "mongoc-opcode.h"
+#include "mongoc-read-prefs-private.h"
+#include "mongoc-rpc-private.h"
+#include "mongoc-server-stream-private.h"
+#include "mongoc-set-private.h"
+#include "mongoc-socket-private.h"
+#include "mongoc-stream-private.h"
+#include "mongoc-stream-socket.h"
+#include "mongoc-topology-private.h"
+#include "mongoc-trace-private.h"
+#include "utlist.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "client-async"
+
+
+/* a command that was submitted and has not completed */
+typedef struct _mongoc_client_async_op_t {
+   int32_t request_id;
+   int64_t expire_at; /* 0 if there is no socketTimeoutMS */
+   mongoc_client_async_cb_t cb;
+   void *cb_data;
+   bson_t reply;
+   bson_error_t error;
+   bool failed;
+   struct _mongoc_client_async_op_t *next;
+   struct _mongoc_client_async_op_t *prev;
+} mongoc_client_async_op_t;
+
+
+/* a connection from the client's cluster with commands in flight. the
+ * connection still belongs to the cluster, it is only borrowed until its
+ * last reply is read. */
+typedef struct _mongoc_client_async_conn_t {
+   uint32_t server_id;
+   mongoc_stream_t *stream;
+   int64_t timestamp;
+   int32_t max_msg_size;
+   mongoc_buffer_t out; /* messages not yet written */
+   size_t out_written;
+   mongoc_buffer_t in; /* the reply being read */
+   mongoc_client_async_op_t *ops;
+   struct _mongoc_client_async_conn_t *next;
+   struct _mongoc_client_async_conn_t *prev;
+} mongoc_client_async_conn_t;
+
+
+struct _mongoc_client_async_t {
+   mongoc_client_t *client;
+   mongoc_client_async_conn_t *conns;
+   mongoc_client_async_op_t *done; /* completed, callback not yet called */
+   size_t n_ops;
+};
+
+
+mongoc_client_async_t *
+mongoc_client_async_new (mongoc_client_t *client, bson_error_t *error)
+{
+   mongoc_client_async_t *async;
+
+   BSON_ASSERT (client);
+
+   /* a single-threaded client's connections are also used by the topology
+    * scanner, which would read the replies of commands in flight */
+   if (client->topology->single_threaded) {
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "Asynchronous commands require a client from a "
+                      "mongoc_client_pool_t");
+      return NULL;
+   }
+
+   async = (mongoc_client_async_t *) bson_malloc0 (sizeof *async);
+   async->client = client;
+
+   return async;
+}
+
+
+/* true if the cluster still has the connection @conn borrowed. the cluster
+ * replaces a connection when the server's description changes. */
+static bool
+_mongoc_client_async_conn_is_current (mongoc_client_async_t *async,
+                                      mongoc_client_async_conn_t *conn)
+{
+   mongoc_cluster_node_t *node;
+
+   node = (mongoc_cluster_node_t *) mongoc_set_get (
+      async->client->cluster.nodes, conn->server_id);
+
+   return node && node->stream == conn->stream &&
+          node->timestamp == conn->timestamp;
+}
+
+
+static mongoc_client_async_conn_t *
+_mongoc_client_async_conn_new (mongoc_client_async_t *async,
+                               mongoc_server_stream_t *server_stream)
+{
+   mongoc_client_async_conn_t *conn;
+   mongoc_cluster_node_t *node;
+
+   node = (mongoc_cluster_node_t *) mongoc_set_get (
+      async->client->cluster.nodes, server_stream->sd->id);
+   BSON_ASSERT (node && node->stream == server_stream->stream);
+
+   conn = (mongoc_client_async_conn_t *) bson_malloc0 (sizeof *conn);
+   conn->server_id = server_stream->sd->id;
+   conn->stream = server_stream->stream;
+   conn->timestamp = node->timestamp;
+   conn->max_msg_size = server_stream->sd->max_msg_size;
+   _mongoc_buffer_init (&conn->out, NULL, 0, NULL, NULL);
+   _mongoc_buffer_init (&conn->in, NULL, 0, NULL, NULL);
+
+   DL_APPEND (async->conns, conn);
+
+   return conn;
+}
+
+
+static void
+_mongoc_client_async_conn_destroy (mongoc_client_async_t *async,
+                                   mongoc_client_async_conn_t *conn)
+{
+   BSON_ASSERT (!conn->ops);
+
+   DL_DELETE (async->conns, conn);
+   _mongoc_buffer_destroy (&conn->out);
+   _mongoc_buffer_destroy (&conn->in);
+   bson_free (conn);
+}
+
+
+/* fail every command in flight on @conn and stop using it. replies that
+ * were not read would be read by the next command, so the cluster must
+ * disconnect. */
+static void
+_mongoc_client_async_conn_fail (mongoc_client_async_t *async,
+                                mongoc_client_async_conn_t *conn,
+                                const bson_error_t *error)
+{
+   mongoc_client_async_op_t *op;
+   mongoc_client_async_op_t *tmp;
+
+   if (_mongoc_client_async_conn_is_current (async, conn)) {
+      mongoc_cluster_disconnect_node (
+         &async->client->cluster, conn->server_id, true, error);
+   }
+
+   DL_FOREACH_SAFE (conn->ops, op, tmp)
+   {
+      DL_DELETE (conn->ops, op);
+      async->n_ops--;
+
+      bson_init (&op->reply);
+      memcpy (&op->error, error, sizeof (bson_error_t));
+      op->failed = true;
+      DL_APPEND (async->done, op);
+   }
+
+   _mongoc_client_async_conn_destroy (async, conn);
+}
+
+
+/* call the callbacks of completed commands, from mongoc_client_async_run
+ * or mongoc_client_async_destroy only. a callback may submit more commands;
+ * the ones that fail at once are completed by this same loop. */
+static void
+_mongoc_client_async_complete (mongoc_client_async_t *async)
+{
+   mongoc_client_async_op_t *op;
+
+   while ((op = async->done)) {
+      DL_DELETE (async->done, op);
+      op->cb (&op->reply, op->failed ? &op->error : NULL, op->cb_data);
+      bson_destroy (&op->reply);
+      bson_free (op);
+   }
+}
+
+
+void
+mongoc_client_async_destroy (mongoc_client_async_t *async)
+{
+   bson_error_t error;
+
+   if (!async) {
+      return;
+   }
+
+   bson_set_error (&error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_SOCKET,
+                   "Asynchronous command canceled");
+
+   while (async->conns) {
+      if (async->conns->ops) {
+         _mongoc_client_async_conn_fail (async, async->conns, &error);
+      } else {
+         _mongoc_client_async_conn_destroy (async, async->conns);
+      }
+   }
+
+   _mongoc_client_async_complete (async);
+
+   bson_free (async);
+}
+
+
+bool
+mongoc_client_async_command (mongoc_client_async_t *async,
+                             const char *db_name,
+                             const bson_t *command,
+                             const mongoc_read_prefs_t *read_prefs,
+                             mongoc_client_async_cb_t cb,
+                             void *cb_data,
+                             bson_error_t *error)
+{
+   mongoc_cluster_t *cluster;
+   mongoc_server_stream_t *server_stream;
+   mongoc_cmd_parts_t parts;
+   mongoc_client_async_conn_t *conn;
+   mongoc_client_async_op_t *op;
+   bson_error_t reset_error;
+   const bson_t *body;
+   uint8_t header[21];
+   int32_t msg_len;
+   int32_t request_id;
+   int32_t v;
+   bool ret = false;
+
+   ENTRY;
+
+   BSON_ASSERT (async);
+   BSON_ASSERT (db_name);
+   BSON_ASSERT (command);
+   BSON_ASSERT (cb);
+
+   if (!_mongoc_read_prefs_validate (read_prefs, error)) {
+      RETURN (false);
+   }
+
+   cluster = &async->client->cluster;
+   server_stream =
+      mongoc_cluster_stream_for_reads (cluster, read_prefs, NULL, NULL, error);
+   if (!server_stream) {
+      RETURN (false);
+   }
+
+   /* selecting a server may have replaced a connection that commands were
+    * waiting on */
+   bson_set_error (&reset_error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_SOCKET,
+                   "Connection was reset while the command was in flight");
+   for (;;) {
+      DL_FOREACH (async->conns, conn)
+      {
+         if (!_mongoc_client_async_conn_is_current (async, conn)) {
+            break;
+         }
+      }
+
+      if (!conn) {
+         break;
+      }
+
+      _mongoc_client_async_conn_fail (async, conn, &reset_error);
+   }
+
+   mongoc_cmd_parts_init (
+      &parts, async->client, db_name, MONGOC_QUERY_NONE, command);
+   parts.read_prefs = read_prefs;
+   /* commands in flight together must not share a session */
+   parts.prohibit_lsid = true;
+
+   if (server_stream->sd->max_wire_version < WIRE_VERSION_OP_MSG) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION,
+                      "Asynchronous commands require MongoDB 3.6 or later");
+      GOTO (done);
+   }
+
+   if (!mongoc_cmd_parts_assemble (&parts, server_stream, error)) {
+      GOTO (done);
+   }
+
+   body = parts.assembled.command;
+   msg_len = (int32_t) (sizeof header + body->len);
+   if (msg_len > server_stream->sd->max_msg_size) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_TOO_BIG,
+                      "Command of %d bytes exceeds the maximum message size",
+                      msg_len);
+      GOTO (done);
+   }
+
+   DL_FOREACH (async->conns, conn)
+   {
+      if (conn->server_id == server_stream->sd->id) {
+         break;
+      }
+   }
+
+   if (!conn) {
+      conn = _mongoc_client_async_conn_new (async, server_stream);
+   }
+
+   request_id = ++cluster->request_id;
+
+   /* an OP_MSG header, no flags, and one kind 0 section with the command */
+   v = BSON_UINT32_TO_LE (msg_len);
+   memcpy (header, &v, 4);
+   v = BSON_UINT32_TO_LE (request_id);
+   memcpy (header + 4, &v, 4);
+   v = 0;
+   memcpy (header + 8, &v, 4);
+   v = BSON_UINT32_TO_LE (MONGOC_OPCODE_MSG);
+   memcpy (header + 12, &v, 4);
+   v = 0;
+   memcpy (header + 16, &v, 4);
+   header[20] = 0;
+
+   _mongoc_buffer_append (&conn->out, header, sizeof header);
+   _mongoc_buffer_append (&conn->out, bson_get_data (body), body->len);
+
+   op = (mongoc_client_async_op_t *) bson_malloc0 (sizeof *op);
+   op->request_id = request_id;
+   if (cluster->sockettimeoutms > 0) {
+      op->expire_at = bson_get_monotonic_time () +
+                      (int64_t) cluster->sockettimeoutms * 1000;
+   }
+   op->cb = cb;
+   op->cb_data = cb_data;
+   DL_APPEND (conn->ops, op);
+   async->n_ops++;
+
+   ret = true;
+
+done:
+   mongoc_cmd_parts_cleanup (&parts);
+   mongoc_server_stream_cleanup (server_stream);
+
+   /* commands failed by a connection reset are reported by the next
+    * mongoc_client_async_run, not from inside this function */
+   RETURN (ret);
+}
+
+
+/* write as much of @conn's queued messages as the socket accepts. */
+static bool
+_mongoc_client_async_conn_write (mongoc_client_async_conn_t *conn,
+                                 bson_error_t *error)
+{
+   mongoc_iovec_t iov;
+   ssize_t n;
+
+   if (conn->out_written == conn->out.len) {
+      return true;
+   }
+
+   iov.iov_base = (char *) conn->out.data + conn->out_written;
+   iov.iov_len = conn->out.len - conn->out_written;
+
+   n = mongoc_stream_writev (conn->stream, &iov, 1, 0);
+   if (n <= 0 && mongoc_stream_should_retry (conn->stream)) {
+      return true;
+   }
+
+   if (n < 0) {
+      bson_set_error (error,
+                      MONGOC_ERROR_STREAM,
+                      MONGOC_ERROR_STREAM_SOCKET,
+                      "Failed to send asynchronous command");
+      return false;
+   }
+
+   conn->out_written += (size_t) n;
+   if (conn->out_written == conn->out.len) {
+      _mongoc_buffer_clear (&conn->out, false);
+      conn->out_written = 0;
+   }
+
+   return true;
+}
+
+
+/* decode the whole message in @conn's input buffer and complete the command
+ * it replies to. */
+static bool
+_mongoc_client_async_conn_reply (mongoc_client_async_t *async,
+                                 mongoc_client_async_conn_t *conn,
+                                 bson_error_t *error)
+{
+   mongoc_client_async_op_t *op;
+   mongoc_rpc_t rpc;
+   bson_t reply_local;
+   uint8_t *output = NULL;
+   size_t output_len;
+   int32_t response_to;
+   int32_t len;
+   bool ret = false;
+
+   if (!_mongoc_rpc_scatter (&rpc, conn->in.data, conn->in.len)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                      "Malformed message from server");
+      return false;
+   }
+
+   if (BSON_UINT32_FROM_LE (rpc.header.opcode) == MONGOC_OPCODE_COMPRESSED) {
+      output_len = BSON_UINT32_FROM_LE (rpc.compressed.uncompressed_size) +
+                   sizeof (mongoc_rpc_header_t);
+      output = bson_malloc (output_len);
+      if (!_mongoc_rpc_decompress (
+             &rpc, output, output_len, &async->client->cluster.compression)) {
+         bson_set_error (error,
+                         MONGOC_ERROR_PROTOCOL,
+                         MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                         "Could not decompress message from server");
+         GOTO (done);
+      }
+   }
+
+   _mongoc_rpc_swab_from_le (&rpc);
+
+   if (rpc.header.opcode != MONGOC_OPCODE_MSG) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                      "Unexpected opcode %d from server",
+                      rpc.header.opcode);
+      GOTO (done);
+   }
+
+   /* replies come in order, so this is almost always the first command */
+   response_to = rpc.header.response_to;
+   DL_FOREACH (conn->ops, op)
+   {
+      if (op->request_id == response_to) {
+         break;
+      }
+   }
+
+   if (!op) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                      "Reply to unexpected request id %d",
+                      response_to);
+      GOTO (done);
+   }
+
+   memcpy (&len, rpc.msg.sections[0].payload.bson_document, 4);
+   len = BSON_UINT32_FROM_LE (len);
+   if (!bson_init_static (
+          &reply_local, rpc.msg.sections[0].payload.bson_document, len)) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                      "Malformed reply document from server");
+      GOTO (done);
+   }
+
+   _mongoc_topology_update_cluster_time (async->client->topology,
+                                         &reply_local);
+
+   DL_DELETE (conn->ops, op);
+   async->n_ops--;
+
+   op->failed = !_mongoc_cmd_check_ok (
+      &reply_local, async->client->error_api_version, &op->error);
+   bson_copy_to (&reply_local, &op->reply);
+   DL_APPEND (async->done, op);
+
+   ret = true;
+
+done:
+   bson_free (output);
+
+   return ret;
+}
+
+
+/* read every whole reply available on @conn without blocking. */
+static bool
+_mongoc_client_async_conn_read (mongoc_client_async_t *async,
+                                mongoc_client_async_conn_t *conn,
+                                bson_error_t *error)
+{
+   int32_t msg_len;
+   size_t want;
+   ssize_t n;
+
+   while (conn->ops) {
+      if (conn->in.len < 4) {
+         want = 4 - conn->in.len;
+      } else {
+         memcpy (&msg_len, conn->in.data, 4);
+         msg_len = BSON_UINT32_FROM_LE (msg_len);
+         if (msg_len < 16 || msg_len > conn->max_msg_size) {
+            bson_set_error (
+               error,
+               MONGOC_ERROR_PROTOCOL,
+               MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+               "Message size %d is not within expected range 16-%d bytes",
+               msg_len,
+               conn->max_msg_size);
+            return false;
+         }
+
+         want = (size_t) msg_len - conn->in.len;
+      }
+
+      if (!want) {
+         if (!_mongoc_client_async_conn_reply (async, conn, error)) {
+            return false;
+         }
+
+         _mongoc_buffer_clear (&conn->in, false);
+         continue;
+      }
+
+      n = _mongoc_buffer_try_append_from_stream (
+         &conn->in, conn->stream, want, 0);
+      if (n <= 0 && mongoc_stream_should_retry (conn->stream)) {
+         return true;
+      }
+
+      if (n <= 0) {
+         bson_set_error (error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         n == 0 ? "Server closed connection."
+                                : "Failed to receive reply from server.");
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+static void
+_mongoc_client_async_conn_io (mongoc_client_async_t *async,
+                              mongoc_client_async_conn_t *conn)
+{
+   bson_error_t error;
+
+   if (!_mongoc_client_async_conn_write (conn, &error) ||
+       !_mongoc_client_async_conn_read (async, conn, &error)) {
+      _mongoc_client_async_conn_fail (async, conn, &error);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_client_async_run --
+ *
+ *       Make progress on every command in flight: write queued commands,
+ *       read the replies that have arrived, and call the callbacks of
+ *       completed commands. If nothing completes at once, wait up to
+ *       @timeout_msec for a connection to become ready.
+ *
+ * Returns:
+ *       The number of commands still in flight.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+size_t
+mongoc_client_async_run (mongoc_client_async_t *async, int32_t timeout_msec)
+{
+   mongoc_client_async_conn_t *conn;
+   mongoc_client_async_conn_t *tmp;
+   mongoc_client_async_conn_t **polled;
+   mongoc_stream_poll_t *poller;
+   bson_error_t error;
+   ssize_t nactive;
+   size_t nstreams = 0;
+   size_t i;
+   int64_t now;
+
+   ENTRY;
+
+   BSON_ASSERT (async);
+
+   DL_FOREACH_SAFE (async->conns, conn, tmp)
+   {
+      _mongoc_client_async_conn_io (async, conn);
+   }
+
+   DL_COUNT (async->conns, conn, i);
+
+   if (!async->done && timeout_msec != 0 && i > 0) {
+      poller = (mongoc_stream_poll_t *) bson_malloc (sizeof (*poller) * i);
+      polled = (mongoc_client_async_conn_t **) bson_malloc (sizeof (*polled) *
+                                                            i);
+
+      DL_FOREACH (async->conns, conn)
+      {
+         polled[nstreams] = conn;
+         poller[nstreams].stream = conn->stream;
+         poller[nstreams].events = POLLIN;
+         if (conn->out_written < conn->out.len) {
+            poller[nstreams].events |= POLLOUT;
+         }
+         poller[nstreams].revents = 0;
+         nstreams++;
+      }
+
+      nactive = mongoc_stream_poll (poller, nstreams, timeout_msec);
+
+      for (i = 0; i < nstreams && nactive > 0; i++) {
+         if (poller[i].revents) {
+            _mongoc_client_async_conn_io (async, polled[i]);
+            nactive--;
+         }
+      }
+
+      bson_free (poller);
+      bson_free (polled);
+   }
+
+   /* the oldest command on a connection is first. if it timed out, the
+    * connection can't be used for the commands after it either. */
+   now = bson_get_monotonic_time ();
+   bson_set_error (&error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_SOCKET,
+                   "socket timeout");
+
+   DL_FOREACH_SAFE (async->conns, conn, tmp)
+   {
+      if (!conn->ops) {
+         /* idle, give the connection back to the client */
+         _mongoc_client_async_conn_destroy (async, conn);
+      } else if (conn->ops->expire_at && now > conn->ops->expire_at) {
+         _mongoc_client_async_conn_fail (async, conn, &error);
+      }
+   }
+
+   _mongoc_client_async_complete (async);
+
+   RETURN (async->n_ops);
+}
+
+
+size_t
+mongoc_client_async_get_fds (mongoc_client_async_t *async,
+                             int *fds,
+                             int *events,
+                             size_t n_fds)
+{
+   mongoc_client_async_conn_t *conn;
+   mongoc_stream_t *root;
+   mongoc_socket_t *sock;
+   size_t i = 0;
+
+   BSON_ASSERT (async);
+   BSON_ASSERT (fds || !n_fds);
+   BSON_ASSERT (events || !n_fds);
+
+   DL_FOREACH (async->conns, conn)
+   {
+      if (i < n_fds) {
+         root = mongoc_stream_get_root_stream (conn->stream);
+         if (root->type == MONGOC_STREAM_SOCKET) {
+            sock = mongoc_stream_socket_get_socket (
+               (mongoc_stream_socket_t *) root);
+            fds[i] = (int) sock->sd;
+         } else {
+            fds[i] = -1;
+         }
+
+         events[i] = POLLIN;
+         if (conn->out_written < conn->out.len) {
+            events[i] |= POLLOUT;
+         }
+      }
+
+      i++;
+   }
+
+   return i;
+}
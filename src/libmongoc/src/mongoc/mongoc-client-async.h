@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_CLIENT_ASYNC_H
+#define MONGOC_CLIENT_ASYNC_H
+
+#include <bson/bson.h>
+#include "mongoc-macros.h"
+#include "mongoc-client.h"
+#include "mongoc-read-prefs.h"
+
+BSON_BEGIN_DECLS
+
+typedef struct _mongoc_client_async_t mongoc_client_async_t;
+
+typedef void (*mongoc_client_async_cb_t) (const bson_t *reply,
+                                          const bson_error_t *error,
+                                          void *cb_data);
+
+MONGOC_EXPORT (mongoc_client_async_t *)
+mongoc_client_async_new (mongoc_client_t *client,
+                         bson_error_t *error) BSON_GNUC_WARN_UNUSED_RESULT;
+
+MONGOC_EXPORT (void)
+mongoc_client_async_destroy (mongoc_client_async_t *async);
+
+MONGOC_EXPORT (bool)
+mongoc_client_async_command (mongoc_client_async_t *async,
+                             const char *db_name,
+                             const bson_t *command,
+                             const mongoc_read_prefs_t *read_prefs,
+                             mongoc_client_async_cb_t cb,
+                             void *cb_data,
+                             bson_error_t *error);
+
+MONGOC_EXPORT (size_t)
+mongoc_client_async_run (mongoc_client_async_t *async, int32_t timeout_msec);
+
+MONGOC_EXPORT (size_t)
+mongoc_client_async_get_fds (mongoc_client_async_t *async,
+                             int *fds,
+                             int *events,
+                             size_t n_fds);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_CLIENT_ASYNC_H */
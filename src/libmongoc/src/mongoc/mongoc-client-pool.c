@@ -27,20 +27,55 @@
 #include "mongoc-thread-private.h"
 #include "mongoc-topology-private.h"
 #include "mongoc-trace-private.h"
+#include "utlist.h"
 
 #ifdef MONGOC_ENABLE_SSL
 #include "mongoc-ssl-private.h"
 #endif
 
-struct _mongoc_client_pool_t {
+#define MONGOC_CLIENT_POOL_MAX_SHARDS 64
+
+/* Idle clients are kept in several LIFO free lists. A thread pushes to and
+ * pops from the shard its id hashes to, taking only that shard's lock, and
+ * steals from the other shards when its own is empty. */
+typedef struct {
    bson_mutex_t mutex;
-   mongoc_cond_t cond;
    mongoc_queue_t queue;
+} mongoc_client_pool_shard_t;
+
+/* A thread blocked in mongoc_client_pool_pop. Waiters are served in the
+ * order they arrived: a pushed client is handed to the oldest one, and only
+ * the oldest one may create a client when the pool is below its max size. */
+typedef struct _mongoc_client_pool_waiter_t {
+   mongoc_cond_t cond;
+   /* set when a client is handed off and the waiter leaves the queue */
+   mongoc_client_t *client;
+   struct _mongoc_client_pool_waiter_t *prev;
+   struct _mongoc_client_pool_waiter_t *next;
+} mongoc_client_pool_waiter_t;
+
+struct _mongoc_client_pool_t {
+   /* protects size and the limits, and the wait queue */
+   bson_mutex_t mutex;
+   mongoc_client_pool_waiter_t *waiters;
+   mongoc_client_pool_shard_t *shards;
+   uint32_t n_shards;
+   /* idle clients in all shards, and threads in the wait queue */
+   volatile int32_t n_pushed;
+   volatile int32_t n_waiters;
+   /* how long mongoc_client_pool_pop waits, 0 means forever */
+   int32_t wait_queue_timeout_msec;
    mongoc_topology_t *topology;
    mongoc_uri_t *uri;
    uint32_t min_pool_size;
    uint32_t max_pool_size;
    uint32_t size;
+   /* idle connections to keep open to each server, by warm_thread */
+   uint32_t min_idle_connections;
+   mongoc_client_t *warm_client;
+   bson_thread_t warm_thread;
+   /* protected by the topology's mutex */
+   bool warm_shutdown;
 #ifdef MONGOC_ENABLE_SSL
    bool ssl_opts_set;
    mongoc_ssl_opt_t ssl_opts;
@@ -52,6 +87,12 @@ struct _mongoc_client_pool_t {
    bool error_api_set;
 };
 
+static void
+_initialize_new_client (mongoc_client_pool_t *pool, mongoc_client_t *client);
+
+static void
+_stop_warming (mongoc_client_pool_t *pool);
+
 
 #ifdef MONGOC_ENABLE_SSL
 void
@@ -88,6 +129,7 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
    const bson_t *b;
    bson_iter_t iter;
    const char *appname;
+   uint32_t i;
 
 
    ENTRY;
@@ -104,7 +146,15 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
 
    pool = (mongoc_client_pool_t *) bson_malloc0 (sizeof *pool);
    bson_mutex_init (&pool->mutex);
-   _mongoc_queue_init (&pool->queue);
+   pool->n_shards = BSON_MIN ((uint32_t) _mongoc_get_cpu_count (),
+                              MONGOC_CLIENT_POOL_MAX_SHARDS);
+   pool->n_shards = BSON_MAX (pool->n_shards, 1);
+   pool->shards = (mongoc_client_pool_shard_t *) bson_malloc0 (
+      pool->n_shards * sizeof (mongoc_client_pool_shard_t));
+   for (i = 0; i < pool->n_shards; i++) {
+      bson_mutex_init (&pool->shards[i].mutex);
+      _mongoc_queue_init (&pool->shards[i].queue);
+   }
    pool->uri = mongoc_uri_copy (uri);
    pool->min_pool_size = 0;
    pool->max_pool_size = 100;
@@ -133,6 +183,11 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
       }
    }
 
+   pool->min_idle_connections = (uint32_t) mongoc_uri_get_option_as_int32 (
+      pool->uri, MONGOC_URI_MINIDLECONNECTIONS, 0);
+   pool->wait_queue_timeout_msec = mongoc_uri_get_option_as_int32 (
+      pool->uri, MONGOC_URI_WAITQUEUETIMEOUTMS, 0);
+
    appname =
       mongoc_uri_get_option_as_utf8 (pool->uri, MONGOC_URI_APPNAME, NULL);
    if (appname) {
@@ -159,6 +214,8 @@ void
 mongoc_client_pool_destroy (mongoc_client_pool_t *pool)
 {
    mongoc_client_t *client;
+   mongoc_client_pool_shard_t *shard;
+   uint32_t i;
 
    ENTRY;
 
@@ -166,22 +223,31 @@ mongoc_client_pool_destroy (mongoc_client_pool_t *pool)
       EXIT;
    }
 
-   if (pool->topology->session_pool) {
-      client = mongoc_client_pool_pop (pool);
+   /* pop can time out if clients are still checked out */
+   if (pool->topology->session_pool &&
+       (client = mongoc_client_pool_pop (pool))) {
       _mongoc_client_end_sessions (client);
       mongoc_client_pool_push (pool, client);
    }
 
-   while (
-      (client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
-      mongoc_client_destroy (client);
+   _stop_warming (pool);
+
+   for (i = 0; i < pool->n_shards; i++) {
+      shard = &pool->shards[i];
+      while ((client =
+                 (mongoc_client_t *) _mongoc_queue_pop_head (&shard->queue))) {
+         mongoc_client_destroy (client);
+      }
+
+      bson_mutex_destroy (&shard->mutex);
    }
 
+   bson_free (pool->shards);
+
    mongoc_topology_destroy (pool->topology);
 
    mongoc_uri_destroy (pool->uri);
    bson_mutex_destroy (&pool->mutex);
-   mongoc_cond_destroy (&pool->cond);
 
 #ifdef MONGOC_ENABLE_SSL
    _mongoc_ssl_opts_cleanup (&pool->ssl_opts);
@@ -210,6 +276,130 @@ _start_scanner_if_needed (mongoc_client_pool_t *pool)
    }
 }
 
+/* top up the idle connections to each data-bearing server */
+static void
+_mongoc_client_pool_warm (mongoc_client_pool_t *pool)
+{
+   mongoc_topology_t *topology = pool->topology;
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_server_description_t *sd;
+   mongoc_array_t server_ids;
+   uint32_t server_id;
+   bson_error_t error;
+   bool shutdown;
+   size_t i;
+
+   _mongoc_array_init (&server_ids, sizeof (uint32_t));
+
+   /* don't hold the snapshot while connecting, it blocks the scanner */
+   snapshot = _mongoc_topology_snapshot_acquire (topology);
+   for (i = 0; i < snapshot->description.servers->items_len; i++) {
+      sd = (mongoc_server_description_t *) mongoc_set_get_item_and_id (
+         snapshot->description.servers, (int) i, &server_id);
+
+      if (sd->type == MONGOC_SERVER_STANDALONE ||
+          sd->type == MONGOC_SERVER_MONGOS ||
+          sd->type == MONGOC_SERVER_RS_PRIMARY ||
+          sd->type == MONGOC_SERVER_RS_SECONDARY) {
+         _mongoc_array_append_val (&server_ids, server_id);
+      }
+   }
+   _mongoc_topology_snapshot_release (snapshot);
+
+   for (i = 0; i < server_ids.len; i++) {
+      server_id = _mongoc_array_index (&server_ids, uint32_t, i);
+
+      while (_mongoc_connection_pool_n_idle (topology->connection_pool,
+                                             server_id) <
+             pool->min_idle_connections) {
+         bson_mutex_lock (&topology->mutex);
+         shutdown = pool->warm_shutdown;
+         bson_mutex_unlock (&topology->mutex);
+
+         /* on error, retry after the server's next check */
+         if (shutdown || !_mongoc_cluster_prewarm_node (
+                            &pool->warm_client->cluster, server_id, &error)) {
+            break;
+         }
+
+         mongoc_counter_client_pool_prewarmed_inc ();
+      }
+   }
+
+   _mongoc_array_destroy (&server_ids);
+}
+
+/* the warming thread runs whenever the scanner updates the topology, and at
+ * least every heartbeatFrequencyMS */
+static void *
+_mongoc_client_pool_run_warming (void *data)
+{
+   mongoc_client_pool_t *pool = (mongoc_client_pool_t *) data;
+   mongoc_topology_t *topology = pool->topology;
+
+   bson_mutex_lock (&topology->mutex);
+
+   while (!pool->warm_shutdown) {
+      bson_mutex_unlock (&topology->mutex);
+      _mongoc_client_pool_warm (pool);
+      bson_mutex_lock (&topology->mutex);
+
+      if (!pool->warm_shutdown) {
+         mongoc_cond_timedwait (&topology->cond_client,
+                                &topology->mutex,
+                                topology->description.heartbeat_msec);
+      }
+   }
+
+   bson_mutex_unlock (&topology->mutex);
+
+   return NULL;
+}
+
+/*
+ * Start pre-warming connections, if minIdleConnections is set.
+ *
+ * This function assumes the pool's mutex is locked
+ */
+static void
+_start_warming_if_needed (mongoc_client_pool_t *pool)
+{
+   int r;
+
+   if (!pool->min_idle_connections || pool->warm_client) {
+      return;
+   }
+
+   pool->warm_client = _mongoc_client_new_from_uri (pool->topology);
+   _initialize_new_client (pool, pool->warm_client);
+
+   r = bson_thread_create (
+      &pool->warm_thread, _mongoc_client_pool_run_warming, pool);
+
+   if (r != 0) {
+      MONGOC_ERROR ("could not start connection warming thread: %s",
+                    strerror (r));
+      abort ();
+   }
+}
+
+static void
+_stop_warming (mongoc_client_pool_t *pool)
+{
+   if (!pool->warm_client) {
+      return;
+   }
+
+   bson_mutex_lock (&pool->topology->mutex);
+   pool->warm_shutdown = true;
+   mongoc_cond_broadcast (&pool->topology->cond_client);
+   bson_mutex_unlock (&pool->topology->mutex);
+
+   bson_thread_join (pool->warm_thread);
+   mongoc_client_destroy (pool->warm_client);
+   pool->warm_client = NULL;
+}
+
 static void
 _initialize_new_client (mongoc_client_pool_t *pool, mongoc_client_t *client)
 {
@@ -230,32 +420,223 @@ _initialize_new_client (mongoc_client_pool_t *pool, mongoc_client_t *client)
 #endif
 }
 
+/* the shard for the calling thread */
+static mongoc_client_pool_shard_t *
+_mongoc_client_pool_get_shard (mongoc_client_pool_t *pool)
+{
+   uint64_t id;
+
+#ifdef _WIN32
+   id = (uint64_t) GetCurrentThreadId ();
+#else
+   id = (uint64_t) (uintptr_t) pthread_self ();
+#endif
+
+   /* thread ids are often aligned addresses, mix the bits before reducing */
+   id *= UINT64_C (0x9E3779B97F4A7C15);
+
+   return &pool->shards[(id >> 32) % pool->n_shards];
+}
+
+static mongoc_client_t *
+_mongoc_client_pool_shard_pop (mongoc_client_pool_t *pool,
+                               mongoc_client_pool_shard_t *shard)
+{
+   mongoc_client_t *client;
+
+   bson_mutex_lock (&shard->mutex);
+   client = (mongoc_client_t *) _mongoc_queue_pop_head (&shard->queue);
+   bson_mutex_unlock (&shard->mutex);
+
+   if (client) {
+      bson_atomic_int_add (&pool->n_pushed, -1);
+   }
+
+   return client;
+}
+
+/* pop an idle client from the calling thread's shard or, failing that, steal
+ * one from another shard. doesn't take the pool's mutex. */
+static mongoc_client_t *
+_mongoc_client_pool_pop_idle (mongoc_client_pool_t *pool)
+{
+   mongoc_client_pool_shard_t *shard;
+   mongoc_client_t *client;
+   uint32_t home;
+   uint32_t i;
+
+   shard = _mongoc_client_pool_get_shard (pool);
+   if ((client = _mongoc_client_pool_shard_pop (pool, shard))) {
+      return client;
+   }
+
+   if (!bson_atomic_int_add (&pool->n_pushed, 0)) {
+      return NULL;
+   }
+
+   home = (uint32_t) (shard - pool->shards);
+   for (i = 1; i < pool->n_shards; i++) {
+      shard = &pool->shards[(home + i) % pool->n_shards];
+      if ((client = _mongoc_client_pool_shard_pop (pool, shard))) {
+         mongoc_counter_client_pool_steals_inc ();
+         return client;
+      }
+   }
+
+   return NULL;
+}
+
+/* call this with the pool's mutex locked, when size < max_pool_size */
+static mongoc_client_t *
+_mongoc_client_pool_new_client (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t *client;
+
+   client = _mongoc_client_new_from_uri (pool->topology);
+   _initialize_new_client (pool, client);
+   pool->size++;
+
+   /* every pushed client was created here, so this is the only place a pop
+    * needs to start the scanner */
+   _start_scanner_if_needed (pool);
+   _start_warming_if_needed (pool);
+
+   return client;
+}
+
+static void
+_mongoc_client_pool_count_pop (int64_t started)
+{
+   int64_t usec;
+
+   usec = bson_get_monotonic_time () - started;
+
+   if (usec < 1000) {
+      mongoc_counter_client_pool_pops_1ms_inc ();
+   } else if (usec < 10 * 1000) {
+      mongoc_counter_client_pool_pops_10ms_inc ();
+   } else if (usec < 100 * 1000) {
+      mongoc_counter_client_pool_pops_100ms_inc ();
+   } else {
+      mongoc_counter_client_pool_pops_slow_inc ();
+   }
+}
+
+/* hand idle clients to waiting threads, oldest first, and let the oldest
+ * create one if there's room. call this with the pool's mutex locked */
+static void
+_mongoc_client_pool_serve_waiters (mongoc_client_pool_t *pool)
+{
+   mongoc_client_pool_waiter_t *waiter;
+   mongoc_client_t *client;
+
+   while ((waiter = pool->waiters) &&
+          (client = _mongoc_client_pool_pop_idle (pool))) {
+      DL_DELETE (pool->waiters, waiter);
+      bson_atomic_int_add (&pool->n_waiters, -1);
+      waiter->client = client;
+      mongoc_cond_signal (&waiter->cond);
+   }
+
+   if (pool->waiters && pool->size < pool->max_pool_size) {
+      mongoc_cond_signal (&pool->waiters->cond);
+   }
+}
+
+/* wait in line for a client until @expire_at, or forever if it's 0. call
+ * this with the pool's mutex locked */
+static mongoc_client_t *
+_mongoc_client_pool_wait (mongoc_client_pool_t *pool, int64_t expire_at)
+{
+   mongoc_client_pool_waiter_t waiter;
+   int64_t started;
+   int64_t now;
+
+   started = bson_get_monotonic_time ();
+   memset (&waiter, 0, sizeof waiter);
+   mongoc_cond_init (&waiter.cond);
+
+   /* mongoc_client_pool_push checks n_waiters after pushing, so count this
+    * thread as waiting before the last look at the shards */
+   DL_APPEND (pool->waiters, &waiter);
+   bson_atomic_int_add (&pool->n_waiters, 1);
+   _mongoc_client_pool_serve_waiters (pool);
+
+   while (!waiter.client) {
+      if (pool->waiters == &waiter && pool->size < pool->max_pool_size) {
+         DL_DELETE (pool->waiters, &waiter);
+         bson_atomic_int_add (&pool->n_waiters, -1);
+         waiter.client = _mongoc_client_pool_new_client (pool);
+         break;
+      }
+
+      if (!expire_at) {
+         mongoc_cond_wait (&waiter.cond, &pool->mutex);
+         continue;
+      }
+
+      now = bson_get_monotonic_time ();
+      if (now >= expire_at) {
+         DL_DELETE (pool->waiters, &waiter);
+         bson_atomic_int_add (&pool->n_waiters, -1);
+         mongoc_counter_client_pool_wait_timeouts_inc ();
+         break;
+      }
+
+      mongoc_cond_timedwait (
+         &waiter.cond, &pool->mutex, (expire_at - now + 999) / 1000);
+   }
+
+   /* the next waiter may be able to create a client now */
+   _mongoc_client_pool_serve_waiters (pool);
+
+   mongoc_cond_destroy (&waiter.cond);
+
+   mongoc_counter_client_pool_waits_inc ();
+   mongoc_counter_client_pool_wait_msec_add (
+      (bson_get_monotonic_time () - started) / 1000);
+
+   return waiter.client;
+}
+
 mongoc_client_t *
 mongoc_client_pool_pop (mongoc_client_pool_t *pool)
 {
    mongoc_client_t *client;
+   int64_t started;
+   int64_t expire_at = 0;
 
    ENTRY;
 
    BSON_ASSERT (pool);
 
+   started = bson_get_monotonic_time ();
+
+   /* don't jump the queue if other threads are waiting */
+   if (!bson_atomic_int_add (&pool->n_waiters, 0) &&
+       (client = _mongoc_client_pool_pop_idle (pool))) {
+      _mongoc_client_pool_count_pop (started);
+      RETURN (client);
+   }
+
+   if (pool->wait_queue_timeout_msec) {
+      expire_at = started + (int64_t) pool->wait_queue_timeout_msec * 1000;
+   }
+
    bson_mutex_lock (&pool->mutex);
 
-again:
-   if (!(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
-      if (pool->size < pool->max_pool_size) {
-         client = _mongoc_client_new_from_uri (pool->topology);
-         _initialize_new_client (pool, client);
-         pool->size++;
-      } else {
-         mongoc_cond_wait (&pool->cond, &pool->mutex);
-         GOTO (again);
-      }
+   if (!pool->waiters && pool->size < pool->max_pool_size) {
+      client = _mongoc_client_pool_new_client (pool);
+   } else {
+      client = _mongoc_client_pool_wait (pool, expire_at);
    }
 
-   _start_scanner_if_needed (pool);
    bson_mutex_unlock (&pool->mutex);
 
+   if (client) {
+      _mongoc_client_pool_count_pop (started);
+   }
+
    RETURN (client);
 }
 
@@ -269,19 +650,16 @@ mongoc_client_pool_try_pop (mongoc_client_pool_t *pool)
 
    BSON_ASSERT (pool);
 
+   if ((client = _mongoc_client_pool_pop_idle (pool))) {
+      RETURN (client);
+   }
+
    bson_mutex_lock (&pool->mutex);
 
-   if (!(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
-      if (pool->size < pool->max_pool_size) {
-         client = _mongoc_client_new_from_uri (pool->topology);
-         _initialize_new_client (pool, client);
-         pool->size++;
-      }
+   if (pool->size < pool->max_pool_size) {
+      client = _mongoc_client_pool_new_client (pool);
    }
 
-   if (client) {
-      _start_scanner_if_needed (pool);
-   }
    bson_mutex_unlock (&pool->mutex);
 
    RETURN (client);
@@ -291,26 +669,44 @@ mongoc_client_pool_try_pop (mongoc_client_pool_t *pool)
 void
 mongoc_client_pool_push (mongoc_client_pool_t *pool, mongoc_client_t *client)
 {
+   mongoc_client_pool_shard_t *shard;
+   mongoc_client_t *old_client = NULL;
+   int32_t n_pushed;
+
    ENTRY;
 
    BSON_ASSERT (pool);
    BSON_ASSERT (client);
 
-   bson_mutex_lock (&pool->mutex);
-   _mongoc_queue_push_head (&pool->queue, client);
-
-   if (pool->min_pool_size &&
-       _mongoc_queue_get_length (&pool->queue) > pool->min_pool_size) {
-      mongoc_client_t *old_client;
-      old_client = (mongoc_client_t *) _mongoc_queue_pop_tail (&pool->queue);
-      if (old_client) {
-         mongoc_client_destroy (old_client);
-         pool->size--;
-      }
+   /* share the client's connections with the pool's other clients */
+   _mongoc_cluster_release_nodes (&client->cluster);
+
+   shard = _mongoc_client_pool_get_shard (pool);
+
+   bson_mutex_lock (&shard->mutex);
+   _mongoc_queue_push_head (&shard->queue, client);
+   n_pushed = bson_atomic_int_add (&pool->n_pushed, 1);
+
+   /* keep at most min_pool_size idle clients, dropping this thread's oldest */
+   if (pool->min_pool_size && (uint32_t) n_pushed > pool->min_pool_size) {
+      old_client = (mongoc_client_t *) _mongoc_queue_pop_tail (&shard->queue);
+      bson_atomic_int_add (&pool->n_pushed, -1);
    }
 
-   mongoc_cond_signal (&pool->cond);
-   bson_mutex_unlock (&pool->mutex);
+   bson_mutex_unlock (&shard->mutex);
+
+   if (old_client) {
+      mongoc_client_destroy (old_client);
+
+      bson_mutex_lock (&pool->mutex);
+      pool->size--;
+      _mongoc_client_pool_serve_waiters (pool);
+      bson_mutex_unlock (&pool->mutex);
+   } else if (bson_atomic_int_add (&pool->n_waiters, 0)) {
+      bson_mutex_lock (&pool->mutex);
+      _mongoc_client_pool_serve_waiters (pool);
+      bson_mutex_unlock (&pool->mutex);
+   }
 
    EXIT;
 }
@@ -348,14 +744,20 @@ mongoc_client_pool_num_pushed (mongoc_client_pool_t *pool)
 
    ENTRY;
 
-   bson_mutex_lock (&pool->mutex);
-   num_pushed = pool->queue.length;
-   bson_mutex_unlock (&pool->mutex);
+   num_pushed = (size_t) bson_atomic_int_add (&pool->n_pushed, 0);
 
    RETURN (num_pushed);
 }
 
 
+/* for tests */
+size_t
+_mongoc_client_pool_num_waiters (mongoc_client_pool_t *pool)
+{
+   return (size_t) bson_atomic_int_add (&pool->n_waiters, 0);
+}
+
+
 mongoc_topology_t *
 _mongoc_client_pool_get_topology (mongoc_client_pool_t *pool)
 {
@@ -370,6 +772,7 @@ mongoc_client_pool_max_size (mongoc_client_pool_t *pool, uint32_t max_pool_size)
 
    bson_mutex_lock (&pool->mutex);
    pool->max_pool_size = max_pool_size;
+   _mongoc_client_pool_serve_waiters (pool);
    bson_mutex_unlock (&pool->mutex);
 
    EXIT;
@@ -642,6 +642,7 @@ _mongoc_client_session_handle_reply (mongoc_client_session_t *session,
                                      const bson_t *reply)
 {
    bson_iter_t iter;
+   bson_iter_t labels;
    uint32_t len;
    const uint8_t *data;
    bson_t cluster_time;
@@ -654,17 +655,25 @@ _mongoc_client_session_handle_reply (mongoc_client_session_t *session,
       return;
    }
 
-   if (mongoc_error_has_label (reply, "TransientTransactionError")) {
-      /* Transaction Spec: "Drivers MUST unpin a ClientSession when a command
-       * within a transaction, including commitTransaction and abortTransaction,
-       * fails with a TransientTransactionError". If the server reply included
-       * a TransientTransactionError, we unpin here. If a network error caused
-       * us to add a label client-side, we unpin in network_error_reply. */
-      session->server_id = 0;
-   }
-
+   /* find every field of interest in a single pass over the reply */
    while (bson_iter_next (&iter)) {
-      if (!strcmp (bson_iter_key (&iter), "$clusterTime") &&
+      if (!strcmp (bson_iter_key (&iter), "errorLabels") &&
+          bson_iter_recurse (&iter, &labels)) {
+         while (bson_iter_next (&labels)) {
+            if (BSON_ITER_HOLDS_UTF8 (&labels) &&
+                !strcmp (bson_iter_utf8 (&labels, NULL),
+                         "TransientTransactionError")) {
+               /* Transaction Spec: "Drivers MUST unpin a ClientSession when
+                * a command within a transaction, including commitTransaction
+                * and abortTransaction, fails with a
+                * TransientTransactionError". If the server reply included a
+                * TransientTransactionError, we unpin here. If a network
+                * error caused us to add a label client-side, we unpin in
+                * network_error_reply. */
+               session->server_id = 0;
+            }
+         }
+      } else if (!strcmp (bson_iter_key (&iter), "$clusterTime") &&
           BSON_ITER_HOLDS_DOCUMENT (&iter)) {
          bson_iter_document (&iter, &len, &data);
          BSON_ASSERT (bson_init_static (&cluster_time, data, (size_t) len));
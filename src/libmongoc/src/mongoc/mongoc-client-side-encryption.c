@@ -524,15 +524,29 @@ _prep_for_auto_encryption (const mongoc_cmd_t *cmd, bson_t *out)
  * enabled.
  * If @client_encrypted is single-threaded, use the client to mongocryptd.
  * If @client_encrypted is multi-threaded, use the client pool to mongocryptd.
+ * Returns NULL and sets @error if the pool's waitQueueTimeoutMS expires.
  */
 mongoc_client_t *
-_get_mongocryptd_client (mongoc_client_t *client_encrypted)
+_get_mongocryptd_client (mongoc_client_t *client_encrypted,
+                         bson_error_t *error)
 {
+   mongoc_client_t *mongocryptd_client;
+
    if (client_encrypted->topology->single_threaded) {
       return client_encrypted->topology->mongocryptd_client;
    }
-   return mongoc_client_pool_pop (
+
+   mongocryptd_client = mongoc_client_pool_pop (
       client_encrypted->topology->mongocryptd_client_pool);
+   if (!mongocryptd_client) {
+      bson_set_error (error,
+                      MONGOC_ERROR_SERVER_SELECTION,
+                      MONGOC_ERROR_SERVER_SELECTION_FAILURE,
+                      "Timed out waiting for a client from the mongocryptd "
+                      "client pool");
+   }
+
+   return mongocryptd_client;
 }
 
 void
@@ -557,9 +571,11 @@ _release_mongocryptd_client (mongoc_client_t *client_encrypted,
  * create the collection.
  * If @client_encrypted is multi-threaded, use the client pool to mongocryptd
  * to create the collection.
+ * Returns NULL and sets @error if the key vault client pool's
+ * waitQueueTimeoutMS expires.
  */
 mongoc_collection_t *
-_get_keyvault_coll (mongoc_client_t *client_encrypted)
+_get_keyvault_coll (mongoc_client_t *client_encrypted, bson_error_t *error)
 {
    mongoc_client_t *keyvault_client;
    const char *db;
@@ -578,6 +594,14 @@ _get_keyvault_coll (mongoc_client_t *client_encrypted)
       if (client_encrypted->topology->keyvault_client_pool) {
          keyvault_client = mongoc_client_pool_pop (
             client_encrypted->topology->keyvault_client_pool);
+         if (!keyvault_client) {
+            bson_set_error (error,
+                            MONGOC_ERROR_SERVER_SELECTION,
+                            MONGOC_ERROR_SERVER_SELECTION_FAILURE,
+                            "Timed out waiting for a client from the key "
+                            "vault client pool");
+            return NULL;
+         }
       } else {
          keyvault_client = client_encrypted;
       }
@@ -670,8 +694,15 @@ _mongoc_cse_auto_encrypt (mongoc_client_t *client_encrypted,
     * type 1 payload, convert it to a type 0 payload. */
    bson_destroy (&cmd_bson);
    _prep_for_auto_encryption (cmd, &cmd_bson);
-   keyvault_coll = _get_keyvault_coll (client_encrypted);
-   mongocryptd_client = _get_mongocryptd_client (client_encrypted);
+   keyvault_coll = _get_keyvault_coll (client_encrypted, error);
+   if (!keyvault_coll) {
+      GOTO (fail);
+   }
+
+   mongocryptd_client = _get_mongocryptd_client (client_encrypted, error);
+   if (!mongocryptd_client) {
+      GOTO (fail);
+   }
 
 retry:
    bson_destroy (encrypted);
@@ -757,7 +788,12 @@ _mongoc_cse_auto_decrypt (mongoc_client_t *client_encrypted,
 
    ENTRY;
 
-   keyvault_coll = _get_keyvault_coll (client_encrypted);
+   keyvault_coll = _get_keyvault_coll (client_encrypted, error);
+   if (!keyvault_coll) {
+      bson_init (decrypted);
+      GOTO (fail);
+   }
+
    if (!_mongoc_crypt_auto_decrypt (client_encrypted->topology->crypt,
                                     keyvault_coll,
                                     reply,
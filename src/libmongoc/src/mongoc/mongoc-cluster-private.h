@@ -51,8 +51,40 @@ typedef struct _mongoc_cluster_node_t {
    int32_t max_msg_size;
 
    int64_t timestamp;
+   /* when it was last returned to the topology's connection pool */
+   int64_t idle_since;
 } mongoc_cluster_node_t;
 
+#define MONGOC_CONNECTION_POOL_SHARDS 64
+
+/* the idle connections to the servers whose ids map to one shard. server
+ * ids are handed out in order, so servers rarely share a shard's lock. */
+typedef struct _mongoc_connection_pool_shard_t {
+   bson_mutex_t mutex;
+   /* server id -> mongoc_array_t of mongoc_cluster_node_t *, oldest first */
+   mongoc_set_t *servers;
+} mongoc_connection_pool_shard_t;
+
+/* Pooled mode: the idle connections of a client pool's clients, shared by
+ * all of them and owned by the topology. A client takes a connection to a
+ * server from here the first time it needs one after it is popped, and
+ * gives back all of its connections when it is pushed. */
+typedef struct _mongoc_connection_pool_t {
+   mongoc_connection_pool_shard_t shards[MONGOC_CONNECTION_POOL_SHARDS];
+   int64_t max_idle_time_msec;
+} mongoc_connection_pool_t;
+
+/* how well one command compresses for one server, sampled when the
+ * adaptivecompression URI option is set */
+typedef struct _mongoc_cluster_compression_stats_t {
+   uint32_t server_id;
+   char *command_name;
+   /* running average of compressed size / uncompressed size, per mille */
+   int32_t ratio;
+   /* messages sent uncompressed since the ratio was last sampled */
+   int32_t skipped;
+} mongoc_cluster_compression_stats_t;
+
 typedef struct _mongoc_cluster_t {
    int64_t operation_id;
    uint32_t request_id;
@@ -65,11 +97,44 @@ typedef struct _mongoc_cluster_t {
 
    mongoc_set_t *nodes;
    mongoc_array_t iov;
+   /* OP_MSG replies are read into this buffer, kept between commands */
+   mongoc_buffer_t reply_buffer;
+   /* outgoing messages are compressed into this buffer, kept between
+    * commands */
+   mongoc_buffer_t compress_buffer;
+   /* compressed OP_MSG replies that are only borrowed are decompressed into
+    * this buffer, kept between commands */
+   mongoc_buffer_t decompress_buffer;
+   /* zlib and zstd state for compressing and decompressing messages */
+   mongoc_compression_ctx_t compression;
+   /* smaller messages are sent uncompressed */
+   int32_t compression_threshold;
+   bool adaptive_compression;
+   /* array of mongoc_cluster_compression_stats_t */
+   mongoc_array_t compression_stats;
 
    mongoc_scram_cache_t *scram_cache;
 } mongoc_cluster_t;
 
 
+mongoc_connection_pool_t *
+_mongoc_connection_pool_new (const mongoc_uri_t *uri);
+
+void
+_mongoc_connection_pool_destroy (mongoc_connection_pool_t *pool);
+
+void
+_mongoc_cluster_release_nodes (mongoc_cluster_t *cluster);
+
+size_t
+_mongoc_connection_pool_n_idle (mongoc_connection_pool_t *pool,
+                                uint32_t server_id);
+
+bool
+_mongoc_cluster_prewarm_node (mongoc_cluster_t *cluster,
+                              uint32_t server_id,
+                              bson_error_t *error);
+
 void
 mongoc_cluster_init (mongoc_cluster_t *cluster,
                      const mongoc_uri_t *uri,
@@ -90,6 +155,19 @@ mongoc_cluster_get_max_bson_obj_size (mongoc_cluster_t *cluster);
 int32_t
 mongoc_cluster_get_max_msg_size (mongoc_cluster_t *cluster);
 
+bool
+_mongoc_cluster_should_compress (mongoc_cluster_t *cluster,
+                                 uint32_t server_id,
+                                 const char *command_name,
+                                 size_t size);
+
+void
+_mongoc_cluster_sample_compression (mongoc_cluster_t *cluster,
+                                    uint32_t server_id,
+                                    const char *command_name,
+                                    size_t size,
+                                    size_t compressed_size);
+
 size_t
 _mongoc_cluster_buffer_iovec (mongoc_iovec_t *iov,
                               size_t iovcnt,
@@ -61,6 +61,18 @@
 
 #define IS_NOT_COMMAND(_name) (!!strcasecmp (cmd->command_name, _name))
 
+/* with adaptivecompression, commands that don't compress to at most this
+ * fraction (per mille) of their size are sent uncompressed, and compressed
+ * again every MONGOC_CLUSTER_COMPRESSION_RESAMPLE messages */
+#define MONGOC_CLUSTER_COMPRESSION_RATIO_MAX 900
+#define MONGOC_CLUSTER_COMPRESSION_RESAMPLE 32
+/* the stats are reset if this many server / command pairs were sampled */
+#define MONGOC_CLUSTER_COMPRESSION_STATS_MAX 256
+
+/* the reply and compression buffers are kept between commands, unless they
+ * grew past this size for an unusually large message */
+#define MONGOC_CLUSTER_REPLY_BUFFER_MAX (1024 * 1024)
+
 /**
  * mongoc_op_msg_flags_t:
  * @MONGOC_MSG_CHECKSUM_PRESENT: The message ends with 4 bytes containing a
@@ -93,8 +105,13 @@ static bool
 mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
                           mongoc_cmd_t *cmd,
                           bson_t *reply,
+                          bool borrow,
                           bson_error_t *error);
 
+static void
+_mongoc_connection_pool_clear (mongoc_connection_pool_t *pool,
+                               uint32_t server_id);
+
 static void
 _bson_error_message_printf (bson_error_t *error, const char *format, ...)
    BSON_GNUC_PRINTF (2, 3);
@@ -169,6 +186,210 @@ _bson_error_message_printf (bson_error_t *error, const char *format, ...)
       RUN_CMD_ERR_DECORATE;                                \
    } while (0)
 
+static mongoc_cluster_compression_stats_t *
+_mongoc_cluster_compression_stats (mongoc_cluster_t *cluster,
+                                   uint32_t server_id,
+                                   const char *command_name)
+{
+   mongoc_cluster_compression_stats_t *stats;
+   size_t i;
+
+   for (i = 0; i < cluster->compression_stats.len; i++) {
+      stats = &_mongoc_array_index (
+         &cluster->compression_stats, mongoc_cluster_compression_stats_t, i);
+      if (stats->server_id == server_id &&
+          !strcmp (stats->command_name, command_name)) {
+         return stats;
+      }
+   }
+
+   return NULL;
+}
+
+
+static void
+_mongoc_cluster_compression_stats_clear (mongoc_cluster_t *cluster)
+{
+   mongoc_cluster_compression_stats_t *stats;
+   size_t i;
+
+   for (i = 0; i < cluster->compression_stats.len; i++) {
+      stats = &_mongoc_array_index (
+         &cluster->compression_stats, mongoc_cluster_compression_stats_t, i);
+      bson_free (stats->command_name);
+   }
+
+   _mongoc_array_clear (&cluster->compression_stats);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_should_compress --
+ *
+ *       Decide whether a message of @size bytes running @command_name on
+ *       server @server_id is worth compressing. Messages smaller than the
+ *       compressionthreshold URI option are not. With adaptivecompression,
+ *       neither are commands that have not compressed well on that server,
+ *       except for every MONGOC_CLUSTER_COMPRESSION_RESAMPLE'th message,
+ *       which is compressed to sample the ratio again.
+ *
+ *       @command_name may be NULL for legacy opcodes.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_cluster_should_compress (mongoc_cluster_t *cluster,
+                                 uint32_t server_id,
+                                 const char *command_name,
+                                 size_t size)
+{
+   mongoc_cluster_compression_stats_t *stats;
+
+   if (size < (size_t) cluster->compression_threshold) {
+      return false;
+   }
+
+   if (!cluster->adaptive_compression) {
+      return true;
+   }
+
+   stats = _mongoc_cluster_compression_stats (
+      cluster, server_id, command_name ? command_name : "");
+
+   if (!stats || stats->ratio <= MONGOC_CLUSTER_COMPRESSION_RATIO_MAX) {
+      return true;
+   }
+
+   /* the next sample resets the count */
+   return ++stats->skipped >= MONGOC_CLUSTER_COMPRESSION_RESAMPLE;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_sample_compression --
+ *
+ *       With adaptivecompression, record that a message of @size bytes
+ *       running @command_name on server @server_id was compressed to
+ *       @compressed_size bytes.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_cluster_sample_compression (mongoc_cluster_t *cluster,
+                                    uint32_t server_id,
+                                    const char *command_name,
+                                    size_t size,
+                                    size_t compressed_size)
+{
+   mongoc_cluster_compression_stats_t *stats;
+   mongoc_cluster_compression_stats_t new_stats;
+   int32_t ratio;
+
+   if (!cluster->adaptive_compression || !size) {
+      return;
+   }
+
+   if (!command_name) {
+      command_name = "";
+   }
+
+   ratio = (int32_t) ((uint64_t) compressed_size * 1000 / size);
+   stats = _mongoc_cluster_compression_stats (cluster, server_id, command_name);
+
+   if (stats) {
+      /* weigh the new sample as a quarter, so one odd message doesn't turn
+       * compression on or off */
+      stats->ratio = (stats->ratio * 3 + ratio) / 4;
+      stats->skipped = 0;
+      return;
+   }
+
+   if (cluster->compression_stats.len >= MONGOC_CLUSTER_COMPRESSION_STATS_MAX) {
+      _mongoc_cluster_compression_stats_clear (cluster);
+   }
+
+   new_stats.server_id = server_id;
+   new_stats.command_name = bson_strdup (command_name);
+   new_stats.ratio = ratio;
+   new_stats.skipped = 0;
+   _mongoc_array_append_val (&cluster->compression_stats, new_stats);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_compress --
+ *
+ *       Compress the (little endian) @rpc_le with @compressor_id, unless
+ *       the compressor is -1 or _mongoc_cluster_should_compress says it
+ *       doesn't pay off, in which case @rpc_le is left uncompressed.
+ *
+ * Returns:
+ *       false if compression failed and @error is set.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_cluster_compress (mongoc_cluster_t *cluster,
+                          int32_t compressor_id,
+                          uint32_t server_id,
+                          const char *command_name,
+                          mongoc_rpc_t *rpc_le,
+                          bson_error_t *error)
+{
+   size_t size;
+   size_t compressed_size;
+   int64_t started;
+
+   if (compressor_id == -1) {
+      return true;
+   }
+
+   size = BSON_UINT32_FROM_LE (rpc_le->header.msg_len);
+   if (!_mongoc_cluster_should_compress (
+          cluster, server_id, command_name, size)) {
+      mongoc_counter_compression_skipped_inc ();
+      return true;
+   }
+
+   started = bson_get_monotonic_time ();
+   if (!_mongoc_rpc_compress (cluster, compressor_id, rpc_le, error)) {
+      return false;
+   }
+
+   compressed_size = BSON_UINT32_FROM_LE (rpc_le->header.msg_len);
+   mongoc_counter_compression_usec_add (bson_get_monotonic_time () - started);
+   mongoc_counter_compression_bytes_in_add ((int64_t) size);
+   mongoc_counter_compression_bytes_out_add ((int64_t) compressed_size);
+
+   _mongoc_cluster_sample_compression (
+      cluster, server_id, command_name, size, compressed_size);
+
+   return true;
+}
+
+
+/* release the compress buffer once a compressed message has been sent, if it
+ * grew past MONGOC_CLUSTER_REPLY_BUFFER_MAX */
+static void
+_mongoc_cluster_release_compress_buffer (mongoc_cluster_t *cluster)
+{
+   mongoc_buffer_t *buffer = &cluster->compress_buffer;
+
+   if (buffer->datalen > MONGOC_CLUSTER_REPLY_BUFFER_MAX) {
+      _mongoc_buffer_destroy (buffer);
+      _mongoc_buffer_init (buffer, NULL, 0, NULL, NULL);
+   }
+}
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -207,7 +428,6 @@ mongoc_cluster_run_command_opquery (mongoc_cluster_t *cluster,
    int32_t msg_len;
    size_t doc_len;
    bool ret = false;
-   char *output = NULL;
    uint32_t server_id;
 
    ENTRY;
@@ -243,8 +463,12 @@ mongoc_cluster_run_command_opquery (mongoc_cluster_t *cluster,
        IS_NOT_COMMAND ("saslstart") && IS_NOT_COMMAND ("saslcontinue") &&
        IS_NOT_COMMAND ("getnonce") && IS_NOT_COMMAND ("authenticate") &&
        IS_NOT_COMMAND ("createuser") && IS_NOT_COMMAND ("updateuser")) {
-      output = _mongoc_rpc_compress (cluster, compressor_id, &rpc, error);
-      if (output == NULL) {
+      if (!_mongoc_cluster_compress (cluster,
+                                     compressor_id,
+                                     server_id,
+                                     cmd->command_name,
+                                     &rpc,
+                                     error)) {
          GOTO (done);
       }
    }
@@ -325,8 +549,8 @@ mongoc_cluster_run_command_opquery (mongoc_cluster_t *cluster,
          GOTO (done);
       }
 
-      buf = bson_malloc0 (len);
-      if (!_mongoc_rpc_decompress (&rpc, buf, len)) {
+      buf = bson_malloc (len);
+      if (!_mongoc_rpc_decompress (&rpc, buf, len, &cluster->compression)) {
          RUN_CMD_ERR (MONGOC_ERROR_PROTOCOL,
                       MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
                       "Could not decompress server reply");
@@ -378,6 +602,8 @@ mongoc_cluster_run_command_opquery (mongoc_cluster_t *cluster,
 
 done:
 
+   _mongoc_cluster_release_compress_buffer (cluster);
+
    if (!ret && error->code == 0) {
       /* generic error */
       RUN_CMD_ERR (MONGOC_ERROR_PROTOCOL,
@@ -388,7 +614,6 @@ done:
    if (reply_ptr == &reply_local) {
       bson_destroy (reply_ptr);
    }
-   bson_free (output);
    bson_free (cmd_ns);
 
    RETURN (ret);
@@ -518,6 +743,8 @@ _in_sharded_txn (const mongoc_client_session_t *session)
  * Side effects:
  *       If the client's APM callbacks are set, they are executed.
  *       @reply is set and should ALWAYS be released with bson_destroy().
+ *       If @cmd->borrow_reply is set, @reply may be a read-only view of
+ *       the cluster's receive buffer, valid until the next command.
  *
  *--------------------------------------------------------------------------
  */
@@ -544,6 +771,7 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
    bson_t encrypted = BSON_INITIALIZER;
    bson_t decrypted = BSON_INITIALIZER;
    mongoc_cmd_t encrypted_cmd;
+   bool borrow;
 
    server_stream = cmd->server_stream;
    server_id = server_stream->sd->id;
@@ -577,8 +805,13 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
       mongoc_apm_command_started_cleanup (&started_event);
    }
 
+   /* APM callbacks and auto decryption may run commands on the cluster
+    * while they read the reply, so it must be a copy for them */
+   borrow = cmd->borrow_reply && !callbacks->succeeded && !callbacks->failed &&
+            !_mongoc_cse_is_enabled (cluster->client);
+
    if (server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG) {
-      retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, error);
+      retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, borrow, error);
    } else {
       retval = mongoc_cluster_run_command_opquery (
          cluster, cmd, server_stream->stream, compressor_id, reply, error);
@@ -681,6 +914,8 @@ fail_no_events:
  *
  * Side effects:
  *       @reply is set and should ALWAYS be released with bson_destroy().
+ *       If @cmd->borrow_reply is set, @reply may be a read-only view of
+ *       the cluster's receive buffer, valid until the next command.
  *
  *--------------------------------------------------------------------------
  */
@@ -692,6 +927,7 @@ mongoc_cluster_run_command_private (mongoc_cluster_t *cluster,
                                     bson_error_t *error)
 {
    bool retval;
+   bool borrow = cmd->borrow_reply;
    const mongoc_server_stream_t *server_stream;
    bson_t reply_local;
    bson_error_t error_local;
@@ -701,11 +937,13 @@ mongoc_cluster_run_command_private (mongoc_cluster_t *cluster,
    }
 
    if (!reply) {
+      /* the reply is only inspected here, no need to copy it */
       reply = &reply_local;
+      borrow = true;
    }
    server_stream = cmd->server_stream;
    if (server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG) {
-      retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, error);
+      retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, borrow, error);
    } else {
       retval = mongoc_cluster_run_command_opquery (
          cluster, cmd, cmd->server_stream->stream, -1, reply, error);
@@ -721,6 +959,7 @@ mongoc_cluster_run_command_private (mongoc_cluster_t *cluster,
    return retval;
 }
 
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -1632,6 +1871,11 @@ mongoc_cluster_disconnect_node (mongoc_cluster_t *cluster,
       }
    } else {
       mongoc_set_rm (cluster->nodes, server_id);
+
+      /* other idle connections to the server are likely broken too */
+      if (invalidate) {
+         _mongoc_connection_pool_clear (topology->connection_pool, server_id);
+      }
    }
 
    if (invalidate) {
@@ -1685,6 +1929,268 @@ _mongoc_cluster_node_new (mongoc_stream_t *stream,
    return node;
 }
 
+static void
+_mongoc_connection_pool_server_dtor (void *data_, void *ctx_)
+{
+   mongoc_array_t *idle = (mongoc_array_t *) data_;
+   size_t i;
+
+   for (i = 0; i < idle->len; i++) {
+      _mongoc_cluster_node_destroy (
+         _mongoc_array_index (idle, mongoc_cluster_node_t *, i));
+   }
+
+   _mongoc_array_destroy (idle);
+   bson_free (idle);
+}
+
+mongoc_connection_pool_t *
+_mongoc_connection_pool_new (const mongoc_uri_t *uri)
+{
+   mongoc_connection_pool_t *pool;
+   int i;
+
+   pool = (mongoc_connection_pool_t *) bson_malloc0 (sizeof *pool);
+   for (i = 0; i < MONGOC_CONNECTION_POOL_SHARDS; i++) {
+      bson_mutex_init (&pool->shards[i].mutex);
+      pool->shards[i].servers =
+         mongoc_set_new (1, _mongoc_connection_pool_server_dtor, NULL);
+   }
+   pool->max_idle_time_msec =
+      mongoc_uri_get_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 0);
+
+   return pool;
+}
+
+void
+_mongoc_connection_pool_destroy (mongoc_connection_pool_t *pool)
+{
+   int i;
+
+   if (!pool) {
+      return;
+   }
+
+   for (i = 0; i < MONGOC_CONNECTION_POOL_SHARDS; i++) {
+      mongoc_set_destroy (pool->shards[i].servers);
+      bson_mutex_destroy (&pool->shards[i].mutex);
+   }
+
+   bson_free (pool);
+}
+
+static mongoc_connection_pool_shard_t *
+_mongoc_connection_pool_get_shard (mongoc_connection_pool_t *pool,
+                                   uint32_t server_id)
+{
+   return &pool->shards[server_id % MONGOC_CONNECTION_POOL_SHARDS];
+}
+
+/* close all idle connections to @server_id, e.g. after a network error */
+static void
+_mongoc_connection_pool_clear (mongoc_connection_pool_t *pool,
+                               uint32_t server_id)
+{
+   mongoc_connection_pool_shard_t *shard;
+   mongoc_array_t *idle;
+   mongoc_array_t *closing = NULL;
+
+   shard = _mongoc_connection_pool_get_shard (pool, server_id);
+
+   bson_mutex_lock (&shard->mutex);
+   idle = (mongoc_array_t *) mongoc_set_get (shard->servers, server_id);
+   if (idle && idle->len) {
+      /* close them outside the lock */
+      closing = (mongoc_array_t *) bson_malloc0 (sizeof *closing);
+      *closing = *idle;
+      _mongoc_array_init (idle, sizeof (mongoc_cluster_node_t *));
+   }
+   bson_mutex_unlock (&shard->mutex);
+
+   if (closing) {
+      _mongoc_connection_pool_server_dtor (closing, NULL);
+   }
+}
+
+/* take the most recently returned idle connection to @server_id, or NULL.
+ * closes those that have been idle longer than maxIdleTimeMS. */
+static mongoc_cluster_node_t *
+_mongoc_connection_pool_checkout (mongoc_connection_pool_t *pool,
+                                  uint32_t server_id)
+{
+   mongoc_connection_pool_shard_t *shard;
+   mongoc_array_t *idle;
+   mongoc_array_t expired;
+   mongoc_cluster_node_t *node = NULL;
+   int64_t oldest;
+   size_t n_expired = 0;
+   size_t i;
+
+   shard = _mongoc_connection_pool_get_shard (pool, server_id);
+   _mongoc_array_init (&expired, sizeof (mongoc_cluster_node_t *));
+   oldest = bson_get_monotonic_time () - pool->max_idle_time_msec * 1000;
+
+   bson_mutex_lock (&shard->mutex);
+
+   idle = (mongoc_array_t *) mongoc_set_get (shard->servers, server_id);
+   if (idle && pool->max_idle_time_msec) {
+      while (n_expired < idle->len &&
+             _mongoc_array_index (idle, mongoc_cluster_node_t *, n_expired)
+                   ->idle_since < oldest) {
+         n_expired++;
+      }
+
+      _mongoc_array_append_vals (&expired, idle->data, (uint32_t) n_expired);
+      idle->len -= n_expired;
+      memmove (idle->data,
+               (mongoc_cluster_node_t **) idle->data + n_expired,
+               idle->len * sizeof (mongoc_cluster_node_t *));
+   }
+
+   if (idle && idle->len) {
+      node = _mongoc_array_index (idle, mongoc_cluster_node_t *, --idle->len);
+   }
+
+   bson_mutex_unlock (&shard->mutex);
+
+   for (i = 0; i < expired.len; i++) {
+      _mongoc_cluster_node_destroy (
+         _mongoc_array_index (&expired, mongoc_cluster_node_t *, i));
+   }
+
+   _mongoc_array_destroy (&expired);
+
+   return node;
+}
+
+size_t
+_mongoc_connection_pool_n_idle (mongoc_connection_pool_t *pool,
+                                uint32_t server_id)
+{
+   mongoc_connection_pool_shard_t *shard;
+   mongoc_array_t *idle;
+   size_t n = 0;
+
+   shard = _mongoc_connection_pool_get_shard (pool, server_id);
+
+   bson_mutex_lock (&shard->mutex);
+   idle = (mongoc_array_t *) mongoc_set_get (shard->servers, server_id);
+   if (idle) {
+      n = idle->len;
+   }
+   bson_mutex_unlock (&shard->mutex);
+
+   return n;
+}
+
+static void
+_mongoc_connection_pool_checkin (mongoc_connection_pool_t *pool,
+                                 uint32_t server_id,
+                                 mongoc_cluster_node_t *node)
+{
+   mongoc_connection_pool_shard_t *shard;
+   mongoc_array_t *idle;
+
+   shard = _mongoc_connection_pool_get_shard (pool, server_id);
+   node->idle_since = bson_get_monotonic_time ();
+
+   bson_mutex_lock (&shard->mutex);
+
+   idle = (mongoc_array_t *) mongoc_set_get (shard->servers, server_id);
+   if (!idle) {
+      idle = (mongoc_array_t *) bson_malloc0 (sizeof *idle);
+      _mongoc_array_init (idle, sizeof (mongoc_cluster_node_t *));
+      mongoc_set_add (shard->servers, server_id, idle);
+   }
+
+   _mongoc_array_append_val (idle, node);
+
+   bson_mutex_unlock (&shard->mutex);
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_release_nodes --
+ *
+ *       Give all of a pooled client's connections back to the topology's
+ *       connection pool, for the pool's other clients to use. Called when
+ *       the client is pushed back to its pool.
+ *
+ *       Connections to servers no longer in the topology, and all of them
+ *       if the client is in the middle of an exhaust cursor, are closed
+ *       instead.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+_mongoc_cluster_release_nodes (mongoc_cluster_t *cluster)
+{
+   mongoc_topology_t *topology;
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_cluster_node_t *node;
+   uint32_t server_id;
+
+   topology = cluster->client->topology;
+   BSON_ASSERT (!topology->single_threaded);
+
+   snapshot = _mongoc_topology_snapshot_acquire (topology);
+
+   while (cluster->nodes->items_len) {
+      mongoc_set_get_item_and_id (
+         cluster->nodes, (int) cluster->nodes->items_len - 1, &server_id);
+
+      /* take the node out without the set's dtor closing it */
+      node = (mongoc_cluster_node_t *) mongoc_set_steal (cluster->nodes,
+                                                         server_id);
+
+      if (cluster->client->in_exhaust ||
+          !mongoc_topology_description_server_by_id (
+             &snapshot->description, server_id, NULL)) {
+         _mongoc_cluster_node_destroy (node);
+      } else {
+         _mongoc_connection_pool_checkin (
+            topology->connection_pool, server_id, node);
+      }
+   }
+
+   _mongoc_topology_snapshot_release (snapshot);
+}
+
+/* pooled mode: take a connection to @server_id from the topology's connection
+ * pool, skipping any from before the server was last reset */
+static mongoc_cluster_node_t *
+_mongoc_cluster_take_pooled_node (mongoc_cluster_t *cluster,
+                                  uint32_t server_id)
+{
+   mongoc_topology_t *topology;
+   mongoc_cluster_node_t *node;
+   int64_t timestamp;
+
+   topology = cluster->client->topology;
+
+   node = _mongoc_connection_pool_checkout (topology->connection_pool,
+                                            server_id);
+   if (!node) {
+      return NULL;
+   }
+
+   timestamp = mongoc_topology_server_timestamp (topology, server_id);
+
+   do {
+      if (timestamp != -1 && node->timestamp >= timestamp) {
+         mongoc_set_add (cluster->nodes, server_id, node);
+         return node;
+      }
+
+      _mongoc_cluster_node_destroy (node);
+   } while ((node = _mongoc_connection_pool_checkout (
+                topology->connection_pool, server_id)));
+
+   return NULL;
+}
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -1773,6 +2279,37 @@ error:
    RETURN (NULL);
 }
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_prewarm_node --
+ *
+ *       Connect to a server, handshake and authenticate, and give the new
+ *       connection to the topology's connection pool. @cluster must hold
+ *       no other connections.
+ *
+ * Returns:
+ *       true on success, false if the connection could not be established.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_cluster_prewarm_node (mongoc_cluster_t *cluster,
+                              uint32_t server_id,
+                              bson_error_t *error)
+{
+   BSON_ASSERT (!cluster->nodes->items_len);
+
+   if (!_mongoc_cluster_add_node (cluster, server_id, error)) {
+      return false;
+   }
+
+   _mongoc_cluster_release_nodes (cluster);
+
+   return true;
+}
+
 static void
 node_not_found (mongoc_topology_t *topology,
                 uint32_t server_id,
@@ -2052,9 +2589,28 @@ _mongoc_cluster_create_server_stream (mongoc_topology_t *topology,
                                       mongoc_stream_t *stream,
                                       bson_error_t *error /* OUT */)
 {
+   mongoc_topology_snapshot_t *snapshot;
    mongoc_server_description_t *sd;
    mongoc_server_stream_t *server_stream = NULL;
 
+   if (!topology->single_threaded) {
+      /* copy the server description and cluster time from one snapshot */
+      snapshot = _mongoc_topology_snapshot_acquire (topology);
+
+      sd = mongoc_server_description_new_copy (
+         mongoc_topology_description_server_by_id (
+            &snapshot->description, server_id, error));
+
+      if (sd) {
+         server_stream =
+            mongoc_server_stream_new (&snapshot->description, sd, stream);
+      }
+
+      _mongoc_topology_snapshot_release (snapshot);
+
+      return server_stream;
+   }
+
    /* can't just use mongoc_topology_server_by_id(), since we must hold the
     * lock while copying topology->description.logical_time below */
    bson_mutex_lock (&topology->mutex);
@@ -2090,6 +2646,10 @@ mongoc_cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
 
    topology = cluster->client->topology;
 
+   if (!cluster_node) {
+      cluster_node = _mongoc_cluster_take_pooled_node (cluster, server_id);
+   }
+
    if (cluster_node) {
       BSON_ASSERT (cluster_node->stream);
 
@@ -2168,6 +2728,16 @@ mongoc_cluster_init (mongoc_cluster_t *cluster,
    cluster->nodes = mongoc_set_new (8, _mongoc_cluster_node_dtor, NULL);
 
    _mongoc_array_init (&cluster->iov, sizeof (mongoc_iovec_t));
+   _mongoc_buffer_init (&cluster->reply_buffer, NULL, 0, NULL, NULL);
+   _mongoc_buffer_init (&cluster->compress_buffer, NULL, 0, NULL, NULL);
+   _mongoc_buffer_init (&cluster->decompress_buffer, NULL, 0, NULL, NULL);
+   mongoc_compression_ctx_init (&cluster->compression);
+   cluster->compression_threshold =
+      mongoc_uri_get_option_as_int32 (uri, MONGOC_URI_COMPRESSIONTHRESHOLD, 0);
+   cluster->adaptive_compression = mongoc_uri_get_option_as_bool (
+      uri, MONGOC_URI_ADAPTIVECOMPRESSION, false);
+   _mongoc_array_init (&cluster->compression_stats,
+                       sizeof (mongoc_cluster_compression_stats_t));
 
    cluster->operation_id = rand ();
 
@@ -2203,6 +2773,12 @@ mongoc_cluster_destroy (mongoc_cluster_t *cluster) /* INOUT */
    mongoc_set_destroy (cluster->nodes);
 
    _mongoc_array_destroy (&cluster->iov);
+   _mongoc_buffer_destroy (&cluster->reply_buffer);
+   _mongoc_buffer_destroy (&cluster->compress_buffer);
+   _mongoc_buffer_destroy (&cluster->decompress_buffer);
+   mongoc_compression_ctx_destroy (&cluster->compression);
+   _mongoc_cluster_compression_stats_clear (cluster);
+   _mongoc_array_destroy (&cluster->compression_stats);
 
 #ifdef MONGOC_ENABLE_CRYPTO
    if (cluster->scram_cache) {
@@ -2620,7 +3196,6 @@ mongoc_cluster_legacy_rpc_sendv_to_server (
    int32_t max_msg_size;
    bool ret = false;
    int32_t compressor_id = 0;
-   char *output = NULL;
 
    ENTRY;
 
@@ -2644,11 +3219,9 @@ mongoc_cluster_legacy_rpc_sendv_to_server (
    _mongoc_rpc_gather (rpc, &cluster->iov);
    _mongoc_rpc_swab_to_le (rpc);
 
-   if (compressor_id != -1) {
-      output = _mongoc_rpc_compress (cluster, compressor_id, rpc, error);
-      if (output == NULL) {
-         GOTO (done);
-      }
+   if (!_mongoc_cluster_compress (
+          cluster, compressor_id, server_id, NULL, rpc, error)) {
+      GOTO (done);
    }
 
    max_msg_size = mongoc_server_stream_max_msg_size (server_stream);
@@ -2678,9 +3251,7 @@ mongoc_cluster_legacy_rpc_sendv_to_server (
 
 done:
 
-   if (compressor_id) {
-      bson_free (output);
-   }
+   _mongoc_cluster_release_compress_buffer (cluster);
 
    RETURN (ret);
 }
@@ -2805,8 +3376,8 @@ mongoc_cluster_try_recv (mongoc_cluster_t *cluster,
       size_t len = BSON_UINT32_FROM_LE (rpc->compressed.uncompressed_size) +
                    sizeof (mongoc_rpc_header_t);
 
-      buf = bson_malloc0 (len);
-      if (!_mongoc_rpc_decompress (rpc, buf, len)) {
+      buf = bson_malloc (len);
+      if (!_mongoc_rpc_decompress (rpc, buf, len, &cluster->compression)) {
          bson_free (buf);
          bson_set_error (error,
                          MONGOC_ERROR_PROTOCOL,
@@ -2864,16 +3435,39 @@ network_error_reply (bson_t *reply, mongoc_cmd_t *cmd)
 }
 
 
+/* prepare the reply buffer for the next reply. it is kept between commands
+ * so small replies need no allocations, but a buffer grown past
+ * MONGOC_CLUSTER_REPLY_BUFFER_MAX for an unusually large reply is released. */
+
+static void
+_mongoc_cluster_reset_reply_buffer (mongoc_cluster_t *cluster)
+{
+   mongoc_buffer_t *buffer = &cluster->reply_buffer;
+
+   if (buffer->datalen > MONGOC_CLUSTER_REPLY_BUFFER_MAX) {
+      _mongoc_buffer_destroy (buffer);
+      _mongoc_buffer_init (buffer, NULL, 0, NULL, NULL);
+   } else {
+      _mongoc_buffer_clear (buffer, false);
+   }
+}
+
+
 static bool
 mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
                           mongoc_cmd_t *cmd,
                           bson_t *reply,
+                          bool borrow,
                           bson_error_t *error)
 {
    mongoc_rpc_section_t section[2];
-   mongoc_buffer_t buffer;
+   mongoc_buffer_t *buffer = &cluster->reply_buffer;
+   bool decompressed = false;
+   bool reused = false;
    bson_t reply_local; /* only statically initialized */
    char *output = NULL;
+   size_t output_len = 0;
+   size_t offset;
    mongoc_rpc_t rpc;
    int32_t msg_len;
    bool ok;
@@ -2898,7 +3492,7 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
    }
 
    _mongoc_array_clear (&cluster->iov);
-   _mongoc_buffer_init (&buffer, NULL, 0, NULL, NULL);
+   _mongoc_cluster_reset_reply_buffer (cluster);
 
    rpc.header.msg_len = 0;
    rpc.header.request_id = ++cluster->request_id;
@@ -2937,13 +3531,14 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
 
       TRACE (
          "Function '%s' is compressible: %d", cmd->command_name, compressor_id);
-      if (compressor_id != -1) {
-         output = _mongoc_rpc_compress (cluster, compressor_id, &rpc, error);
-         if (output == NULL) {
-            _mongoc_bson_init_if_set (reply);
-            _mongoc_buffer_destroy (&buffer);
-            return false;
-         }
+      if (!_mongoc_cluster_compress (cluster,
+                                     compressor_id,
+                                     server_stream->sd->id,
+                                     cmd->command_name,
+                                     &rpc,
+                                     error)) {
+         _mongoc_bson_init_if_set (reply);
+         return false;
       }
    }
    ok = _mongoc_stream_writev_full (server_stream->stream,
@@ -2951,117 +3546,141 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
                                     cluster->iov.len,
                                     cluster->sockettimeoutms,
                                     error);
+   _mongoc_cluster_release_compress_buffer (cluster);
    if (!ok) {
       /* add info about the command to writev_full's error message */
       RUN_CMD_ERR_DECORATE;
       mongoc_cluster_disconnect_node (
          cluster, server_stream->sd->id, true, error);
-      bson_free (output);
       network_error_reply (reply, cmd);
-      _mongoc_buffer_destroy (&buffer);
       return false;
    }
 
    /* If acknowledged, wait for a server response. Otherwise, exit early */
-   if (cmd->is_acknowledged) {
-      ok = _mongoc_buffer_append_from_stream (
-         &buffer, server_stream->stream, 4, cluster->sockettimeoutms, error);
-      if (!ok) {
-         RUN_CMD_ERR_DECORATE;
-         mongoc_cluster_disconnect_node (
-            cluster, server_stream->sd->id, true, error);
-         bson_free (output);
-         network_error_reply (reply, cmd);
-         _mongoc_buffer_destroy (&buffer);
-         return false;
-      }
+   if (!cmd->is_acknowledged) {
+      _mongoc_bson_init_if_set (reply);
+      return true;
+   }
 
-      BSON_ASSERT (buffer.len == 4);
-      memcpy (&msg_len, buffer.data, 4);
-      msg_len = BSON_UINT32_FROM_LE (msg_len);
-      if ((msg_len < 16) || (msg_len > server_stream->sd->max_msg_size)) {
-         RUN_CMD_ERR (
-            MONGOC_ERROR_PROTOCOL,
-            MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
-            "Message size %d is not within expected range 16-%d bytes",
-            msg_len,
-            server_stream->sd->max_msg_size);
-         mongoc_cluster_disconnect_node (
-            cluster, server_stream->sd->id, true, error);
-         bson_free (output);
-         network_error_reply (reply, cmd);
-         _mongoc_buffer_destroy (&buffer);
-         return false;
-      }
+   ok = _mongoc_buffer_append_from_stream (
+      buffer, server_stream->stream, 4, cluster->sockettimeoutms, error);
+   if (!ok) {
+      RUN_CMD_ERR_DECORATE;
+      mongoc_cluster_disconnect_node (
+         cluster, server_stream->sd->id, true, error);
+      network_error_reply (reply, cmd);
+      return false;
+   }
 
-      ok = _mongoc_buffer_append_from_stream (&buffer,
-                                              server_stream->stream,
-                                              (size_t) msg_len - 4,
-                                              cluster->sockettimeoutms,
-                                              error);
-      if (!ok) {
-         RUN_CMD_ERR_DECORATE;
-         mongoc_cluster_disconnect_node (
-            cluster, server_stream->sd->id, true, error);
-         bson_free (output);
-         network_error_reply (reply, cmd);
-         _mongoc_buffer_destroy (&buffer);
-         return false;
+   BSON_ASSERT (buffer->len == 4);
+   memcpy (&msg_len, buffer->data, 4);
+   msg_len = BSON_UINT32_FROM_LE (msg_len);
+   if ((msg_len < 16) || (msg_len > server_stream->sd->max_msg_size)) {
+      RUN_CMD_ERR (MONGOC_ERROR_PROTOCOL,
+                   MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                   "Message size %d is not within expected range 16-%d bytes",
+                   msg_len,
+                   server_stream->sd->max_msg_size);
+      mongoc_cluster_disconnect_node (
+         cluster, server_stream->sd->id, true, error);
+      network_error_reply (reply, cmd);
+      return false;
+   }
+
+   ok = _mongoc_buffer_append_from_stream (buffer,
+                                           server_stream->stream,
+                                           (size_t) msg_len - 4,
+                                           cluster->sockettimeoutms,
+                                           error);
+   if (!ok) {
+      RUN_CMD_ERR_DECORATE;
+      mongoc_cluster_disconnect_node (
+         cluster, server_stream->sd->id, true, error);
+      network_error_reply (reply, cmd);
+      return false;
+   }
+
+   ok = _mongoc_rpc_scatter (&rpc, buffer->data, buffer->len);
+   if (!ok) {
+      RUN_CMD_ERR (MONGOC_ERROR_PROTOCOL,
+                   MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                   "Malformed message from server");
+      network_error_reply (reply, cmd);
+      return false;
+   }
+   if (BSON_UINT32_FROM_LE (rpc.header.opcode) == MONGOC_OPCODE_COMPRESSED) {
+      output_len = BSON_UINT32_FROM_LE (rpc.compressed.uncompressed_size) +
+                   sizeof (mongoc_rpc_header_t);
+
+      if (reply && borrow && output_len <= MONGOC_CLUSTER_REPLY_BUFFER_MAX) {
+         /* a borrowed reply is decompressed into a buffer that is kept
+          * between commands, like the one it was read into */
+         _mongoc_buffer_clear (&cluster->decompress_buffer, false);
+         _mongoc_buffer_reserve (&cluster->decompress_buffer, output_len);
+         output = (char *) cluster->decompress_buffer.data;
+         reused = true;
+      } else {
+         output = bson_malloc (output_len);
       }
 
-      ok = _mongoc_rpc_scatter (&rpc, buffer.data, buffer.len);
-      if (!ok) {
+      decompressed = true;
+      if (!_mongoc_rpc_decompress (
+             &rpc, (uint8_t *) output, output_len, &cluster->compression)) {
          RUN_CMD_ERR (MONGOC_ERROR_PROTOCOL,
                       MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
-                      "Malformed message from server");
-         bson_free (output);
-         network_error_reply (reply, cmd);
-         _mongoc_buffer_destroy (&buffer);
-         return false;
-      }
-      if (BSON_UINT32_FROM_LE (rpc.header.opcode) == MONGOC_OPCODE_COMPRESSED) {
-         size_t len = BSON_UINT32_FROM_LE (rpc.compressed.uncompressed_size) +
-                      sizeof (mongoc_rpc_header_t);
-
-         output = bson_realloc (output, len);
-         if (!_mongoc_rpc_decompress (&rpc, (uint8_t *) output, len)) {
-            RUN_CMD_ERR (MONGOC_ERROR_PROTOCOL,
-                         MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
-                         "Could not decompress message from server");
-            mongoc_cluster_disconnect_node (
-               cluster, server_stream->sd->id, true, error);
+                      "Could not decompress message from server");
+         mongoc_cluster_disconnect_node (
+            cluster, server_stream->sd->id, true, error);
+         if (!reused) {
             bson_free (output);
-            network_error_reply (reply, cmd);
-            _mongoc_buffer_destroy (&buffer);
-            return false;
          }
+         network_error_reply (reply, cmd);
+         return false;
       }
-      _mongoc_rpc_swab_from_le (&rpc);
+   }
+   _mongoc_rpc_swab_from_le (&rpc);
 
-      memcpy (&msg_len, rpc.msg.sections[0].payload.bson_document, 4);
-      msg_len = BSON_UINT32_FROM_LE (msg_len);
-      bson_init_static (
-         &reply_local, rpc.msg.sections[0].payload.bson_document, msg_len);
+   memcpy (&msg_len, rpc.msg.sections[0].payload.bson_document, 4);
+   msg_len = BSON_UINT32_FROM_LE (msg_len);
+   bson_init_static (
+      &reply_local, rpc.msg.sections[0].payload.bson_document, msg_len);
 
-      _mongoc_topology_update_cluster_time (cluster->client->topology,
-                                            &reply_local);
-      ok = _mongoc_cmd_check_ok (
-         &reply_local, cluster->client->error_api_version, error);
+   _mongoc_topology_update_cluster_time (cluster->client->topology,
+                                         &reply_local);
+   ok = _mongoc_cmd_check_ok (
+      &reply_local, cluster->client->error_api_version, error);
 
-      if (cmd->session) {
-         _mongoc_client_session_handle_reply (
-            cmd->session, cmd->is_acknowledged, &reply_local);
-      }
-
-      if (reply) {
-         bson_copy_to (&reply_local, reply);
-      }
-   } else {
-      _mongoc_bson_init_if_set (reply);
+   if (cmd->session) {
+      _mongoc_client_session_handle_reply (
+         cmd->session, cmd->is_acknowledged, &reply_local);
+   }
+
+   if (reply && borrow && (!decompressed || reused)) {
+      /* a view of the reply or decompression buffer, valid until the next
+       * command */
+      BSON_ASSERT (bson_init_static (
+         reply, bson_get_data (&reply_local), reply_local.len));
+   } else if (reply && decompressed) {
+      /* the reply owns the decompression buffer */
+      offset = (size_t) (bson_get_data (&reply_local) - (uint8_t *) output);
+      BSON_ASSERT (
+         bson_init_adopt (reply, (uint8_t *) output, output_len, offset));
+      output = NULL;
+   } else if (reply && buffer->datalen > MONGOC_CLUSTER_REPLY_BUFFER_MAX) {
+      /* a large reply, such as a full getMore batch, owns the buffer it
+       * was read into rather than being copied out of it. the buffer
+       * would be released by the next command anyway. */
+      offset = (size_t) (bson_get_data (&reply_local) - buffer->data);
+      BSON_ASSERT (
+         bson_init_adopt (reply, buffer->data, buffer->datalen, offset));
+      _mongoc_buffer_init (buffer, NULL, 0, NULL, NULL);
+   } else if (reply) {
+      bson_copy_to (&reply_local, reply);
+   }
+
+   if (!reused) {
+      bson_free (output);
    }
 
-   _mongoc_buffer_destroy (&buffer);
-   bson_free (output);
-
    return ok;
 }
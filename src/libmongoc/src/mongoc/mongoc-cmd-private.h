@@ -63,6 +63,9 @@ typedef struct _mongoc_cmd_t {
    mongoc_client_session_t *session;
    bool is_acknowledged;
    bool is_txn_finish;
+   /* the caller is done with the reply before it runs another command on
+    * the cluster, so the reply may be a view of the receive buffer */
+   bool borrow_reply;
 } mongoc_cmd_t;
 
 
@@ -22,6 +22,9 @@
 
 #include "bson/bson.h"
 
+#include "mongoc-buffer-private.h"
+#include "mongoc-iovec.h"
+
 /* Compressor IDs */
 #define MONGOC_COMPRESSOR_NOOP_ID 0
 #define MONGOC_COMPRESSOR_NOOP_STR "noop"
@@ -35,10 +38,31 @@
 #define MONGOC_COMPRESSOR_ZSTD_ID 3
 #define MONGOC_COMPRESSOR_ZSTD_STR "zstd"
 
+/* ZSTD_minCLevel () as of zstd 1.4; zstd clamps levels past its limits */
+#define MONGOC_ZSTD_MIN_LEVEL (-131072)
+
 
 BSON_BEGIN_DECLS
 
 
+/* compressor state that is expensive to create, kept between messages and
+ * created as each compressor is first used. the pointers are z_stream,
+ * ZSTD_CCtx, and ZSTD_DCtx, so that zlib and zstd headers aren't needed
+ * here. */
+typedef struct _mongoc_compression_ctx_t {
+   void *zlib_deflate;
+   int32_t zlib_deflate_level;
+   void *zlib_inflate;
+   void *zstd_cctx;
+   void *zstd_dctx;
+} mongoc_compression_ctx_t;
+
+void
+mongoc_compression_ctx_init (mongoc_compression_ctx_t *ctx);
+
+void
+mongoc_compression_ctx_destroy (mongoc_compression_ctx_t *ctx);
+
 size_t
 mongoc_compressor_max_compressed_length (int32_t compressor_id, size_t size);
 
@@ -52,19 +76,21 @@ int
 mongoc_compressor_name_to_id (const char *compressor);
 
 bool
-mongoc_uncompress (int32_t compressor_id,
+mongoc_uncompress (mongoc_compression_ctx_t *ctx,
+                   int32_t compressor_id,
                    const uint8_t *compressed,
                    size_t compressed_len,
                    uint8_t *uncompressed,
                    size_t *uncompressed_size);
 
 bool
-mongoc_compress (int32_t compressor_id,
-                 int32_t compression_level,
-                 char *uncompressed,
-                 size_t uncompressed_len,
-                 char *compressed,
-                 size_t *compressed_len);
+mongoc_compress_iovec (mongoc_compression_ctx_t *ctx,
+                       int32_t compressor_id,
+                       int32_t compression_level,
+                       const mongoc_iovec_t *iov,
+                       size_t iovcnt,
+                       size_t skip,
+                       mongoc_buffer_t *compressed);
 
 BSON_END_DECLS
 
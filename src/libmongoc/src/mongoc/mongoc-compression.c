@@ -15,6 +15,8 @@
  */
 
 
+#include <limits.h>
+
 #include "mongoc-config.h"
 
 #include "mongoc-compression-private.h"
@@ -30,6 +32,10 @@
 #endif
 #ifdef MONGOC_ENABLE_COMPRESSION_ZSTD
 #include <zstd.h>
+/* ZSTD_compressStream2 is new in zstd 1.4.0 */
+#if ZSTD_VERSION_NUMBER >= 10400
+#define MONGOC_ZSTD_COMPRESS_STREAM2
+#endif
 #endif
 #endif
 
@@ -142,8 +148,146 @@ mongoc_compressor_name_to_id (const char *compressor)
    return -1;
 }
 
+void
+mongoc_compression_ctx_init (mongoc_compression_ctx_t *ctx)
+{
+   BSON_ASSERT (ctx);
+
+   memset (ctx, 0, sizeof *ctx);
+}
+
+
+void
+mongoc_compression_ctx_destroy (mongoc_compression_ctx_t *ctx)
+{
+   BSON_ASSERT (ctx);
+
+#ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
+   if (ctx->zlib_deflate) {
+      deflateEnd ((z_stream *) ctx->zlib_deflate);
+      bson_free (ctx->zlib_deflate);
+   }
+
+   if (ctx->zlib_inflate) {
+      inflateEnd ((z_stream *) ctx->zlib_inflate);
+      bson_free (ctx->zlib_inflate);
+   }
+#endif
+
+#ifdef MONGOC_ENABLE_COMPRESSION_ZSTD
+   ZSTD_freeCCtx ((ZSTD_CCtx *) ctx->zstd_cctx);
+   ZSTD_freeDCtx ((ZSTD_DCtx *) ctx->zstd_dctx);
+#endif
+
+   memset (ctx, 0, sizeof *ctx);
+}
+
+
+#ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
+/* returns a deflate stream for @level that is ready for a new message: the
+ * one kept in @ctx, reset, or else @local */
+static z_stream *
+_mongoc_zlib_deflate_begin (mongoc_compression_ctx_t *ctx,
+                            int32_t level,
+                            z_stream *local)
+{
+   z_stream *strm;
+
+   memset (local, 0, sizeof *local);
+
+   if (!ctx) {
+      return deflateInit (local, level) == Z_OK ? local : NULL;
+   }
+
+   strm = (z_stream *) ctx->zlib_deflate;
+   if (strm && ctx->zlib_deflate_level == level) {
+      return deflateReset (strm) == Z_OK ? strm : NULL;
+   }
+
+   if (strm) {
+      deflateEnd (strm);
+   } else {
+      strm = (z_stream *) bson_malloc (sizeof *strm);
+   }
+
+   memset (strm, 0, sizeof *strm);
+   if (deflateInit (strm, level) != Z_OK) {
+      bson_free (strm);
+      ctx->zlib_deflate = NULL;
+      return NULL;
+   }
+
+   ctx->zlib_deflate = strm;
+   ctx->zlib_deflate_level = level;
+
+   return strm;
+}
+
+
+static z_stream *
+_mongoc_zlib_inflate_begin (mongoc_compression_ctx_t *ctx, z_stream *local)
+{
+   z_stream *strm;
+
+   memset (local, 0, sizeof *local);
+
+   if (!ctx) {
+      return inflateInit (local) == Z_OK ? local : NULL;
+   }
+
+   strm = (z_stream *) ctx->zlib_inflate;
+   if (strm) {
+      return inflateReset (strm) == Z_OK ? strm : NULL;
+   }
+
+   strm = (z_stream *) bson_malloc0 (sizeof *strm);
+   if (inflateInit (strm) != Z_OK) {
+      bson_free (strm);
+      return NULL;
+   }
+
+   ctx->zlib_inflate = strm;
+
+   return strm;
+}
+#endif
+
+
+#ifdef MONGOC_ENABLE_COMPRESSION_ZSTD
+static ZSTD_CCtx *
+_mongoc_zstd_cctx (mongoc_compression_ctx_t *ctx)
+{
+   if (!ctx) {
+      return ZSTD_createCCtx ();
+   }
+
+   if (!ctx->zstd_cctx) {
+      ctx->zstd_cctx = ZSTD_createCCtx ();
+   }
+
+   return (ZSTD_CCtx *) ctx->zstd_cctx;
+}
+
+
+static ZSTD_DCtx *
+_mongoc_zstd_dctx (mongoc_compression_ctx_t *ctx)
+{
+   if (!ctx) {
+      return ZSTD_createDCtx ();
+   }
+
+   if (!ctx->zstd_dctx) {
+      ctx->zstd_dctx = ZSTD_createDCtx ();
+   }
+
+   return (ZSTD_DCtx *) ctx->zstd_dctx;
+}
+#endif
+
+
 bool
-mongoc_uncompress (int32_t compressor_id,
+mongoc_uncompress (mongoc_compression_ctx_t *ctx,
+                   int32_t compressor_id,
                    const uint8_t *compressed,
                    size_t compressed_len,
                    uint8_t *uncompressed,
@@ -173,14 +317,30 @@ mongoc_uncompress (int32_t compressor_id,
 
    case MONGOC_COMPRESSOR_ZLIB_ID: {
 #ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
-      int ok;
+      z_stream local;
+      z_stream *strm;
+      bool ok;
+
+      strm = _mongoc_zlib_inflate_begin (ctx, &local);
+      if (!strm) {
+         return false;
+      }
+
+      /* like uncompress (), in one call, but with kept state */
+      strm->next_in = (Bytef *) compressed;
+      strm->avail_in = (uInt) compressed_len;
+      strm->next_out = uncompressed;
+      strm->avail_out = (uInt) *uncompressed_len;
 
-      ok = uncompress (uncompressed,
-                       (unsigned long *) uncompressed_len,
-                       compressed,
-                       compressed_len);
+      ok = compressed_len <= UINT_MAX && *uncompressed_len <= UINT_MAX &&
+           inflate (strm, Z_FINISH) == Z_STREAM_END;
+      *uncompressed_len = strm->total_out;
 
-      return ok == Z_OK;
+      if (strm == &local) {
+         inflateEnd (&local);
+      }
+
+      return ok;
 #else
       MONGOC_WARNING ("Received zlib compressed opcode, but zlib "
                       "compression is not compiled in");
@@ -191,13 +351,23 @@ mongoc_uncompress (int32_t compressor_id,
 
    case MONGOC_COMPRESSOR_ZSTD_ID: {
 #ifdef MONGOC_ENABLE_COMPRESSION_ZSTD
-      int ok;
+      ZSTD_DCtx *dctx;
+      size_t ok;
 
-      ok =
-         ZSTD_decompress ((void *) uncompressed,
-                          *uncompressed_len,
-                          (const void *) compressed,
-                          compressed_len);
+      dctx = _mongoc_zstd_dctx (ctx);
+      if (!dctx) {
+         return false;
+      }
+
+      ok = ZSTD_decompressDCtx (dctx,
+                                (void *) uncompressed,
+                                *uncompressed_len,
+                                (const void *) compressed,
+                                compressed_len);
+
+      if (!ctx) {
+         ZSTD_freeDCtx (dctx);
+      }
 
       if (!ZSTD_isError (ok)) {
          *uncompressed_len = ok;
@@ -223,66 +393,353 @@ mongoc_uncompress (int32_t compressor_id,
    return false;
 }
 
+
+/* the least room to make in the output buffer before each step of a
+ * streaming compressor */
+#define MONGOC_COMPRESS_CHUNK_SIZE (16 * 1024)
+
+
+/* walks the byte ranges of an iovec array after its first @skip bytes */
+typedef struct {
+   const mongoc_iovec_t *iov;
+   size_t iovcnt;
+   size_t i;
+   size_t skip;
+} _mongoc_iovec_iter_t;
+
+
+static void
+_mongoc_iovec_iter_init (_mongoc_iovec_iter_t *iter,
+                         const mongoc_iovec_t *iov,
+                         size_t iovcnt,
+                         size_t skip)
+{
+   iter->iov = iov;
+   iter->iovcnt = iovcnt;
+   iter->i = 0;
+   iter->skip = skip;
+}
+
+
+static bool
+_mongoc_iovec_iter_next (_mongoc_iovec_iter_t *iter,
+                         const uint8_t **ptr,
+                         size_t *len)
+{
+   while (iter->i < iter->iovcnt) {
+      *ptr = (const uint8_t *) iter->iov[iter->i].iov_base;
+      *len = iter->iov[iter->i].iov_len;
+      iter->i++;
+
+      if (*len <= iter->skip) {
+         iter->skip -= *len;
+         continue;
+      }
+
+      *ptr += iter->skip;
+      *len -= iter->skip;
+      iter->skip = 0;
+
+      return true;
+   }
+
+   return false;
+}
+
+
+static size_t
+_mongoc_iovec_len_after (const mongoc_iovec_t *iov,
+                         size_t iovcnt,
+                         size_t skip)
+{
+   _mongoc_iovec_iter_t iter;
+   const uint8_t *ptr;
+   size_t len;
+   size_t total = 0;
+
+   _mongoc_iovec_iter_init (&iter, iov, iovcnt, skip);
+   while (_mongoc_iovec_iter_next (&iter, &ptr, &len)) {
+      total += len;
+   }
+
+   return total;
+}
+
+
+/* copies @iov after the first @skip bytes into @out, which has room */
+static void
+_mongoc_iovec_flatten (const mongoc_iovec_t *iov,
+                       size_t iovcnt,
+                       size_t skip,
+                       uint8_t *out)
+{
+   _mongoc_iovec_iter_t iter;
+   const uint8_t *ptr;
+   size_t len;
+
+   _mongoc_iovec_iter_init (&iter, iov, iovcnt, skip);
+   while (_mongoc_iovec_iter_next (&iter, &ptr, &len)) {
+      memcpy (out, ptr, len);
+      out += len;
+   }
+}
+
+
+#ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
+static bool
+_mongoc_deflate (z_stream *strm, mongoc_buffer_t *out, int flush)
+{
+   uInt avail;
+   int ret;
+
+   /* deflate until it consumes all of its input and, when finishing, until
+    * it ends the stream, growing the output as it fills */
+   do {
+      _mongoc_buffer_reserve (out, MONGOC_COMPRESS_CHUNK_SIZE);
+      avail = (uInt) BSON_MIN (out->datalen - out->len, UINT_MAX);
+      strm->next_out = out->data + out->len;
+      strm->avail_out = avail;
+
+      ret = deflate (strm, flush);
+      if (ret == Z_STREAM_ERROR) {
+         return false;
+      }
+
+      out->len += avail - strm->avail_out;
+   } while (strm->avail_out == 0 ||
+            (flush == Z_FINISH && ret != Z_STREAM_END));
+
+   return true;
+}
+#endif
+
+
+#ifdef MONGOC_ZSTD_COMPRESS_STREAM2
+static bool
+_mongoc_zstd_compress_stream (ZSTD_CCtx *cctx,
+                              ZSTD_inBuffer *in,
+                              mongoc_buffer_t *out,
+                              ZSTD_EndDirective end)
+{
+   ZSTD_outBuffer zout;
+   size_t remaining;
+
+   do {
+      _mongoc_buffer_reserve (out, MONGOC_COMPRESS_CHUNK_SIZE);
+      zout.dst = out->data + out->len;
+      zout.size = out->datalen - out->len;
+      zout.pos = 0;
+
+      remaining = ZSTD_compressStream2 (cctx, &zout, in, end);
+      if (ZSTD_isError (remaining)) {
+         return false;
+      }
+
+      out->len += zout.pos;
+   } while (in->pos < in->size || (end == ZSTD_e_end && remaining != 0));
+
+   return true;
+}
+#endif
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_compress_iovec --
+ *
+ *       Compresses the bytes of @iov after the first @skip, such as the
+ *       16-byte message header, and appends them to @compressed.
+ *
+ *       zlib and zstd compress the iovecs as a stream, so the message
+ *       is never gathered into one contiguous buffer, and @compressed
+ *       only grows as large as the compressed data. snappy, and zstd
+ *       before 1.4.0, have no streaming API, so the message is gathered
+ *       into @compressed after the space reserved for the output.
+ *
+ *       @compressed is meant to be reused for many messages, and so is
+ *       @ctx, which keeps the zlib and zstd compressor state between
+ *       them. @ctx may be NULL to use temporary state.
+ *
+ *--------------------------------------------------------------------------
+ */
+
 bool
-mongoc_compress (int32_t compressor_id,
-                 int32_t compression_level,
-                 char *uncompressed,
-                 size_t uncompressed_len,
-                 char *compressed,
-                 size_t *compressed_len)
+mongoc_compress_iovec (mongoc_compression_ctx_t *ctx,
+                       int32_t compressor_id,
+                       int32_t compression_level,
+                       const mongoc_iovec_t *iov,
+                       size_t iovcnt,
+                       size_t skip,
+                       mongoc_buffer_t *compressed)
 {
-   TRACE ("Compressing with '%s' (%d)",
+   size_t uncompressed_len;
+
+   BSON_ASSERT (iov || !iovcnt);
+   BSON_ASSERT (compressed);
+
+   TRACE ("Compressing iovec with '%s' (%d)",
           mongoc_compressor_id_to_name (compressor_id),
           compressor_id);
+
+   uncompressed_len = _mongoc_iovec_len_after (iov, iovcnt, skip);
+
    switch (compressor_id) {
-   case MONGOC_COMPRESSOR_SNAPPY_ID:
+   case MONGOC_COMPRESSOR_SNAPPY_ID: {
 #ifdef MONGOC_ENABLE_COMPRESSION_SNAPPY
-      /* No compression_level option for snappy */
-      return snappy_compress (
-                uncompressed, uncompressed_len, compressed, compressed_len) ==
-             SNAPPY_OK;
+      size_t max_len = snappy_max_compressed_length (uncompressed_len);
+      size_t len = max_len;
+      uint8_t *input;
+
+      _mongoc_buffer_reserve (compressed, max_len + uncompressed_len);
+      input = compressed->data + compressed->len + max_len;
+      _mongoc_iovec_flatten (iov, iovcnt, skip, input);
+
+      if (snappy_compress ((const char *) input,
+                           uncompressed_len,
+                           (char *) compressed->data + compressed->len,
+                           &len) != SNAPPY_OK) {
+         return false;
+      }
+
+      compressed->len += len;
+      return true;
 #else
       MONGOC_ERROR ("Client attempting to use compress with snappy, but snappy "
                     "compression is not compiled in");
       return false;
 #endif
+   }
 
-   case MONGOC_COMPRESSOR_ZLIB_ID:
+   case MONGOC_COMPRESSOR_ZLIB_ID: {
 #ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
-      return compress2 ((unsigned char *) compressed,
-                        (unsigned long *) compressed_len,
-                        (unsigned char *) uncompressed,
-                        uncompressed_len,
-                        compression_level) == Z_OK;
+      z_stream local;
+      z_stream *strm;
+      _mongoc_iovec_iter_t iter;
+      const uint8_t *ptr;
+      size_t len;
+      uInt n;
+      bool ok = true;
+
+      strm = _mongoc_zlib_deflate_begin (ctx, compression_level, &local);
+      if (!strm) {
+         return false;
+      }
+
+      _mongoc_iovec_iter_init (&iter, iov, iovcnt, skip);
+      while (ok && _mongoc_iovec_iter_next (&iter, &ptr, &len)) {
+         while (ok && len > 0) {
+            /* avail_in is 32 bits */
+            n = (uInt) BSON_MIN (len, UINT_MAX);
+            strm->next_in = (Bytef *) ptr;
+            strm->avail_in = n;
+            ok = _mongoc_deflate (strm, compressed, Z_NO_FLUSH);
+            ptr += n;
+            len -= n;
+         }
+      }
+
+      ok = ok && _mongoc_deflate (strm, compressed, Z_FINISH);
+
+      if (strm == &local) {
+         deflateEnd (&local);
+      }
+
+      return ok;
 #else
       MONGOC_ERROR ("Client attempting to use compress with zlib, but zlib "
                     "compression is not compiled in");
       return false;
 #endif
+   }
 
    case MONGOC_COMPRESSOR_ZSTD_ID: {
-#ifdef MONGOC_ENABLE_COMPRESSION_ZSTD
-      int ok;
+#if defined(MONGOC_ZSTD_COMPRESS_STREAM2)
+      ZSTD_CCtx *cctx;
+      ZSTD_inBuffer in;
+      _mongoc_iovec_iter_t iter;
+      const uint8_t *ptr;
+      size_t len;
+      bool ok;
+
+      cctx = _mongoc_zstd_cctx (ctx);
+      if (!cctx) {
+         return false;
+      }
 
-      ok = ZSTD_compress ((void *) compressed,
-                          *compressed_len,
-                          (const void *) uncompressed,
-                          uncompressed_len,
-                          0);
+      /* record the size in the frame header, like ZSTD_compress */
+      ok = !ZSTD_isError (
+              ZSTD_CCtx_reset (cctx, ZSTD_reset_session_and_parameters)) &&
+           !ZSTD_isError (ZSTD_CCtx_setParameter (
+              cctx, ZSTD_c_compressionLevel, compression_level)) &&
+           !ZSTD_isError (
+              ZSTD_CCtx_setPledgedSrcSize (cctx, uncompressed_len));
+
+      _mongoc_iovec_iter_init (&iter, iov, iovcnt, skip);
+      while (ok && _mongoc_iovec_iter_next (&iter, &ptr, &len)) {
+         in.src = ptr;
+         in.size = len;
+         in.pos = 0;
+         ok = _mongoc_zstd_compress_stream (
+            cctx, &in, compressed, ZSTD_e_continue);
+      }
 
-      if (!ZSTD_isError (ok)) {
-         *compressed_len = ok;
+      if (ok) {
+         in.src = NULL;
+         in.size = 0;
+         in.pos = 0;
+         ok = _mongoc_zstd_compress_stream (cctx, &in, compressed, ZSTD_e_end);
       }
-      return !ZSTD_isError (ok);
+
+      if (!ctx) {
+         ZSTD_freeCCtx (cctx);
+      }
+
+      return ok;
+#elif defined(MONGOC_ENABLE_COMPRESSION_ZSTD)
+      size_t max_len = ZSTD_compressBound (uncompressed_len);
+      ZSTD_CCtx *cctx;
+      size_t len;
+      uint8_t *input;
+
+      cctx = _mongoc_zstd_cctx (ctx);
+      if (!cctx) {
+         return false;
+      }
+
+      _mongoc_buffer_reserve (compressed, max_len + uncompressed_len);
+      input = compressed->data + compressed->len + max_len;
+      _mongoc_iovec_flatten (iov, iovcnt, skip, input);
+
+      len = ZSTD_compressCCtx (cctx,
+                               compressed->data + compressed->len,
+                               max_len,
+                               input,
+                               uncompressed_len,
+                               compression_level);
+
+      if (!ctx) {
+         ZSTD_freeCCtx (cctx);
+      }
+
+      if (ZSTD_isError (len)) {
+         return false;
+      }
+
+      compressed->len += len;
+      return true;
 #else
       MONGOC_ERROR ("Client attempting to use compress with zstd, but zstd "
                     "compression is not compiled in");
       return false;
 #endif
    }
+
    case MONGOC_COMPRESSOR_NOOP_ID:
-      memcpy (compressed, uncompressed, uncompressed_len);
-      *compressed_len = uncompressed_len;
+      _mongoc_buffer_reserve (compressed, uncompressed_len);
+      _mongoc_iovec_flatten (
+         iov, iovcnt, skip, compressed->data + compressed->len);
+      compressed->len += uncompressed_len;
       return true;
 
    default:
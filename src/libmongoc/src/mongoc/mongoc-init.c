@@ -22,6 +22,7 @@
 #include "mongoc-init.h"
 
 #include "mongoc-handshake-private.h"
+#include "mongoc-write-command-private.h"
 
 #ifdef MONGOC_ENABLE_SSL_OPENSSL
 #include "mongoc-openssl-private.h"
@@ -136,6 +137,8 @@ static BSON_ONCE_FUN (_mongoc_do_init)
 
    _mongoc_handshake_init ();
 
+   _mongoc_write_command_id_context_init ();
+
    BSON_ONCE_RETURN;
 }
 
@@ -177,6 +180,8 @@ static BSON_ONCE_FUN (_mongoc_do_cleanup)
 
    _mongoc_handshake_cleanup ();
 
+   _mongoc_write_command_id_context_cleanup ();
+
    BSON_ONCE_RETURN;
 }
 
@@ -24,6 +24,7 @@
 
 #include "mongoc-array-private.h"
 #include "mongoc-cmd-private.h"
+#include "mongoc-compression-private.h"
 #include "mongoc-iovec.h"
 #include "mongoc-write-concern.h"
 #include "mongoc-flags.h"
@@ -168,9 +169,12 @@ _mongoc_cmd_check_ok_no_wce (const bson_t *doc,
                              bson_error_t *error);
 
 bool
-_mongoc_rpc_decompress (mongoc_rpc_t *rpc_le, uint8_t *buf, size_t buflen);
+_mongoc_rpc_decompress (mongoc_rpc_t *rpc_le,
+                        uint8_t *buf,
+                        size_t buflen,
+                        mongoc_compression_ctx_t *ctx);
 
-char *
+bool
 _mongoc_rpc_compress (struct _mongoc_cluster_t *cluster,
                       int32_t compressor_id,
                       mongoc_rpc_t *rpc_le,
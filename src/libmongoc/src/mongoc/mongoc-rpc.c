@@ -772,6 +772,7 @@ _mongoc_rpc_printf (mongoc_rpc_t *rpc)
  *       Takes a (little endian) rpc struct assumed to be OP_COMPRESSED
  *       and decompresses the opcode into its original opcode.
  *       The in-place updated rpc struct remains little endian.
+ *       @ctx, if not NULL, keeps decompressor state between calls.
  *
  * Side effects:
  *       Overwrites the RPC, along with the provided buf with the
@@ -781,7 +782,10 @@ _mongoc_rpc_printf (mongoc_rpc_t *rpc)
  */
 
 bool
-_mongoc_rpc_decompress (mongoc_rpc_t *rpc_le, uint8_t *buf, size_t buflen)
+_mongoc_rpc_decompress (mongoc_rpc_t *rpc_le,
+                        uint8_t *buf,
+                        size_t buflen,
+                        mongoc_compression_ctx_t *ctx)
 {
    size_t uncompressed_size =
       BSON_UINT32_FROM_LE (rpc_le->compressed.uncompressed_size);
@@ -795,7 +799,8 @@ _mongoc_rpc_decompress (mongoc_rpc_t *rpc_le, uint8_t *buf, size_t buflen)
    memcpy (buf + 8, (void *) (&rpc_le->header.response_to), 4);
    memcpy (buf + 12, (void *) (&rpc_le->compressed.original_opcode), 4);
 
-   ok = mongoc_uncompress (rpc_le->compressed.compressor_id,
+   ok = mongoc_uncompress (ctx,
+                           rpc_le->compressed.compressor_id,
                            rpc_le->compressed.compressed_message,
                            rpc_le->compressed.compressed_message_len,
                            buf + 16,
@@ -819,84 +824,84 @@ _mongoc_rpc_decompress (mongoc_rpc_t *rpc_le, uint8_t *buf, size_t buflen)
  *       compressed opcode based on the provided compressor_id.
  *       The in-place updated rpc struct remains little endian.
  *
+ *       The message is compressed straight from the cluster's iovecs
+ *       into the cluster's compression buffer, which the compressed
+ *       message refers to until the next message is compressed, with
+ *       the cluster's compressor state.
+ *
  * Side effects:
- *       Overwrites the RPC, and clears and overwrites the cluster buffer
- *       with the compressed results.
+ *       Overwrites the RPC, and clears and overwrites the cluster iovecs
+ *       and compression buffer with the compressed results.
  *
  *--------------------------------------------------------------------------
  */
 
-char *
+bool
 _mongoc_rpc_compress (struct _mongoc_cluster_t *cluster,
                       int32_t compressor_id,
                       mongoc_rpc_t *rpc_le,
                       bson_error_t *error)
 {
-   char *output;
-   size_t output_length = 0;
-   size_t allocate = BSON_UINT32_FROM_LE (rpc_le->header.msg_len) - 16;
-   char *data;
-   int size;
+   mongoc_buffer_t *output = &cluster->compress_buffer;
+   size_t size = BSON_UINT32_FROM_LE (rpc_le->header.msg_len) - 16;
    int32_t compression_level = -1;
 
    if (compressor_id == MONGOC_COMPRESSOR_ZLIB_ID) {
       compression_level = mongoc_uri_get_option_as_int32 (
          cluster->uri, MONGOC_URI_ZLIBCOMPRESSIONLEVEL, -1);
+   } else if (compressor_id == MONGOC_COMPRESSOR_ZSTD_ID) {
+      /* 0 is zstd's default level */
+      compression_level = mongoc_uri_get_option_as_int32 (
+         cluster->uri, MONGOC_URI_ZSTDCOMPRESSIONLEVEL, 0);
    }
 
-   BSON_ASSERT (allocate > 0);
-   data = bson_malloc0 (allocate);
-   size = _mongoc_cluster_buffer_iovec (
-      cluster->iov.data, cluster->iov.len, 16, data);
-   BSON_ASSERT (size);
+   BSON_ASSERT (size > 0);
 
-   output_length =
-      mongoc_compressor_max_compressed_length (compressor_id, size);
-   if (!output_length) {
+   if (!mongoc_compressor_max_compressed_length (compressor_id, size)) {
       bson_set_error (error,
                       MONGOC_ERROR_COMMAND,
                       MONGOC_ERROR_COMMAND_INVALID_ARG,
                       "Could not determine compression bounds for %s",
                       mongoc_compressor_id_to_name (compressor_id));
-      bson_free (data);
-      return NULL;
+      return false;
    }
 
-   output = (char *) bson_malloc0 (output_length);
-   if (mongoc_compress (compressor_id,
-                        compression_level,
-                        data,
-                        size,
-                        output,
-                        &output_length)) {
-      rpc_le->header.msg_len = 0;
-      rpc_le->compressed.original_opcode =
-         BSON_UINT32_FROM_LE (rpc_le->header.opcode);
-      rpc_le->header.opcode = MONGOC_OPCODE_COMPRESSED;
-      rpc_le->header.request_id =
-         BSON_UINT32_FROM_LE (rpc_le->header.request_id);
-      rpc_le->header.response_to =
-         BSON_UINT32_FROM_LE (rpc_le->header.response_to);
-
-      rpc_le->compressed.uncompressed_size = size;
-      rpc_le->compressed.compressor_id = compressor_id;
-      rpc_le->compressed.compressed_message = (const uint8_t *) output;
-      rpc_le->compressed.compressed_message_len = output_length;
-      bson_free (data);
-
-
-      _mongoc_array_destroy (&cluster->iov);
-      _mongoc_array_init (&cluster->iov, sizeof (mongoc_iovec_t));
-      _mongoc_rpc_gather (rpc_le, &cluster->iov);
-      _mongoc_rpc_swab_to_le (rpc_le);
-      return output;
-   } else {
+   _mongoc_buffer_clear (output, false);
+   if (!mongoc_compress_iovec (&cluster->compression,
+                               compressor_id,
+                               compression_level,
+                               (mongoc_iovec_t *) cluster->iov.data,
+                               cluster->iov.len,
+                               16,
+                               output)) {
       MONGOC_WARNING ("Could not compress data with %s",
                       mongoc_compressor_id_to_name (compressor_id));
+      bson_set_error (error,
+                      MONGOC_ERROR_COMMAND,
+                      MONGOC_ERROR_COMMAND_INVALID_ARG,
+                      "Could not compress data with %s",
+                      mongoc_compressor_id_to_name (compressor_id));
+      return false;
    }
-   bson_free (data);
-   bson_free (output);
-   return NULL;
+
+   rpc_le->header.msg_len = 0;
+   rpc_le->compressed.original_opcode =
+      BSON_UINT32_FROM_LE (rpc_le->header.opcode);
+   rpc_le->header.opcode = MONGOC_OPCODE_COMPRESSED;
+   rpc_le->header.request_id = BSON_UINT32_FROM_LE (rpc_le->header.request_id);
+   rpc_le->header.response_to =
+      BSON_UINT32_FROM_LE (rpc_le->header.response_to);
+
+   rpc_le->compressed.uncompressed_size = (int32_t) size;
+   rpc_le->compressed.compressor_id = compressor_id;
+   rpc_le->compressed.compressed_message = output->data;
+   rpc_le->compressed.compressed_message_len = (int32_t) output->len;
+
+   _mongoc_array_clear (&cluster->iov);
+   _mongoc_rpc_gather (rpc_le, &cluster->iov);
+   _mongoc_rpc_swab_to_le (rpc_le);
+
+   return true;
 }
 
 /*
@@ -53,6 +53,10 @@ mongoc_set_add (mongoc_set_t *set, uint32_t id, void *item);
 void
 mongoc_set_rm (mongoc_set_t *set, uint32_t id);
 
+/* remove the item with @id without calling the dtor, and return it */
+void *
+mongoc_set_steal (mongoc_set_t *set, uint32_t id);
+
 void *
 mongoc_set_get (mongoc_set_t *set, uint32_t id);
 
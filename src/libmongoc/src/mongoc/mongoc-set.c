@@ -71,12 +71,25 @@ mongoc_set_add (mongoc_set_t *set, uint32_t id, void *item)
    }
 }
 
+static void
+_mongoc_set_remove (mongoc_set_t *set, mongoc_set_item_t *ptr)
+{
+   int i = ptr - set->items;
+
+   if (i != set->items_len - 1) {
+      memmove (set->items + i,
+               set->items + i + 1,
+               (set->items_len - (i + 1)) * sizeof (*ptr));
+   }
+
+   set->items_len--;
+}
+
 void
 mongoc_set_rm (mongoc_set_t *set, uint32_t id)
 {
    mongoc_set_item_t *ptr;
    mongoc_set_item_t key;
-   int i;
 
    key.id = id;
 
@@ -88,16 +101,30 @@ mongoc_set_rm (mongoc_set_t *set, uint32_t id)
          set->dtor (ptr->item, set->dtor_ctx);
       }
 
-      i = ptr - set->items;
+      _mongoc_set_remove (set, ptr);
+   }
+}
 
-      if (i != set->items_len - 1) {
-         memmove (set->items + i,
-                  set->items + i + 1,
-                  (set->items_len - (i + 1)) * sizeof (key));
-      }
+void *
+mongoc_set_steal (mongoc_set_t *set, uint32_t id)
+{
+   mongoc_set_item_t *ptr;
+   mongoc_set_item_t key;
+   void *item;
+
+   key.id = id;
 
-      set->items_len--;
+   ptr = (mongoc_set_item_t *) bsearch (
+      &key, set->items, set->items_len, sizeof (key), mongoc_set_id_cmp);
+
+   if (!ptr) {
+      return NULL;
    }
+
+   item = ptr->item;
+   _mongoc_set_remove (set, ptr);
+
+   return item;
 }
 
 void *
@@ -32,8 +32,40 @@ struct _mongoc_socket_t {
    int errno_;
    int domain;
    int pid;
+#ifdef MONGOC_ENABLE_EPOLL
+   /* registration with the mongoc_socket_poller_t that last polled us */
+   const void *poller;
+   uint32_t poller_gen;
+   size_t poller_index;
+   int poller_events;
+   bool poller_ready;
+#endif
 };
 
+/*
+ * mongoc_socket_poller_t:
+ *
+ * A multi-socket poller for callers that poll mostly the same sockets over
+ * and over, like the topology scanner. With epoll, sockets stay registered
+ * between calls and only new sockets, sockets whose events changed, and
+ * sockets reported ready by the previous call are (re)armed, so a call
+ * costs time in proportion to the sockets that changed or are ready rather
+ * than to all the sockets polled. Without epoll, it is mongoc_socket_poll.
+ */
+typedef struct _mongoc_socket_poller_t mongoc_socket_poller_t;
+
+mongoc_socket_poller_t *
+_mongoc_socket_poller_new (void);
+
+void
+_mongoc_socket_poller_destroy (mongoc_socket_poller_t *poller);
+
+ssize_t
+_mongoc_socket_poller_poll (mongoc_socket_poller_t *poller,
+                            mongoc_socket_poll_t *sds,
+                            size_t nsds,
+                            int32_t timeout);
+
 mongoc_socket_t *
 mongoc_socket_accept_ex (mongoc_socket_t *sock,
                          int64_t expire_at,
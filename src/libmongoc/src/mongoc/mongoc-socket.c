@@ -16,6 +16,7 @@
 
 
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 
 #include "mongoc-counters-private.h"
@@ -28,6 +29,9 @@
 #include <Mstcpip.h>
 #include <process.h>
 #endif
+#ifdef MONGOC_ENABLE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "socket"
@@ -357,6 +361,285 @@ mongoc_socket_poll (mongoc_socket_poll_t *sds, /* IN */
 }
 
 
+struct _mongoc_socket_poller_t {
+#ifdef MONGOC_ENABLE_EPOLL
+   int epfd;
+   /* the process that created epfd. a forked child must not use the epoll
+    * instance it shares with its parent */
+   int pid;
+   /* incremented by each call, to tell which sockets the last call polled */
+   uint32_t gen;
+   struct epoll_event *events;
+   size_t events_len;
+   /* the fds registered by the last call, and the last call that polled
+    * each fd, indexed by fd */
+   int *fds;
+   size_t n_fds;
+   size_t fds_len;
+   uint32_t *fd_gen;
+   size_t fd_gen_len;
+#else
+   int unused;
+#endif
+};
+
+
+mongoc_socket_poller_t *
+_mongoc_socket_poller_new (void)
+{
+   mongoc_socket_poller_t *poller;
+
+   poller = (mongoc_socket_poller_t *) bson_malloc0 (sizeof *poller);
+#ifdef MONGOC_ENABLE_EPOLL
+   /* if this fails, fall back to mongoc_socket_poll */
+   poller->epfd = epoll_create1 (EPOLL_CLOEXEC);
+   poller->pid = (int) getpid ();
+#endif
+
+   return poller;
+}
+
+
+void
+_mongoc_socket_poller_destroy (mongoc_socket_poller_t *poller)
+{
+   if (!poller) {
+      return;
+   }
+
+#ifdef MONGOC_ENABLE_EPOLL
+   if (poller->epfd >= 0) {
+      close (poller->epfd);
+   }
+
+   bson_free (poller->events);
+   bson_free (poller->fds);
+   bson_free (poller->fd_gen);
+#endif
+   bson_free (poller);
+}
+
+
+#ifdef MONGOC_ENABLE_EPOLL
+/* in a forked child, replace the epoll instance inherited from the parent.
+ * changing its interest set would change the parent's too, and the parent
+ * would be handed pointers to the child's sockets. */
+static void
+_mongoc_socket_poller_check_pid (mongoc_socket_poller_t *poller)
+{
+   int pid = (int) getpid ();
+
+   if (poller->pid == pid) {
+      return;
+   }
+
+   if (poller->epfd >= 0) {
+      close (poller->epfd);
+   }
+
+   poller->epfd = epoll_create1 (EPOLL_CLOEXEC);
+   poller->pid = pid;
+
+   /* nothing is registered with the new instance. skip a generation so no
+    * socket looks like it was polled by the last call. */
+   poller->n_fds = 0;
+   if (++poller->gen == 0) {
+      poller->gen = 1;
+   }
+}
+
+
+static bool
+_mongoc_socket_poller_register (mongoc_socket_poller_t *poller,
+                                mongoc_socket_t *sock,
+                                int events)
+{
+   struct epoll_event ev = {0};
+   bool registered;
+   int op;
+
+   /* a socket the last call polled is still registered, any other was
+    * never registered or was removed when it went unpolled */
+   registered = sock->poller == poller && sock->poller_gen == poller->gen - 1;
+
+   if (registered && sock->poller_events == events && !sock->poller_ready) {
+      return true;
+   }
+
+   /* edge-triggered, so a socket is only reported when it becomes ready.
+    * callers may not drain a socket they were told is ready, so one that
+    * was reported is re-armed with EPOLL_CTL_MOD, which reports it again if
+    * it is still ready. */
+   ev.events = EPOLLET;
+   if (events & POLLIN) {
+      ev.events |= EPOLLIN;
+   }
+   if (events & POLLOUT) {
+      ev.events |= EPOLLOUT;
+   }
+   ev.data.ptr = sock;
+
+   op = registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+   if (epoll_ctl (poller->epfd, op, sock->sd, &ev) != 0) {
+      if (errno == EEXIST) {
+         op = EPOLL_CTL_MOD;
+      } else if (errno == ENOENT) {
+         op = EPOLL_CTL_ADD;
+      } else {
+         return false;
+      }
+
+      if (epoll_ctl (poller->epfd, op, sock->sd, &ev) != 0) {
+         return false;
+      }
+   }
+
+   sock->poller = poller;
+   sock->poller_events = events;
+
+   return true;
+}
+
+
+static bool
+_mongoc_socket_poller_track (mongoc_socket_poller_t *poller, int fd)
+{
+   size_t len;
+
+   if (fd < 0) {
+      errno = EBADF;
+      return false;
+   }
+
+   if ((size_t) fd >= poller->fd_gen_len) {
+      len = BSON_MAX (poller->fd_gen_len * 2, (size_t) fd + 1);
+      poller->fd_gen = (uint32_t *) bson_realloc (poller->fd_gen,
+                                                  len * sizeof (uint32_t));
+      memset (poller->fd_gen + poller->fd_gen_len,
+              0,
+              (len - poller->fd_gen_len) * sizeof (uint32_t));
+      poller->fd_gen_len = len;
+   }
+
+   poller->fd_gen[fd] = poller->gen;
+
+   return true;
+}
+#endif
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_socket_poller_poll --
+ *
+ *       Like mongoc_socket_poll, but keeps the sockets registered with
+ *       @poller between calls when built with epoll.
+ *
+ *       Sockets the previous call polled but this call does not are
+ *       unregistered. Each socket must be polled by one poller at a
+ *       time.
+ *
+ * Returns:
+ *       The number of sockets ready, or -1 on failure.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+ssize_t
+_mongoc_socket_poller_poll (mongoc_socket_poller_t *poller,
+                            mongoc_socket_poll_t *sds,
+                            size_t nsds,
+                            int32_t timeout)
+{
+#ifdef MONGOC_ENABLE_EPOLL
+   mongoc_socket_t *sock;
+   uint32_t revents;
+   size_t i;
+   int n;
+   int fd;
+
+   BSON_ASSERT (poller);
+   BSON_ASSERT (sds || !nsds);
+
+   _mongoc_socket_poller_check_pid (poller);
+
+   if (poller->epfd < 0 || nsds == 0 || nsds > INT_MAX) {
+      return mongoc_socket_poll (sds, nsds, timeout);
+   }
+
+   if (++poller->gen == 0) {
+      /* wrapped; 0 means "never polled" */
+      poller->gen = 1;
+   }
+
+   for (i = 0; i < nsds; i++) {
+      sock = sds[i].socket;
+      sds[i].revents = 0;
+
+      if (!_mongoc_socket_poller_track (poller, sock->sd) ||
+          !_mongoc_socket_poller_register (poller, sock, sds[i].events)) {
+         return -1;
+      }
+
+      sock->poller_gen = poller->gen;
+      sock->poller_index = i;
+      sock->poller_ready = false;
+   }
+
+   /* unregister the sockets the last call polled and this one does not, so
+    * every event reported below is for a socket in @sds. an fd that was
+    * closed since is already gone, so errors are expected and ignored. */
+   for (i = 0; i < poller->n_fds; i++) {
+      fd = poller->fds[i];
+      if (poller->fd_gen[fd] != poller->gen) {
+         (void) epoll_ctl (poller->epfd, EPOLL_CTL_DEL, fd, NULL);
+      }
+   }
+
+   if (poller->fds_len < nsds) {
+      poller->fds_len = nsds;
+      poller->fds =
+         (int *) bson_realloc (poller->fds, nsds * sizeof (*poller->fds));
+   }
+
+   for (i = 0; i < nsds; i++) {
+      poller->fds[i] = sds[i].socket->sd;
+   }
+
+   poller->n_fds = nsds;
+
+   if (poller->events_len < nsds) {
+      poller->events_len = nsds;
+      poller->events = (struct epoll_event *) bson_realloc (
+         poller->events, nsds * sizeof (*poller->events));
+   }
+
+   n = epoll_wait (poller->epfd, poller->events, (int) nsds, timeout);
+
+   for (i = 0; n > 0 && i < (size_t) n; i++) {
+      sock = (mongoc_socket_t *) poller->events[i].data.ptr;
+      revents = poller->events[i].events;
+
+      BSON_ASSERT (sock->poller_gen == poller->gen);
+
+      sock->poller_ready = true;
+      sds[sock->poller_index].revents =
+         ((revents & EPOLLIN) ? POLLIN : 0) |
+         ((revents & EPOLLOUT) ? POLLOUT : 0) |
+         ((revents & EPOLLERR) ? POLLERR : 0) |
+         ((revents & EPOLLHUP) ? POLLHUP : 0);
+   }
+
+   return n;
+#else
+   BSON_ASSERT (poller);
+
+   return mongoc_socket_poll (sds, nsds, timeout);
+#endif
+}
+
+
 /* https://jira.mongodb.org/browse/CDRIVER-2176 */
 #define MONGODB_KEEPALIVEINTVL 10
 #define MONGODB_KEEPIDLE 300
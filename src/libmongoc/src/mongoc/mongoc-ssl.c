@@ -109,6 +109,8 @@ _mongoc_ssl_opts_from_uri (mongoc_ssl_opt_t *ssl_opt, mongoc_uri_t *uri)
       uri, MONGOC_URI_TLSALLOWINVALIDCERTIFICATES, insecure);
    ssl_opt->allow_invalid_hostname = mongoc_uri_get_option_as_bool (
       uri, MONGOC_URI_TLSALLOWINVALIDHOSTNAMES, insecure);
+   ssl_opt->kernel_tls =
+      mongoc_uri_get_option_as_bool (uri, MONGOC_URI_TLSKERNELTLS, false);
 }
 
 void
@@ -124,6 +126,7 @@ _mongoc_ssl_opts_copy_to (const mongoc_ssl_opt_t *src, mongoc_ssl_opt_t *dst)
    dst->crl_file = bson_strdup (src->crl_file);
    dst->weak_cert_validation = src->weak_cert_validation;
    dst->allow_invalid_hostname = src->allow_invalid_hostname;
+   dst->kernel_tls = src->kernel_tls;
 }
 
 void
@@ -37,6 +37,7 @@ struct _mongoc_ssl_opt_t {
    const char *crl_file;
    bool weak_cert_validation;
    bool allow_invalid_hostname;
+   bool kernel_tls;
    void *padding[7];
 };
 
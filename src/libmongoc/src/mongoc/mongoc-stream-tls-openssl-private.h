@@ -34,6 +34,16 @@ typedef struct {
    BIO *bio;
    BIO_METHOD *meth;
    SSL_CTX *ctx;
+   /* writev packs iovecs into full TLS records here, allocated on first
+    * write */
+   char *write_buf;
+   /* with kernel_tls, OpenSSL reads and writes the socket directly instead
+    * of through the mongoc_stream_t shim, and if the kernel took over
+    * encrypting, writes bypass OpenSSL */
+   bool socket_bio;
+   bool ktls_send;
+   /* the last read or write on the socket BIO timed out */
+   bool timed_out;
 } mongoc_stream_tls_openssl_t;
 
 
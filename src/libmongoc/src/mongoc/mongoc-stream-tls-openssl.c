@@ -34,6 +34,8 @@
 #include "mongoc-stream-tls-private.h"
 #include "mongoc-stream-tls-openssl-bio-private.h"
 #include "mongoc-stream-tls-openssl-private.h"
+#include "mongoc-stream-socket.h"
+#include "mongoc-socket-private.h"
 #include "mongoc-openssl-private.h"
 #include "mongoc-trace-private.h"
 #include "mongoc-log.h"
@@ -43,7 +45,16 @@
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "stream-tls-openssl"
 
-#define MONGOC_STREAM_TLS_OPENSSL_BUFFER_SIZE 4096
+/* the largest TLS record plaintext, SSL3_RT_MAX_PLAIN_LENGTH */
+#define MONGOC_STREAM_TLS_OPENSSL_RECORD_SIZE 16384
+
+/* OpenSSL 3.0 can hand record encryption to the kernel (kTLS) when it runs
+ * directly on a socket */
+#if defined(SSL_OP_ENABLE_KTLS) && defined(__linux__)
+#define MONGOC_STREAM_TLS_OPENSSL_KTLS
+#include <pthread.h>
+#include <signal.h>
+#endif
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L || (defined(LIBRESSL_VERSION_NUMBER) && LIBRESSL_VERSION_NUMBER < 0x20700000L)
 static void
@@ -54,6 +65,63 @@ BIO_meth_free (BIO_METHOD *meth)
 #endif
 
 
+#ifdef MONGOC_STREAM_TLS_OPENSSL_KTLS
+/* OpenSSL's socket BIO sends with write(2), which raises SIGPIPE if the peer
+ * closed the connection, where the rest of the driver sends with
+ * MSG_NOSIGNAL. Calls into OpenSSL on the socket BIO block SIGPIPE in the
+ * calling thread and discard the one they raised, if any. */
+typedef struct {
+   bool blocked;
+   bool was_pending;
+   sigset_t old_mask;
+} mongoc_sigpipe_guard_t;
+
+static void
+_mongoc_sigpipe_block (const mongoc_stream_tls_openssl_t *openssl,
+                       mongoc_sigpipe_guard_t *guard)
+{
+   sigset_t pipe_set;
+   sigset_t pending;
+
+   guard->blocked = openssl->socket_bio;
+   if (!guard->blocked) {
+      return;
+   }
+
+   sigemptyset (&pipe_set);
+   sigaddset (&pipe_set, SIGPIPE);
+   sigpending (&pending);
+   guard->was_pending = sigismember (&pending, SIGPIPE) == 1;
+   pthread_sigmask (SIG_BLOCK, &pipe_set, &guard->old_mask);
+}
+
+static void
+_mongoc_sigpipe_restore (mongoc_sigpipe_guard_t *guard)
+{
+   sigset_t pipe_set;
+   sigset_t pending;
+   struct timespec zero = {0, 0};
+
+   if (!guard->blocked) {
+      return;
+   }
+
+   sigemptyset (&pipe_set);
+   sigaddset (&pipe_set, SIGPIPE);
+   if (!guard->was_pending && !sigpending (&pending) &&
+       sigismember (&pending, SIGPIPE) == 1) {
+      sigtimedwait (&pipe_set, NULL, &zero);
+   }
+
+   pthread_sigmask (SIG_SETMASK, &guard->old_mask, NULL);
+}
+#else
+typedef int mongoc_sigpipe_guard_t;
+#define _mongoc_sigpipe_block(_openssl, _guard) ((void) (_guard))
+#define _mongoc_sigpipe_restore(_guard) ((void) (_guard))
+#endif
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -78,10 +146,14 @@ _mongoc_stream_tls_openssl_destroy (mongoc_stream_t *stream)
    mongoc_stream_tls_t *tls = (mongoc_stream_tls_t *) stream;
    mongoc_stream_tls_openssl_t *openssl =
       (mongoc_stream_tls_openssl_t *) tls->ctx;
+   mongoc_sigpipe_guard_t sigpipe;
 
    BSON_ASSERT (tls);
 
+   /* freeing the SSL BIO sends a close_notify alert */
+   _mongoc_sigpipe_block (openssl, &sigpipe);
    BIO_free_all (openssl->bio);
+   _mongoc_sigpipe_restore (&sigpipe);
    openssl->bio = NULL;
 
    BIO_meth_free (openssl->meth);
@@ -93,6 +165,7 @@ _mongoc_stream_tls_openssl_destroy (mongoc_stream_t *stream)
    SSL_CTX_free (openssl->ctx);
    openssl->ctx = NULL;
 
+   bson_free (openssl->write_buf);
    bson_free (openssl);
    bson_free (stream);
 
@@ -187,6 +260,60 @@ _mongoc_stream_tls_openssl_flush (mongoc_stream_t *stream)
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_stream_tls_openssl_wait --
+ *
+ *       When OpenSSL runs directly on a non-blocking socket, for kernel
+ *       TLS, wait until the socket is ready for the BIO operation that
+ *       asked to be retried, or until @expire (0 for no timeout).
+ *
+ * Returns:
+ *       true if the operation can be retried, false and errno set if
+ *       we timed out or polling failed.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_stream_tls_openssl_wait (mongoc_stream_tls_t *tls, int64_t expire)
+{
+   mongoc_stream_tls_openssl_t *openssl =
+      (mongoc_stream_tls_openssl_t *) tls->ctx;
+   mongoc_stream_poll_t poller;
+   int32_t timeout_msec = -1;
+   int64_t now;
+   ssize_t r;
+
+   if (expire) {
+      now = bson_get_monotonic_time ();
+      timeout_msec = (int32_t) BSON_MAX (0, (expire - now) / 1000L);
+   }
+
+   poller.stream = tls->base_stream;
+   poller.events = BIO_should_write (openssl->bio) ? POLLOUT : POLLIN;
+   poller.revents = 0;
+
+   r = mongoc_stream_poll (&poller, 1, timeout_msec);
+   if (r > 0) {
+      return true;
+   }
+
+   if (r == 0) {
+      mongoc_counter_streams_timeout_inc ();
+      openssl->timed_out = true;
+#ifdef _WIN32
+      errno = WSAETIMEDOUT;
+#else
+      errno = ETIMEDOUT;
+#endif
+   }
+
+   return false;
+}
+
+
 static ssize_t
 _mongoc_stream_tls_openssl_write (mongoc_stream_tls_t *tls,
                                   char *buf,
@@ -197,6 +324,7 @@ _mongoc_stream_tls_openssl_write (mongoc_stream_tls_t *tls,
    ssize_t ret;
    int64_t now;
    int64_t expire = 0;
+   mongoc_sigpipe_guard_t sigpipe;
    ENTRY;
 
    BSON_ASSERT (tls);
@@ -207,7 +335,19 @@ _mongoc_stream_tls_openssl_write (mongoc_stream_tls_t *tls,
       expire = bson_get_monotonic_time () + (tls->timeout_msec * 1000UL);
    }
 
+   _mongoc_sigpipe_block (openssl, &sigpipe);
    ret = BIO_write (openssl->bio, buf, buf_len);
+   _mongoc_sigpipe_restore (&sigpipe);
+
+   while (ret <= 0 && openssl->socket_bio && BIO_should_retry (openssl->bio)) {
+      if (!_mongoc_stream_tls_openssl_wait (tls, expire)) {
+         return -1;
+      }
+
+      _mongoc_sigpipe_block (openssl, &sigpipe);
+      ret = BIO_write (openssl->bio, buf, buf_len);
+      _mongoc_sigpipe_restore (&sigpipe);
+   }
 
    if (ret <= 0) {
       return ret;
@@ -240,13 +380,18 @@ _mongoc_stream_tls_openssl_write (mongoc_stream_tls_t *tls,
  *       all of the bytes or fail. If the number of bytes is not equal
  *       to the number requested, a failure or EOF has occurred.
  *
+ *       The iovecs are packed into full-size TLS records: bytes are
+ *       staged in the stream's write buffer until it holds a whole
+ *       record, and runs of whole records are written straight from an
+ *       iovec when nothing is staged. Only the last record of a call may
+ *       be short, however many iovecs the message is split into.
+ *
  * Returns:
  *       -1 on failure, otherwise the number of bytes written.
  *
  * Side effects:
  *       None.
  *
- * This function is copied as _mongoc_stream_tls_secure_transport_writev
  *--------------------------------------------------------------------------
  */
 
@@ -257,28 +402,16 @@ _mongoc_stream_tls_openssl_writev (mongoc_stream_t *stream,
                                    int32_t timeout_msec)
 {
    mongoc_stream_tls_t *tls = (mongoc_stream_tls_t *) stream;
-   char buf[MONGOC_STREAM_TLS_OPENSSL_BUFFER_SIZE];
+   mongoc_stream_tls_openssl_t *openssl;
+   const size_t record_size = MONGOC_STREAM_TLS_OPENSSL_RECORD_SIZE;
    ssize_t ret = 0;
    ssize_t child_ret;
    size_t i;
-   size_t iov_pos = 0;
-
-   /* There's a bit of a dance to coalesce vectorized writes into
-    * MONGOC_STREAM_TLS_OPENSSL_BUFFER_SIZE'd writes to avoid lots of small tls
-    * packets.
-    *
-    * The basic idea is that we want to combine writes in the buffer if they're
-    * smaller than the buffer, flushing as it gets full.  For larger writes, or
-    * the last write in the iovec array, we want to ignore the buffer and just
-    * write immediately.  We take care of doing buffer writes by re-invoking
-    * ourself with a single iovec_t, pointing at our stack buffer.
-    */
-   char *buf_head = buf;
-   char *buf_tail = buf;
-   char *buf_end = buf + MONGOC_STREAM_TLS_OPENSSL_BUFFER_SIZE;
+   size_t iov_pos;
+   size_t remaining;
+   size_t staged = 0;
    size_t bytes;
-
-   char *to_write = NULL;
+   char *to_write;
    size_t to_write_len;
 
    BSON_ASSERT (tls);
@@ -286,84 +419,91 @@ _mongoc_stream_tls_openssl_writev (mongoc_stream_t *stream,
    BSON_ASSERT (iovcnt);
    ENTRY;
 
+   openssl = (mongoc_stream_tls_openssl_t *) tls->ctx;
    tls->timeout_msec = timeout_msec;
+   openssl->timed_out = false;
+
+   if (openssl->ktls_send) {
+      /* The kernel encrypts what we write to the socket, and packs the
+       * iovecs into records itself */
+      ret = mongoc_stream_writev (tls->base_stream, iov, iovcnt, timeout_msec);
+      if (ret >= 0) {
+         mongoc_counter_streams_egress_add (ret);
+      }
+
+      RETURN (ret);
+   }
+
+   if (!openssl->write_buf) {
+      openssl->write_buf = (char *) bson_malloc (record_size);
+   }
 
    for (i = 0; i < iovcnt; i++) {
       iov_pos = 0;
 
       while (iov_pos < iov[i].iov_len) {
-         if (buf_head != buf_tail ||
-             ((i + 1 < iovcnt) &&
-              ((buf_end - buf_tail) > (iov[i].iov_len - iov_pos)))) {
-            /* If we have either of:
-             *   - buffered bytes already
-             *   - another iovec to send after this one and we don't have more
-             *     bytes to send than the size of the buffer.
-             *
-             * copy into the buffer */
-
-            bytes = BSON_MIN (iov[i].iov_len - iov_pos, buf_end - buf_tail);
-
-            memcpy (buf_tail, (char *) iov[i].iov_base + iov_pos, bytes);
-            buf_tail += bytes;
-            iov_pos += bytes;
-
-            if (buf_tail == buf_end) {
-               /* If we're full, request send */
-
-               to_write = buf_head;
-               to_write_len = buf_tail - buf_head;
-
-               buf_tail = buf_head = buf;
-            }
-         } else {
-            /* Didn't buffer, so just write it through */
+         remaining = iov[i].iov_len - iov_pos;
 
+         if (staged == 0 && (remaining >= record_size || i + 1 == iovcnt)) {
+            /* Nothing is staged: write whole records straight from the
+             * iovec, or all of the last iovec, and stage the rest */
             to_write = (char *) iov[i].iov_base + iov_pos;
-            to_write_len = iov[i].iov_len - iov_pos;
+            to_write_len = remaining;
+            if (i + 1 < iovcnt) {
+               to_write_len -= remaining % record_size;
+            }
 
             iov_pos += to_write_len;
-         }
-
-         if (to_write) {
-            /* We get here if we buffered some bytes and filled the buffer, or
-             * if we didn't buffer and have to send out of the iovec */
+         } else {
+            bytes = BSON_MIN (remaining, record_size - staged);
+            memcpy (openssl->write_buf + staged,
+                    (char *) iov[i].iov_base + iov_pos,
+                    bytes);
+            staged += bytes;
+            iov_pos += bytes;
 
-            child_ret =
-               _mongoc_stream_tls_openssl_write (tls, to_write, to_write_len);
-            if (child_ret != to_write_len) {
-               TRACE ("Got child_ret: %ld while to_write_len is: %ld",
-                      child_ret,
-                      to_write_len);
+            if (staged < record_size) {
+               continue;
             }
 
-            if (child_ret < 0) {
-               TRACE ("Returning what I had (%ld) as apposed to the error "
-                      "(%ld, errno:%d)",
-                      ret,
-                      child_ret,
-                      errno);
-               RETURN (ret);
-            }
+            /* A whole record is staged */
+            to_write = openssl->write_buf;
+            to_write_len = staged;
+            staged = 0;
+         }
+
+         child_ret =
+            _mongoc_stream_tls_openssl_write (tls, to_write, to_write_len);
+         if (child_ret != to_write_len) {
+            TRACE ("Got child_ret: %ld while to_write_len is: %ld",
+                   child_ret,
+                   to_write_len);
+         }
 
-            ret += child_ret;
+         if (child_ret < 0) {
+            TRACE ("Returning what I had (%ld) as apposed to the error "
+                   "(%ld, errno:%d)",
+                   ret,
+                   child_ret,
+                   errno);
+            RETURN (ret);
+         }
 
-            if (child_ret < to_write_len) {
-               /* we timed out, so send back what we could send */
+         ret += child_ret;
 
-               RETURN (ret);
-            }
+         if (child_ret < to_write_len) {
+            /* we timed out, so send back what we could send */
 
-            to_write = NULL;
+            RETURN (ret);
          }
       }
    }
 
-   if (buf_head != buf_tail) {
-      /* If we have any bytes buffered, send */
+   if (staged) {
+      /* Send the short record that is left */
 
       child_ret =
-         _mongoc_stream_tls_openssl_write (tls, buf_head, buf_tail - buf_head);
+         _mongoc_stream_tls_openssl_write (tls, openssl->write_buf, staged);
 
       if (child_ret < 0) {
          RETURN (child_ret);
@@ -416,6 +556,7 @@ _mongoc_stream_tls_openssl_readv (mongoc_stream_t *stream,
    size_t iov_pos = 0;
    int64_t now;
    int64_t expire = 0;
+   mongoc_sigpipe_guard_t sigpipe;
    ENTRY;
 
    BSON_ASSERT (tls);
@@ -423,6 +564,7 @@ _mongoc_stream_tls_openssl_readv (mongoc_stream_t *stream,
    BSON_ASSERT (iovcnt);
 
    tls->timeout_msec = timeout_msec;
+   openssl->timed_out = false;
 
    if (timeout_msec >= 0) {
       expire = bson_get_monotonic_time () + (timeout_msec * 1000UL);
@@ -432,9 +574,21 @@ _mongoc_stream_tls_openssl_readv (mongoc_stream_t *stream,
       iov_pos = 0;
 
       while (iov_pos < iov[i].iov_len) {
+         /* reading may send, e.g. to answer a TLS 1.3 KeyUpdate */
+         _mongoc_sigpipe_block (openssl, &sigpipe);
          read_ret = BIO_read (openssl->bio,
                               (char *) iov[i].iov_base + iov_pos,
                               (int) (iov[i].iov_len - iov_pos));
+         _mongoc_sigpipe_restore (&sigpipe);
+
+         if (read_ret <= 0 && openssl->socket_bio &&
+             BIO_should_retry (openssl->bio)) {
+            if (!_mongoc_stream_tls_openssl_wait (tls, expire)) {
+               RETURN (-1);
+            }
+
+            continue;
+         }
 
          /* https://www.openssl.org/docs/crypto/BIO_should_retry.html:
           *
@@ -550,6 +704,8 @@ mongoc_stream_tls_openssl_handshake (mongoc_stream_t *stream,
    mongoc_stream_tls_openssl_t *openssl =
       (mongoc_stream_tls_openssl_t *) tls->ctx;
    SSL *ssl;
+   mongoc_sigpipe_guard_t sigpipe;
+   long r;
 
    BSON_ASSERT (tls);
    BSON_ASSERT (host);
@@ -557,9 +713,25 @@ mongoc_stream_tls_openssl_handshake (mongoc_stream_t *stream,
 
    BIO_get_ssl (openssl->bio, &ssl);
 
-   if (BIO_do_handshake (openssl->bio) == 1) {
+   _mongoc_sigpipe_block (openssl, &sigpipe);
+   r = BIO_do_handshake (openssl->bio);
+   _mongoc_sigpipe_restore (&sigpipe);
+
+   if (r == 1) {
       if (_mongoc_openssl_check_cert (
              ssl, host, tls->ssl_opts.allow_invalid_hostname)) {
+#ifdef MONGOC_STREAM_TLS_OPENSSL_KTLS
+         if (openssl->socket_bio) {
+            /* OpenSSL enabled kTLS during the handshake if the kernel and
+             * the negotiated cipher support it. Received records still go
+             * through SSL_read, which handles the records that aren't
+             * application data. */
+            openssl->ktls_send = BIO_get_ktls_send (SSL_get_wbio (ssl)) != 0;
+            TRACE ("kernel TLS send: %d, receive: %d",
+                   (int) openssl->ktls_send,
+                   (int) (BIO_get_ktls_recv (SSL_get_rbio (ssl)) != 0));
+         }
+#endif
          RETURN (true);
       }
 
@@ -621,9 +793,15 @@ static bool
 _mongoc_stream_tls_openssl_timed_out (mongoc_stream_t *stream)
 {
    mongoc_stream_tls_t *tls = (mongoc_stream_tls_t *) stream;
+   mongoc_stream_tls_openssl_t *openssl =
+      (mongoc_stream_tls_openssl_t *) tls->ctx;
 
    ENTRY;
 
+   if (openssl->timed_out) {
+      RETURN (true);
+   }
+
    RETURN (mongoc_stream_timed_out (tls->base_stream));
 }
 
@@ -643,6 +821,47 @@ _mongoc_stream_tls_openssl_should_retry (mongoc_stream_t *stream)
    RETURN (mongoc_stream_should_retry (tls->base_stream));
 }
 
+#ifdef MONGOC_STREAM_TLS_OPENSSL_KTLS
+/* Create an SSL BIO that reads and writes @sock directly, with kTLS enabled.
+ * @sock remains owned by the base stream. */
+static BIO *
+_mongoc_stream_tls_openssl_socket_bio_new (SSL_CTX *ssl_ctx,
+                                           mongoc_socket_t *sock,
+                                           int client)
+{
+   BIO *bio_ssl;
+   BIO *bio_socket;
+   SSL *ssl;
+
+   ssl = SSL_new (ssl_ctx);
+   if (!ssl) {
+      return NULL;
+   }
+
+   bio_socket = BIO_new_socket ((int) sock->sd, BIO_NOCLOSE);
+   bio_ssl = BIO_new (BIO_f_ssl ());
+   if (!bio_socket || !bio_ssl) {
+      BIO_free (bio_socket);
+      BIO_free (bio_ssl);
+      SSL_free (ssl);
+      return NULL;
+   }
+
+   SSL_set_options (ssl, SSL_OP_ENABLE_KTLS);
+   SSL_set_bio (ssl, bio_socket, bio_socket);
+   if (client) {
+      SSL_set_connect_state (ssl);
+   } else {
+      SSL_set_accept_state (ssl);
+   }
+
+   BIO_set_ssl (bio_ssl, ssl, BIO_CLOSE);
+
+   return bio_ssl;
+}
+#endif
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -720,17 +939,37 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
       SSL_CTX_set_verify (ssl_ctx, SSL_VERIFY_PEER, NULL);
    }
 
-   bio_ssl = BIO_new_ssl (ssl_ctx, client);
-   if (!bio_ssl) {
-      SSL_CTX_free (ssl_ctx);
-      RETURN (NULL);
-   }
-   meth = mongoc_stream_tls_openssl_bio_meth_new ();
-   bio_mongoc_shim = BIO_new (meth);
-   if (!bio_mongoc_shim) {
-      BIO_free_all (bio_ssl);
-      BIO_meth_free (meth);
-      RETURN (NULL);
+#ifdef MONGOC_STREAM_TLS_OPENSSL_KTLS
+   if (opt->kernel_tls && base_stream->type == MONGOC_STREAM_SOCKET) {
+      /* OpenSSL can only enable kTLS on a socket BIO, so it runs directly on
+       * the socket instead of through the mongoc_stream_t shim. If kTLS is
+       * unavailable it still works, encrypting in user space. */
+      mongoc_socket_t *sock = mongoc_stream_socket_get_socket (
+         (mongoc_stream_socket_t *) base_stream);
+
+      bio_ssl =
+         _mongoc_stream_tls_openssl_socket_bio_new (ssl_ctx, sock, client);
+      if (!bio_ssl) {
+         SSL_CTX_free (ssl_ctx);
+         RETURN (NULL);
+      }
+
+      meth = NULL;
+   } else
+#endif
+   {
+      bio_ssl = BIO_new_ssl (ssl_ctx, client);
+      if (!bio_ssl) {
+         SSL_CTX_free (ssl_ctx);
+         RETURN (NULL);
+      }
+      meth = mongoc_stream_tls_openssl_bio_meth_new ();
+      bio_mongoc_shim = BIO_new (meth);
+      if (!bio_mongoc_shim) {
+         BIO_free_all (bio_ssl);
+         BIO_meth_free (meth);
+         RETURN (NULL);
+      }
    }
 
 /* Added in OpenSSL 0.9.8f, as a build time option */
@@ -744,12 +983,15 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
    }
 
 
-   BIO_push (bio_ssl, bio_mongoc_shim);
+   if (bio_mongoc_shim) {
+      BIO_push (bio_ssl, bio_mongoc_shim);
+   }
 
    openssl = (mongoc_stream_tls_openssl_t *) bson_malloc0 (sizeof *openssl);
    openssl->bio = bio_ssl;
    openssl->meth = meth;
    openssl->ctx = ssl_ctx;
+   openssl->socket_bio = !bio_mongoc_shim;
 
    tls = (mongoc_stream_tls_t *) bson_malloc0 (sizeof *tls);
    tls->parent.type = MONGOC_STREAM_TLS;
@@ -769,7 +1011,9 @@ mongoc_stream_tls_openssl_new (mongoc_stream_t *base_stream,
    tls->ctx = (void *) openssl;
    tls->timeout_msec = -1;
    tls->base_stream = base_stream;
-   mongoc_stream_tls_openssl_bio_set_data (bio_mongoc_shim, tls);
+   if (bio_mongoc_shim) {
+      mongoc_stream_tls_openssl_bio_set_data (bio_mongoc_shim, tls);
+   }
 
    mongoc_counter_streams_active_inc ();
 
@@ -89,6 +89,14 @@ mongoc_topology_description_select (mongoc_topology_description_t *description,
                                     const mongoc_read_prefs_t *read_pref,
                                     int64_t local_threshold_ms);
 
+mongoc_server_description_t *
+_mongoc_topology_description_select_with_seed (
+   mongoc_topology_description_t *description,
+   mongoc_ss_optype_t optype,
+   const mongoc_read_prefs_t *read_pref,
+   int64_t local_threshold_ms,
+   unsigned int *rand_seed);
+
 mongoc_server_description_t *
 mongoc_topology_description_server_by_id (
    mongoc_topology_description_t *description,
@@ -135,4 +143,8 @@ void
 mongoc_topology_description_update_cluster_time (
    mongoc_topology_description_t *td, const bson_t *reply);
 
+bool
+_mongoc_topology_description_has_later_cluster_time (
+   const mongoc_topology_description_t *td, const bson_t *reply);
+
 #endif /* MONGOC_TOPOLOGY_DESCRIPTION_PRIVATE_H */
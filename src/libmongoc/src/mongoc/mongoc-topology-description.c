@@ -790,6 +790,30 @@ mongoc_topology_description_select (mongoc_topology_description_t *topology,
                                     mongoc_ss_optype_t optype,
                                     const mongoc_read_prefs_t *read_pref,
                                     int64_t local_threshold_ms)
+{
+   return _mongoc_topology_description_select_with_seed (
+      topology, optype, read_pref, local_threshold_ms, &topology->rand_seed);
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_description_select_with_seed --
+ *
+ *      Like mongoc_topology_description_select, but draw the random choice
+ *      among suitable servers from the caller's @rand_seed. Lets several
+ *      threads select from one shared, read-only topology snapshot.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+mongoc_server_description_t *
+_mongoc_topology_description_select_with_seed (
+   mongoc_topology_description_t *topology,
+   mongoc_ss_optype_t optype,
+   const mongoc_read_prefs_t *read_pref,
+   int64_t local_threshold_ms,
+   unsigned int *rand_seed)
 {
    mongoc_array_t suitable_servers;
    mongoc_server_description_t *sd = NULL;
@@ -815,7 +839,7 @@ mongoc_topology_description_select (mongoc_topology_description_t *topology,
    mongoc_topology_description_suitable_servers (
       &suitable_servers, optype, topology, read_pref, local_threshold_ms);
    if (suitable_servers.len != 0) {
-      rand_n = _mongoc_rand_simple (&topology->rand_seed);
+      rand_n = _mongoc_rand_simple (rand_seed);
       sd = _mongoc_array_index (&suitable_servers,
                                 mongoc_server_description_t *,
                                 rand_n % suitable_servers.len);
@@ -1252,6 +1276,46 @@ mongoc_topology_description_update_cluster_time (
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_topology_description_has_later_cluster_time --
+ *
+ *  Return true if @reply has a $clusterTime later than @td's, that is, if
+ *  mongoc_topology_description_update_cluster_time would change @td. A
+ *  malformed $clusterTime counts as later so the caller goes on to
+ *  mongoc_topology_description_update_cluster_time, which logs it.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_topology_description_has_later_cluster_time (
+   const mongoc_topology_description_t *td, const bson_t *reply)
+{
+   bson_iter_t iter;
+   const uint8_t *data;
+   uint32_t size;
+   bson_t cluster_time;
+
+   if (!reply || !bson_iter_init_find (&iter, reply, "$clusterTime")) {
+      return false;
+   }
+
+   if (!BSON_ITER_HOLDS_DOCUMENT (&iter)) {
+      return true;
+   }
+
+   bson_iter_document (&iter, &size, &data);
+   if (!bson_init_static (&cluster_time, data, (size_t) size)) {
+      return true;
+   }
+
+   return bson_empty (&td->cluster_time) ||
+          _mongoc_cluster_time_greater (&cluster_time, &td->cluster_time);
+}
+
+
 static void
 _mongoc_topology_description_add_new_servers (
    mongoc_topology_description_t *topology, mongoc_server_description_t *server)
@@ -46,6 +46,17 @@ typedef enum {
 
 struct _mongoc_client_pool_t;
 
+/* An immutable, reference-counted copy of a topology description. In pooled
+ * mode the topology publishes a new one whenever its description changes, so
+ * client threads can select servers without taking the topology mutex. */
+typedef struct _mongoc_topology_snapshot_t {
+   mongoc_topology_description_t description;
+   volatile int32_t ref_count;
+   /* if set, a snapshot that differs only in cluster_time: "description"
+    * borrows its servers and set_name */
+   struct _mongoc_topology_snapshot_t *base;
+} mongoc_topology_snapshot_t;
+
 typedef struct _mongoc_topology_t {
    mongoc_topology_description_t description;
    mongoc_uri_t *uri;
@@ -64,6 +75,12 @@ typedef struct _mongoc_topology_t {
    int64_t rescanSRVIntervalMS;
    int64_t last_srv_scan;
 
+   /* pooled mode only: the latest copy of "description", replaced under
+    * "mutex" and read without it, see _mongoc_topology_snapshot_acquire */
+   mongoc_topology_snapshot_t *volatile snapshot;
+   volatile int32_t snapshot_epoch;
+   volatile int32_t snapshot_readers[2];
+
    bson_mutex_t mutex;
    mongoc_cond_t cond_client;
    mongoc_cond_t cond_server;
@@ -76,6 +93,9 @@ typedef struct _mongoc_topology_t {
 
    mongoc_server_session_t *session_pool;
 
+   /* pooled mode only: connections shared by the pool's clients */
+   struct _mongoc_connection_pool_t *connection_pool;
+
    /* Is client side encryption enabled? */
    bool cse_enabled;
 
@@ -113,6 +133,18 @@ mongoc_topology_compatible (const mongoc_topology_description_t *td,
                             const mongoc_read_prefs_t *read_prefs,
                             bson_error_t *error);
 
+void
+_mongoc_topology_snapshot_publish (mongoc_topology_t *topology);
+
+void
+_mongoc_topology_snapshot_publish_cluster_time (mongoc_topology_t *topology);
+
+mongoc_topology_snapshot_t *
+_mongoc_topology_snapshot_acquire (mongoc_topology_t *topology);
+
+void
+_mongoc_topology_snapshot_release (mongoc_topology_snapshot_t *snapshot);
+
 mongoc_server_description_t *
 mongoc_topology_select (mongoc_topology_t *topology,
                         mongoc_ss_optype_t optype,
@@ -25,6 +25,7 @@
 #include "mongoc-topology-private.h"
 #include "mongoc-topology-description-apm-private.h"
 #include "mongoc-client-private.h"
+#include "mongoc-cluster-private.h"
 #include "mongoc-cmd-private.h"
 #include "mongoc-uri-private.h"
 #include "mongoc-util-private.h"
@@ -32,6 +33,21 @@
 
 #include "utlist.h"
 
+#if defined(_MSC_VER)
+#define MONGOC_TOPOLOGY_TLS __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define MONGOC_TOPOLOGY_TLS __thread
+#endif
+
+/* the number of server selection seeds handed out, so that threads seeded
+ * in the same microsecond still draw different sequences */
+static int32_t gSelectSeedCount;
+
+#ifdef MONGOC_TOPOLOGY_TLS
+static MONGOC_TOPOLOGY_TLS bool gSelectSeeded;
+static MONGOC_TOPOLOGY_TLS unsigned int gSelectSeed;
+#endif
+
 static bool
 _mongoc_topology_reconcile_add_nodes (mongoc_server_description_t *sd,
                                       mongoc_topology_t *topology)
@@ -78,6 +94,178 @@ mongoc_topology_reconcile (mongoc_topology_t *topology)
 }
 
 
+/* swap in @snapshot as @topology's latest, then drop the published
+ * reference to the previous one */
+static void
+_mongoc_topology_snapshot_swap (mongoc_topology_t *topology,
+                                mongoc_topology_snapshot_t *snapshot)
+{
+   mongoc_topology_snapshot_t *prev;
+   int32_t epoch;
+
+   prev = topology->snapshot;
+   topology->snapshot = snapshot;
+   bson_memory_barrier ();
+
+   if (!prev) {
+      return;
+   }
+
+   /* a reader may have loaded "prev" and not yet taken its reference. new
+    * readers register in the other slot and can only see "snapshot", so the
+    * old slot empties within a few instructions of each reader in it.
+    * waiting here with the topology mutex held is safe: the reader section
+    * in _mongoc_topology_snapshot_acquire is a handful of atomic operations
+    * that never takes the mutex or blocks, so it is bounded. */
+   epoch = topology->snapshot_epoch;
+   topology->snapshot_epoch = epoch + 1;
+   bson_memory_barrier ();
+
+   while (bson_atomic_int_add (&topology->snapshot_readers[epoch & 1], 0)) {
+      _mongoc_usleep (1);
+   }
+
+   _mongoc_topology_snapshot_release (prev);
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_snapshot_publish --
+ *
+ *       Copy the topology description into a new snapshot and make it the
+ *       one returned by _mongoc_topology_snapshot_acquire. Call this after
+ *       changing the description. Single-threaded topologies have no
+ *       snapshot, so this does nothing for them.
+ *
+ *       NOTE: call this while holding @topology's mutex.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+void
+_mongoc_topology_snapshot_publish (mongoc_topology_t *topology)
+{
+   mongoc_topology_snapshot_t *snapshot;
+
+   if (topology->single_threaded) {
+      return;
+   }
+
+   snapshot = bson_malloc0 (sizeof *snapshot);
+   _mongoc_topology_description_copy_to (&topology->description,
+                                         &snapshot->description);
+   snapshot->ref_count = 1;
+
+   _mongoc_topology_snapshot_swap (topology, snapshot);
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_snapshot_publish_cluster_time --
+ *
+ *       Like _mongoc_topology_snapshot_publish, when only the description's
+ *       cluster_time has changed. That happens on most replies under a
+ *       write load, so rather than copying every server description, the
+ *       new snapshot shares them with the current one.
+ *
+ *       NOTE: call this while holding @topology's mutex.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+void
+_mongoc_topology_snapshot_publish_cluster_time (mongoc_topology_t *topology)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_topology_snapshot_t *base;
+
+   if (topology->single_threaded) {
+      return;
+   }
+
+   base = topology->snapshot->base ? topology->snapshot->base
+                                   : topology->snapshot;
+   bson_atomic_int_add (&base->ref_count, 1);
+
+   snapshot = bson_malloc0 (sizeof *snapshot);
+   memcpy (&snapshot->description,
+           &base->description,
+           sizeof (mongoc_topology_description_t));
+   bson_copy_to (&topology->description.cluster_time,
+                 &snapshot->description.cluster_time);
+   snapshot->ref_count = 1;
+   snapshot->base = base;
+
+   _mongoc_topology_snapshot_swap (topology, snapshot);
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_snapshot_acquire --
+ *
+ *       Return a reference to the latest published snapshot of a pooled
+ *       topology's description, without taking the topology mutex. The
+ *       snapshot is never modified; drop the reference with
+ *       _mongoc_topology_snapshot_release.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+mongoc_topology_snapshot_t *
+_mongoc_topology_snapshot_acquire (mongoc_topology_t *topology)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   volatile int32_t *readers;
+   int32_t epoch;
+
+   BSON_ASSERT (!topology->single_threaded);
+
+   /* a publisher only waits for the slot of the epoch it ends, so the
+    * registration counts only if the epoch didn't move meanwhile */
+   for (;;) {
+      epoch = bson_atomic_int_add (&topology->snapshot_epoch, 0);
+      readers = &topology->snapshot_readers[epoch & 1];
+      bson_atomic_int_add (readers, 1);
+
+      if (bson_atomic_int_add (&topology->snapshot_epoch, 0) == epoch) {
+         break;
+      }
+
+      bson_atomic_int_add (readers, -1);
+   }
+
+   snapshot = topology->snapshot;
+   bson_atomic_int_add (&snapshot->ref_count, 1);
+   bson_atomic_int_add (readers, -1);
+
+   return snapshot;
+}
+
+
+void
+_mongoc_topology_snapshot_release (mongoc_topology_snapshot_t *snapshot)
+{
+   if (!snapshot || bson_atomic_int_add (&snapshot->ref_count, -1) != 0) {
+      return;
+   }
+
+   if (snapshot->base) {
+      bson_destroy (&snapshot->description.cluster_time);
+      _mongoc_topology_snapshot_release (snapshot->base);
+   } else {
+      mongoc_topology_description_destroy (&snapshot->description);
+   }
+
+   bson_free (snapshot);
+}
+
+
 /* call this while already holding the lock */
 static bool
 _mongoc_topology_update_no_lock (uint32_t id,
@@ -88,6 +276,7 @@ _mongoc_topology_update_no_lock (uint32_t id,
 {
    mongoc_topology_description_handle_ismaster (
       &topology->description, id, ismaster_response, rtt_msec, error);
+   _mongoc_topology_snapshot_publish (topology);
 
    /* return false if server removed from topology */
    return mongoc_topology_description_server_by_id (
@@ -122,6 +311,7 @@ _mongoc_topology_scanner_setup_err_cb (uint32_t id,
                                                 NULL /* ismaster reply */,
                                                 -1 /* rtt_msec */,
                                                 error);
+   _mongoc_topology_snapshot_publish (topology);
 }
 
 
@@ -239,6 +429,9 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
    topology->uri = mongoc_uri_copy (uri);
 
    topology->single_threaded = single_threaded;
+   if (!single_threaded) {
+      topology->connection_pool = _mongoc_connection_pool_new (uri);
+   }
    if (single_threaded) {
       /* Server Selection Spec:
        *
@@ -347,6 +540,7 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
 
    if (!topology_valid) {
       /* add no nodes */
+      _mongoc_topology_snapshot_publish (topology);
       return topology;
    }
 
@@ -358,6 +552,8 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
       hl = hl->next;
    }
 
+   _mongoc_topology_snapshot_publish (topology);
+
    return topology;
 }
 /*
@@ -427,8 +623,10 @@ mongoc_topology_destroy (mongoc_topology_t *topology)
 
    _mongoc_topology_background_thread_stop (topology);
    _mongoc_topology_description_monitor_closed (&topology->description);
+   _mongoc_connection_pool_destroy (topology->connection_pool);
 
    mongoc_uri_destroy (topology->uri);
+   _mongoc_topology_snapshot_release (topology->snapshot);
    mongoc_topology_description_destroy (&topology->description);
    mongoc_topology_scanner_destroy (topology->scanner);
 
@@ -744,6 +942,76 @@ mongoc_topology_select (mongoc_topology_t *topology,
    }
 }
 
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_topology_select_from_snapshot --
+ *
+ *       Pooled mode only: try to select a server from the published
+ *       snapshot, without taking @topology's mutex. Returns 0 if none is
+ *       suitable or the topology is incompatible; the caller falls back to
+ *       the locked path, which reports errors and waits for the scanner.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+static unsigned int
+_mongoc_topology_new_select_seed (void)
+{
+   uint32_t n = (uint32_t) bson_atomic_int_add (&gSelectSeedCount, 1);
+
+   /* spread consecutive counts over all the bits of the seed */
+   return (unsigned int) bson_get_monotonic_time () ^ (n * 2654435761u);
+}
+
+
+static uint32_t
+_mongoc_topology_select_from_snapshot (mongoc_topology_t *topology,
+                                       mongoc_ss_optype_t optype,
+                                       const mongoc_read_prefs_t *read_prefs)
+{
+   mongoc_topology_snapshot_t *snapshot;
+   mongoc_server_description_t *sd = NULL;
+   unsigned int *rand_seed;
+   uint32_t server_id = 0;
+#ifndef MONGOC_TOPOLOGY_TLS
+   unsigned int local_seed;
+#endif
+
+   /* many threads share the snapshot, each draws from its own seed */
+#ifdef MONGOC_TOPOLOGY_TLS
+   if (!gSelectSeeded) {
+      gSelectSeed = _mongoc_topology_new_select_seed ();
+      gSelectSeeded = true;
+   }
+
+   rand_seed = &gSelectSeed;
+#else
+   local_seed = _mongoc_topology_new_select_seed ();
+   rand_seed = &local_seed;
+#endif
+
+   snapshot = _mongoc_topology_snapshot_acquire (topology);
+
+   if (snapshot->description.servers->items_len > 0 &&
+       mongoc_topology_compatible (&snapshot->description, read_prefs, NULL)) {
+      sd = _mongoc_topology_description_select_with_seed (
+         &snapshot->description,
+         optype,
+         read_prefs,
+         topology->local_threshold_msec,
+         rand_seed);
+   }
+
+   if (sd) {
+      server_id = sd->id;
+   }
+
+   _mongoc_topology_snapshot_release (snapshot);
+
+   return server_id;
+}
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -786,6 +1054,14 @@ mongoc_topology_select_server_id (mongoc_topology_t *topology,
    BSON_ASSERT (topology);
    ts = topology->scanner;
 
+   if (!topology->single_threaded) {
+      server_id =
+         _mongoc_topology_select_from_snapshot (topology, optype, read_prefs);
+      if (server_id) {
+         return server_id;
+      }
+   }
+
    bson_mutex_lock (&topology->mutex);
    /* It isn't strictly necessary to lock here, because if the topology
     * is invalid, it will never become valid. Lock anyway for consistency. */
@@ -963,7 +1239,8 @@ mongoc_topology_select_server_id (mongoc_topology_t *topology,
  *      NOTE: this method returns a copy of the original server
  *      description. Callers must own and clean up this copy.
  *
- *      NOTE: this method locks and unlocks @topology's mutex.
+ *      NOTE: if @topology is single-threaded this method locks and unlocks
+ *      its mutex, otherwise it reads the published snapshot.
  *
  * Returns:
  *      A mongoc_server_description_t, or NULL.
@@ -979,8 +1256,19 @@ mongoc_topology_server_by_id (mongoc_topology_t *topology,
                               uint32_t id,
                               bson_error_t *error)
 {
+   mongoc_topology_snapshot_t *snapshot;
    mongoc_server_description_t *sd;
 
+   if (!topology->single_threaded) {
+      snapshot = _mongoc_topology_snapshot_acquire (topology);
+      sd = mongoc_server_description_new_copy (
+         mongoc_topology_description_server_by_id (
+            &snapshot->description, id, error));
+      _mongoc_topology_snapshot_release (snapshot);
+
+      return sd;
+   }
+
    bson_mutex_lock (&topology->mutex);
 
    sd = mongoc_server_description_new_copy (
@@ -1079,6 +1367,7 @@ mongoc_topology_invalidate_server (mongoc_topology_t *topology,
    bson_mutex_lock (&topology->mutex);
    mongoc_topology_description_invalidate_server (
       &topology->description, id, error);
+   _mongoc_topology_snapshot_publish (topology);
    bson_mutex_unlock (&topology->mutex);
 }
 
@@ -1348,6 +1637,7 @@ _mongoc_topology_start_background_scanner (mongoc_topology_t *topology)
 
    _mongoc_handshake_freeze ();
    _mongoc_topology_description_monitor_opening (&topology->description);
+   _mongoc_topology_snapshot_publish (topology);
 
    r = bson_thread_create (
       &topology->thread, _mongoc_topology_run_background, topology);
@@ -1446,11 +1736,27 @@ void
 _mongoc_topology_update_cluster_time (mongoc_topology_t *topology,
                                       const bson_t *reply)
 {
+   mongoc_topology_snapshot_t *snapshot;
+   bool later;
+
+   if (!topology->single_threaded) {
+      /* most replies carry a clusterTime we've seen, skip the lock for them */
+      snapshot = _mongoc_topology_snapshot_acquire (topology);
+      later = _mongoc_topology_description_has_later_cluster_time (
+         &snapshot->description, reply);
+      _mongoc_topology_snapshot_release (snapshot);
+
+      if (!later) {
+         return;
+      }
+   }
+
    bson_mutex_lock (&topology->mutex);
    mongoc_topology_description_update_cluster_time (&topology->description,
                                                     reply);
    _mongoc_topology_scanner_set_cluster_time (
       topology->scanner, &topology->description.cluster_time);
+   _mongoc_topology_snapshot_publish_cluster_time (topology);
    bson_mutex_unlock (&topology->mutex);
 }
 
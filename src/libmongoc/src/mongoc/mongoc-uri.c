@@ -706,6 +706,7 @@ bool
 mongoc_uri_option_is_int32 (const char *key)
 {
    return mongoc_uri_option_is_int64 (key) ||
+          !strcasecmp (key, MONGOC_URI_COMPRESSIONTHRESHOLD) ||
           !strcasecmp (key, MONGOC_URI_CONNECTTIMEOUTMS) ||
           !strcasecmp (key, MONGOC_URI_HEARTBEATFREQUENCYMS) ||
           !strcasecmp (key, MONGOC_URI_SERVERSELECTIONTIMEOUTMS) ||
@@ -715,10 +716,12 @@ mongoc_uri_option_is_int32 (const char *key)
           !strcasecmp (key, MONGOC_URI_MAXPOOLSIZE) ||
           !strcasecmp (key, MONGOC_URI_MAXSTALENESSSECONDS) ||
           !strcasecmp (key, MONGOC_URI_MINPOOLSIZE) ||
+          !strcasecmp (key, MONGOC_URI_MINIDLECONNECTIONS) ||
           !strcasecmp (key, MONGOC_URI_MAXIDLETIMEMS) ||
           !strcasecmp (key, MONGOC_URI_WAITQUEUEMULTIPLE) ||
           !strcasecmp (key, MONGOC_URI_WAITQUEUETIMEOUTMS) ||
-          !strcasecmp (key, MONGOC_URI_ZLIBCOMPRESSIONLEVEL);
+          !strcasecmp (key, MONGOC_URI_ZLIBCOMPRESSIONLEVEL) ||
+          !strcasecmp (key, MONGOC_URI_ZSTDCOMPRESSIONLEVEL);
 }
 
 bool
@@ -730,7 +733,8 @@ mongoc_uri_option_is_int64 (const char *key)
 bool
 mongoc_uri_option_is_bool (const char *key)
 {
-   return !strcasecmp (key, MONGOC_URI_CANONICALIZEHOSTNAME) ||
+   return !strcasecmp (key, MONGOC_URI_ADAPTIVECOMPRESSION) ||
+          !strcasecmp (key, MONGOC_URI_CANONICALIZEHOSTNAME) ||
           !strcasecmp (key, MONGOC_URI_JOURNAL) ||
           !strcasecmp (key, MONGOC_URI_RETRYREADS) ||
           !strcasecmp (key, MONGOC_URI_RETRYWRITES) ||
@@ -739,6 +743,7 @@ mongoc_uri_option_is_bool (const char *key)
           !strcasecmp (key, MONGOC_URI_SLAVEOK) ||
           !strcasecmp (key, MONGOC_URI_TLS) ||
           !strcasecmp (key, MONGOC_URI_TLSINSECURE) ||
+          !strcasecmp (key, MONGOC_URI_TLSKERNELTLS) ||
           !strcasecmp (key, MONGOC_URI_TLSALLOWINVALIDCERTIFICATES) ||
           !strcasecmp (key, MONGOC_URI_TLSALLOWINVALIDHOSTNAMES) ||
           /* deprecated options */
@@ -2474,6 +2479,18 @@ _mongoc_uri_set_option_as_int32_with_error (mongoc_uri_t *uri,
       return false;
    }
 
+   if ((!bson_strcasecmp (option, MONGOC_URI_COMPRESSIONTHRESHOLD) ||
+        !bson_strcasecmp (option, MONGOC_URI_MAXIDLETIMEMS) ||
+        !bson_strcasecmp (option, MONGOC_URI_MINIDLECONNECTIONS) ||
+        !bson_strcasecmp (option, MONGOC_URI_WAITQUEUETIMEOUTMS)) &&
+       value < 0) {
+      MONGOC_URI_ERROR (error,
+                        "Invalid \"%s\" of %d: must be non-negative",
+                        option_orig,
+                        value);
+      return false;
+   }
+
    /* zlib levels are from -1 (default) through 9 (best compression) */
    if (!bson_strcasecmp (option, MONGOC_URI_ZLIBCOMPRESSIONLEVEL) &&
        (value < -1 || value > 9)) {
@@ -2484,6 +2501,18 @@ _mongoc_uri_set_option_as_int32_with_error (mongoc_uri_t *uri,
       return false;
    }
 
+   /* zstd levels are from 1 through 22 (best compression), 0 for the
+    * default, and negative for faster, weaker compression */
+   if (!bson_strcasecmp (option, MONGOC_URI_ZSTDCOMPRESSIONLEVEL) &&
+       (value < MONGOC_ZSTD_MIN_LEVEL || value > 22)) {
+      MONGOC_URI_ERROR (error,
+                        "Invalid \"%s\" of %d: must be between %d and 22",
+                        option_orig,
+                        value,
+                        MONGOC_ZSTD_MIN_LEVEL);
+      return false;
+   }
+
    if ((options = mongoc_uri_get_options (uri)) &&
        bson_iter_init_find_case (&iter, options, option)) {
       if (BSON_ITER_HOLDS_INT32 (&iter)) {
@@ -33,12 +33,14 @@
 #define MONGOC_DEFAULT_PORT 27017
 #endif
 
+#define MONGOC_URI_ADAPTIVECOMPRESSION "adaptivecompression"
 #define MONGOC_URI_APPNAME "appname"
 #define MONGOC_URI_AUTHMECHANISM "authmechanism"
 #define MONGOC_URI_AUTHMECHANISMPROPERTIES "authmechanismproperties"
 #define MONGOC_URI_AUTHSOURCE "authsource"
 #define MONGOC_URI_CANONICALIZEHOSTNAME "canonicalizehostname"
 #define MONGOC_URI_CONNECTTIMEOUTMS "connecttimeoutms"
+#define MONGOC_URI_COMPRESSIONTHRESHOLD "compressionthreshold"
 #define MONGOC_URI_COMPRESSORS "compressors"
 #define MONGOC_URI_GSSAPISERVICENAME "gssapiservicename"
 #define MONGOC_URI_HEARTBEATFREQUENCYMS "heartbeatfrequencyms"
@@ -47,6 +49,7 @@
 #define MONGOC_URI_MAXIDLETIMEMS "maxidletimems"
 #define MONGOC_URI_MAXPOOLSIZE "maxpoolsize"
 #define MONGOC_URI_MAXSTALENESSSECONDS "maxstalenessseconds"
+#define MONGOC_URI_MINIDLECONNECTIONS "minidleconnections"
 #define MONGOC_URI_MINPOOLSIZE "minpoolsize"
 #define MONGOC_URI_READCONCERNLEVEL "readconcernlevel"
 #define MONGOC_URI_READPREFERENCE "readpreference"
@@ -67,11 +70,13 @@
 #define MONGOC_URI_TLSALLOWINVALIDCERTIFICATES "tlsallowinvalidcertificates"
 #define MONGOC_URI_TLSALLOWINVALIDHOSTNAMES "tlsallowinvalidhostnames"
 #define MONGOC_URI_TLSINSECURE "tlsinsecure"
+#define MONGOC_URI_TLSKERNELTLS "tlskerneltls"
 #define MONGOC_URI_W "w"
 #define MONGOC_URI_WAITQUEUEMULTIPLE "waitqueuemultiple"
 #define MONGOC_URI_WAITQUEUETIMEOUTMS "waitqueuetimeoutms"
 #define MONGOC_URI_WTIMEOUTMS "wtimeoutms"
 #define MONGOC_URI_ZLIBCOMPRESSIONLEVEL "zlibcompressionlevel"
+#define MONGOC_URI_ZSTDCOMPRESSIONLEVEL "zstdcompressionlevel"
 
 /* Deprecated in MongoDB 4.2, use "tls" variants instead. */
 #define MONGOC_URI_SSL "ssl"
@@ -98,6 +98,12 @@ typedef enum {
 } mongoc_write_err_type_t;
 
 
+/* called by mongoc_init and mongoc_cleanup */
+void
+_mongoc_write_command_id_context_init (void);
+void
+_mongoc_write_command_id_context_cleanup (void);
+
 const char *
 _mongoc_command_type_to_field_name (int command_type);
 const char *
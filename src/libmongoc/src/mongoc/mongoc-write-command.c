@@ -26,6 +26,7 @@
 #include "mongoc-write-concern-private.h"
 #include "mongoc-util-private.h"
 #include "mongoc-opts-private.h"
+#include "mongoc-thread-private.h"
 
 
 /*
@@ -54,6 +55,26 @@ static mongoc_write_op_t gLegacyWriteOps[3] = {
    _mongoc_write_command_insert_legacy,
    _mongoc_write_command_update_legacy};
 
+/* generates "_id" for inserted documents without contending on a counter
+ * shared by all threads, and still notices a fork */
+static bson_context_t *gIdContext;
+
+
+void
+_mongoc_write_command_id_context_init (void)
+{
+   gIdContext = bson_context_new (BSON_CONTEXT_THREAD_LOCAL |
+                                  BSON_CONTEXT_DISABLE_PID_CACHE);
+}
+
+
+void
+_mongoc_write_command_id_context_cleanup (void)
+{
+   bson_context_destroy (gIdContext);
+   gIdContext = NULL;
+}
+
 
 const char *
 _mongoc_command_type_to_name (int command_type)
@@ -73,7 +94,9 @@ _mongoc_write_command_insert_append (mongoc_write_command_t *command,
 {
    bson_iter_t iter;
    bson_oid_t oid;
-   bson_t tmp;
+   /* document length, then the element type, key, and value of "_id" */
+   uint8_t prefix[4 + 1 + sizeof ("_id") + sizeof (oid.bytes)];
+   uint32_t len_le;
 
    ENTRY;
 
@@ -84,15 +107,22 @@ _mongoc_write_command_insert_append (mongoc_write_command_t *command,
 
    /*
     * If the document does not contain an "_id" field, we need to generate
-    * a new oid for "_id".
+    * a new oid for "_id". Write "_id" and then the document's elements
+    * straight into the payload, rather than building a new document.
     */
    if (!bson_iter_init_find (&iter, document, "_id")) {
-      bson_init (&tmp);
-      bson_oid_init (&oid, NULL);
-      BSON_APPEND_OID (&tmp, "_id", &oid);
-      bson_concat (&tmp, document);
-      _mongoc_buffer_append (&command->payload, bson_get_data (&tmp), tmp.len);
-      bson_destroy (&tmp);
+      bson_oid_init (&oid, gIdContext);
+
+      len_le = BSON_UINT32_TO_LE (document->len + 1 + sizeof ("_id") +
+                                  sizeof (oid.bytes));
+      memcpy (prefix, &len_le, 4);
+      prefix[4] = (uint8_t) BSON_TYPE_OID;
+      memcpy (prefix + 5, "_id", sizeof ("_id"));
+      memcpy (prefix + 5 + sizeof ("_id"), oid.bytes, sizeof (oid.bytes));
+
+      _mongoc_buffer_append (&command->payload, prefix, sizeof prefix);
+      _mongoc_buffer_append (
+         &command->payload, bson_get_data (document) + 4, document->len - 4);
    } else {
       _mongoc_buffer_append (
          &command->payload, bson_get_data (document), document->len);
@@ -512,6 +542,9 @@ _mongoc_write_opmsg (mongoc_write_command_t *command,
       EXIT;
    }
 
+   /* each reply is merged into the result before the next batch is sent */
+   parts.assembled.borrow_reply = true;
+
    /*
     * OP_MSG header == 16 byte
     * + 4 bytes flagBits
@@ -561,6 +594,7 @@ _mongoc_write_opmsg (mongoc_write_command_t *command,
       if (ship_it) {
          bool is_retryable = parts.is_retryable_write;
          mongoc_write_err_type_t error_type;
+         bson_t reply_copy;
 
          /* Seek past the document offset we have already sent */
          parts.assembled.payload = command->payload.data + payload_total_offset;
@@ -582,6 +616,15 @@ _mongoc_write_opmsg (mongoc_write_command_t *command,
          ret = mongoc_cluster_run_command_monitored (
             &client->cluster, &parts.assembled, &reply, error);
 
+         if (!ret) {
+            /* the error handling below may add labels to the reply, and
+             * selecting a server to retry on may run commands that would
+             * overwrite a borrowed one */
+            bson_copy_to (&reply, &reply_copy);
+            bson_destroy (&reply);
+            bson_steal (&reply, &reply_copy);
+         }
+
          /* Add this batch size so we skip these documents next time */
          payload_total_offset += payload_batch_size;
          payload_batch_size = 0;
@@ -49,6 +49,7 @@
 #include "mongoc-log.h"
 #include "mongoc-socket.h"
 #include "mongoc-client-session.h"
+#include "mongoc-client-async.h"
 #include "mongoc-stream.h"
 #include "mongoc-stream-buffered.h"
 #include "mongoc-stream-file.h"
@@ -16,6 +16,12 @@
 
 #define NUM_IOVECS 2000
 
+/* one of the client's iovecs is this large, so its write mixes small
+ * iovecs with one spanning several TLS records */
+#define LARGE_IOVEC_LEN (4 * 5000)
+
+#define MAX_LEN (4 * (NUM_IOVECS - 1) + LARGE_IOVEC_LEN)
+
 #define LOCALHOST "127.0.0.1"
 
 /** this function is meant to be run from ssl_test as a child thread
@@ -40,7 +46,7 @@ ssl_test_server (void *ptr)
    mongoc_socket_t *listen_sock;
    mongoc_socket_t *conn_sock;
    mongoc_socklen_t sock_len;
-   char buf[4 * NUM_IOVECS];
+   char buf[MAX_LEN];
    ssize_t r;
    bson_error_t error;
    mongoc_iovec_t iov;
@@ -178,6 +184,7 @@ ssl_test_client (void *ptr)
    mongoc_iovec_t riov;
    mongoc_iovec_t wiov;
    mongoc_iovec_t wiov_many[NUM_IOVECS];
+   char *large;
    struct sockaddr_in server_addr = {0};
    int len;
    bson_error_t error;
@@ -246,7 +253,7 @@ ssl_test_client (void *ptr)
       return NULL;
    }
 
-   len = 4 * NUM_IOVECS;
+   len = MAX_LEN;
 
    wiov.iov_base = (void *) &len;
    wiov.iov_len = 4;
@@ -254,13 +261,22 @@ ssl_test_client (void *ptr)
 
    BSON_ASSERT (r == wiov.iov_len);
 
+   large = bson_malloc (LARGE_IOVEC_LEN);
+   for (i = 0; i < LARGE_IOVEC_LEN; i += 4) {
+      memcpy (large + i, "foo", 4);
+   }
+
    for (i = 0; i < NUM_IOVECS; i++) {
       wiov_many[i].iov_base = (void *) "foo";
       wiov_many[i].iov_len = 4;
    }
 
+   wiov_many[NUM_IOVECS / 2].iov_base = large;
+   wiov_many[NUM_IOVECS / 2].iov_len = LARGE_IOVEC_LEN;
+
    r = mongoc_stream_writev (ssl_stream, wiov_many, NUM_IOVECS, TIMEOUT);
-   BSON_ASSERT (r == wiov_many[0].iov_len * NUM_IOVECS);
+   BSON_ASSERT (r == MAX_LEN);
+   bson_free (large);
 
    riov.iov_len = 1;
 
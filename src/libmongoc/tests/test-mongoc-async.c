@@ -9,6 +9,7 @@
 #include "mock_server/future-functions.h"
 #include "mongoc/mongoc-errno-private.h"
 #include "test-libmongoc.h"
+#include "test-conveniences.h"
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "async-test"
@@ -362,6 +363,185 @@ test_ismaster_delay ()
    mock_server_destroy (server);
 }
 
+static bool
+_client_async_responder (request_t *request, void *data)
+{
+   bson_iter_t iter;
+   char *reply;
+
+   if (!strcmp (request->command_name, "isMaster")) {
+      return false;
+   }
+
+   if (!strcmp (request->command_name, "echo")) {
+      BSON_ASSERT (
+         bson_iter_init_find (&iter, request_get_doc (request, 0), "echo"));
+      reply = bson_strdup_printf ("{'ok': 1, 'n': %d}",
+                                  (int) bson_iter_as_int64 (&iter));
+      mock_server_replies_simple (request, reply);
+      bson_free (reply);
+   } else if (!strcmp (request->command_name, "fail")) {
+      mock_server_replies_simple (request,
+                                  "{'ok': 0, 'code': 2, 'errmsg': 'failed'}");
+   } else if (!strcmp (request->command_name, "hangup")) {
+      mock_server_hangs_up (request);
+   } else {
+      /* "wait" gets no reply */
+      return false;
+   }
+
+   request_destroy (request);
+   return true;
+}
+
+
+typedef struct {
+   int n_called;
+   int n[8];
+   bson_error_t errors[8];
+} client_async_results_t;
+
+
+static void
+_client_async_cb (const bson_t *reply, const bson_error_t *error, void *data)
+{
+   client_async_results_t *results = (client_async_results_t *) data;
+   bson_iter_t iter;
+   int i = results->n_called++;
+
+   BSON_ASSERT (reply);
+   BSON_ASSERT (i < 8);
+
+   if (error) {
+      memcpy (&results->errors[i], error, sizeof (bson_error_t));
+      results->n[i] = -1;
+   } else {
+      BSON_ASSERT (bson_iter_init_find (&iter, reply, "n"));
+      results->n[i] = bson_iter_int32 (&iter);
+   }
+}
+
+
+static void
+_client_async_submit (mongoc_client_async_t *async,
+                      const char *name,
+                      int n,
+                      client_async_results_t *results)
+{
+   bson_error_t error;
+
+   ASSERT_OR_PRINT (
+      mongoc_client_async_command (async,
+                                   "db",
+                                   tmp_bson ("{'%s': %d}", name, n),
+                                   NULL,
+                                   _client_async_cb,
+                                   results,
+                                   &error),
+      error);
+}
+
+
+static void
+_client_async_wait (mongoc_client_async_t *async)
+{
+   int64_t start = bson_get_monotonic_time ();
+
+   while (mongoc_client_async_run (async, 100) > 0) {
+      ASSERT_CMPINT64 (
+         bson_get_monotonic_time () - start, <, (int64_t) TIMEOUT * 1000);
+   }
+}
+
+
+static void
+test_client_async (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_client_async_t *async;
+   client_async_results_t results = {0};
+   bson_error_t error;
+   int fds[2];
+   int events[2];
+   int i;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_autoresponds (server, _client_async_responder, NULL, NULL);
+   mock_server_run (server);
+
+   /* the topology scanner shares a single-threaded client's connections */
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+   BSON_ASSERT (!mongoc_client_async_new (client, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_COMMAND,
+                          MONGOC_ERROR_COMMAND_INVALID_ARG,
+                          "mongoc_client_pool_t");
+   mongoc_client_destroy (client);
+
+   pool = mongoc_client_pool_new (mock_server_get_uri (server));
+   client = mongoc_client_pool_pop (pool);
+   async = mongoc_client_async_new (client, &error);
+   ASSERT_OR_PRINT (async, error);
+
+   /* commands are queued on one connection and complete in order */
+   for (i = 0; i < 4; i++) {
+      _client_async_submit (async, "echo", i, &results);
+   }
+
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_get_fds (async, fds, events, 2), ==, (size_t) 1);
+   BSON_ASSERT (fds[0] >= 0);
+   BSON_ASSERT (events[0] & POLLIN);
+   BSON_ASSERT (events[0] & POLLOUT);
+
+   _client_async_wait (async);
+   ASSERT_CMPINT (results.n_called, ==, 4);
+   for (i = 0; i < 4; i++) {
+      ASSERT_CMPINT (results.n[i], ==, i);
+   }
+
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_get_fds (async, NULL, NULL, 0), ==, (size_t) 0);
+
+   /* a command error fails only that command */
+   memset (&results, 0, sizeof results);
+   _client_async_submit (async, "echo", 1, &results);
+   _client_async_submit (async, "fail", 1, &results);
+   _client_async_submit (async, "echo", 3, &results);
+   _client_async_wait (async);
+   ASSERT_CMPINT (results.n_called, ==, 3);
+   ASSERT_CMPINT (results.n[0], ==, 1);
+   ASSERT_ERROR_CONTAINS (results.errors[1], MONGOC_ERROR_QUERY, 2, "failed");
+   ASSERT_CMPINT (results.n[2], ==, 3);
+
+   /* a network error fails every command still in flight */
+   memset (&results, 0, sizeof results);
+   _client_async_submit (async, "echo", 1, &results);
+   _client_async_submit (async, "hangup", 1, &results);
+   _client_async_submit (async, "wait", 1, &results);
+   _client_async_wait (async);
+   ASSERT_CMPINT (results.n_called, ==, 3);
+   ASSERT_CMPINT (results.n[0], ==, 1);
+   ASSERT_CMPINT (results.errors[1].domain, ==, MONGOC_ERROR_STREAM);
+   ASSERT_CMPINT (results.errors[2].domain, ==, MONGOC_ERROR_STREAM);
+
+   /* the client reconnects, and destroying cancels commands in flight */
+   memset (&results, 0, sizeof results);
+   _client_async_submit (async, "echo", 1, &results);
+   _client_async_submit (async, "wait", 1, &results);
+   mongoc_client_async_run (async, 0);
+   mongoc_client_async_destroy (async);
+   ASSERT_CMPINT (results.n_called, ==, 2);
+   ASSERT_CONTAINS (results.errors[1].message, "canceled");
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
 void
 test_async_install (TestSuite *suite)
 {
@@ -381,4 +561,5 @@ test_async_install (TestSuite *suite)
                       test_framework_skip_if_windows);
 #endif
    TestSuite_AddMockServerTest (suite, "/Async/delay", test_ismaster_delay);
+   TestSuite_AddMockServerTest (suite, "/Async/client", test_client_async);
 }
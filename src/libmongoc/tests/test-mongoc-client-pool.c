@@ -1,10 +1,14 @@
 #include <mongoc/mongoc.h>
 #include "mongoc/mongoc-client-pool-private.h"
+#include "mongoc/mongoc-client-private.h"
 #include "mongoc/mongoc-util-private.h"
 
 
 #include "TestSuite.h"
+#include "test-conveniences.h"
 #include "test-libmongoc.h"
+#include "mock_server/future-functions.h"
+#include "mock_server/mock-server.h"
 
 
 static void
@@ -218,6 +222,322 @@ test_mongoc_client_pool_set_min_size (void)
    mongoc_client_pool_destroy (pool);
 }
 
+static void *
+pop_push_thread (void *data)
+{
+   mongoc_client_pool_t *pool = (mongoc_client_pool_t *) data;
+   mongoc_client_t *client;
+   int i;
+
+   for (i = 0; i < 1000; i++) {
+      client = mongoc_client_pool_pop (pool);
+      BSON_ASSERT (client);
+      mongoc_client_pool_push (pool, client);
+   }
+
+   return NULL;
+}
+
+static void *
+push_thread (void *data)
+{
+   mongoc_array_t *conns = (mongoc_array_t *) data;
+   mongoc_client_pool_t *pool;
+   size_t i;
+
+   pool = _mongoc_array_index (conns, mongoc_client_pool_t *, 0);
+   for (i = 1; i < conns->len; i++) {
+      mongoc_client_pool_push (
+         pool, _mongoc_array_index (conns, mongoc_client_t *, i));
+   }
+
+   return NULL;
+}
+
+/* more threads than clients, each thread pops and pushes its own shard */
+static void
+test_mongoc_client_pool_threads (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_uri_t *uri;
+   bson_thread_t threads[8];
+   int i;
+   int r;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=3");
+   pool = mongoc_client_pool_new (uri);
+
+   for (i = 0; i < 8; i++) {
+      r = bson_thread_create (&threads[i], &pop_push_thread, pool);
+      BSON_ASSERT (r == 0);
+   }
+
+   for (i = 0; i < 8; i++) {
+      r = bson_thread_join (threads[i]);
+      BSON_ASSERT (r == 0);
+   }
+
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), <=, (size_t) 3);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool),
+                     ==,
+                     mongoc_client_pool_get_size (pool));
+
+   mongoc_uri_destroy (uri);
+   mongoc_client_pool_destroy (pool);
+}
+
+/* clients pushed by one thread are popped by another, not recreated */
+static void
+test_mongoc_client_pool_steal (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   mongoc_array_t conns;
+   bson_thread_t thread;
+   int i;
+   int r;
+
+   _mongoc_array_init (&conns, sizeof client);
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=4");
+   pool = mongoc_client_pool_new (uri);
+   _mongoc_array_append_val (&conns, pool);
+
+   for (i = 0; i < 4; i++) {
+      client = mongoc_client_pool_pop (pool);
+      _mongoc_array_append_val (&conns, client);
+   }
+
+   r = bson_thread_create (&thread, &push_thread, &conns);
+   BSON_ASSERT (r == 0);
+   r = bson_thread_join (thread);
+   BSON_ASSERT (r == 0);
+
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool), ==, (size_t) 4);
+
+   for (i = 0; i < 4; i++) {
+      client = mongoc_client_pool_try_pop (pool);
+      BSON_ASSERT (client);
+      _mongoc_array_index (&conns, mongoc_client_t *, i + 1) = client;
+   }
+
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), ==, (size_t) 4);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool), ==, (size_t) 0);
+   BSON_ASSERT (!mongoc_client_pool_try_pop (pool));
+
+   for (i = 0; i < 4; i++) {
+      mongoc_client_pool_push (
+         pool, _mongoc_array_index (&conns, mongoc_client_t *, i + 1));
+   }
+
+   _mongoc_array_destroy (&conns);
+   mongoc_uri_destroy (uri);
+   mongoc_client_pool_destroy (pool);
+}
+
+static void
+test_mongoc_client_pool_wait_queue_timeout (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   int64_t started;
+
+   uri = mongoc_uri_new (
+      "mongodb://127.0.0.1/?maxpoolsize=1&waitqueuetimeoutms=100");
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+   BSON_ASSERT (client);
+
+   started = bson_get_monotonic_time ();
+   BSON_ASSERT (!mongoc_client_pool_pop (pool));
+   ASSERT_CMPINT64 (bson_get_monotonic_time () - started, >=, 100 * 1000);
+   ASSERT_CMPSIZE_T (_mongoc_client_pool_num_waiters (pool), ==, (size_t) 0);
+
+   mongoc_client_pool_push (pool, client);
+   client = mongoc_client_pool_pop (pool);
+   BSON_ASSERT (client);
+   mongoc_client_pool_push (pool, client);
+
+   mongoc_uri_destroy (uri);
+   mongoc_client_pool_destroy (pool);
+}
+
+static void *
+pop_thread (void *data)
+{
+   mongoc_client_pool_t *pool = (mongoc_client_pool_t *) data;
+   mongoc_client_t *client;
+
+   client = mongoc_client_pool_pop (pool);
+   BSON_ASSERT (client);
+   mongoc_client_pool_push (pool, client);
+
+   return NULL;
+}
+
+/* a waitQueueTimeoutMS too large for microseconds in 32 bits still waits */
+static void
+test_mongoc_client_pool_wait_queue_timeout_max (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   bson_thread_t thread;
+
+   uri = mongoc_uri_new (
+      "mongodb://127.0.0.1/?maxpoolsize=1&waitqueuetimeoutms=2147483647");
+   pool = mongoc_client_pool_new (uri);
+   client = mongoc_client_pool_pop (pool);
+
+   BSON_ASSERT (!bson_thread_create (&thread, pop_thread, pool));
+   WAIT_UNTIL (_mongoc_client_pool_num_waiters (pool) == 1);
+   _mongoc_usleep (50 * 1000);
+   ASSERT_CMPSIZE_T (_mongoc_client_pool_num_waiters (pool), ==, (size_t) 1);
+
+   mongoc_client_pool_push (pool, client);
+   BSON_ASSERT (!bson_thread_join (thread));
+
+   mongoc_uri_destroy (uri);
+   mongoc_client_pool_destroy (pool);
+}
+
+typedef struct {
+   mongoc_client_pool_t *pool;
+   bson_mutex_t mutex;
+   int order[3];
+   int n_served;
+} fifo_test_t;
+
+typedef struct {
+   fifo_test_t *test;
+   int id;
+} fifo_waiter_t;
+
+static void *
+fifo_thread (void *data)
+{
+   fifo_waiter_t *waiter = (fifo_waiter_t *) data;
+   fifo_test_t *test = waiter->test;
+   mongoc_client_t *client;
+
+   client = mongoc_client_pool_pop (test->pool);
+   BSON_ASSERT (client);
+
+   bson_mutex_lock (&test->mutex);
+   test->order[test->n_served++] = waiter->id;
+   bson_mutex_unlock (&test->mutex);
+
+   mongoc_client_pool_push (test->pool, client);
+
+   return NULL;
+}
+
+/* threads waiting for a client are served in the order they began waiting */
+static void
+test_mongoc_client_pool_wait_queue_fifo (void)
+{
+   fifo_test_t test = {0};
+   fifo_waiter_t waiters[3];
+   bson_thread_t threads[3];
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=1");
+   test.pool = mongoc_client_pool_new (uri);
+   bson_mutex_init (&test.mutex);
+   client = mongoc_client_pool_pop (test.pool);
+
+   for (i = 0; i < 3; i++) {
+      waiters[i].test = &test;
+      waiters[i].id = i;
+      BSON_ASSERT (!bson_thread_create (&threads[i], fifo_thread, &waiters[i]));
+      WAIT_UNTIL (_mongoc_client_pool_num_waiters (test.pool) ==
+                  (size_t) i + 1);
+   }
+
+   mongoc_client_pool_push (test.pool, client);
+
+   for (i = 0; i < 3; i++) {
+      BSON_ASSERT (!bson_thread_join (threads[i]));
+   }
+
+   ASSERT_CMPINT (test.n_served, ==, 3);
+   for (i = 0; i < 3; i++) {
+      ASSERT_CMPINT (test.order[i], ==, i);
+   }
+
+   bson_mutex_destroy (&test.mutex);
+   mongoc_uri_destroy (uri);
+   mongoc_client_pool_destroy (test.pool);
+}
+
+
+static future_t *
+_ping (mongoc_client_t *client, bson_error_t *error)
+{
+   return future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, error);
+}
+
+
+static void
+test_mongoc_client_pool_prewarm (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_connection_pool_t *connection_pool;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MIN);
+   mock_server_run (server);
+
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MINIDLECONNECTIONS, 2);
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_HEARTBEATFREQUENCYMS, 500);
+   pool = mongoc_client_pool_new (uri);
+
+   /* the first pop starts opening connections in the background */
+   client = mongoc_client_pool_pop (pool);
+   connection_pool = client->topology->connection_pool;
+   WAIT_UNTIL (_mongoc_connection_pool_n_idle (connection_pool, 1) == 2);
+
+   /* the client takes a warm connection, and another one is opened */
+   future = _ping (client, &error);
+   request = mock_server_receives_command (
+      server, "admin", MONGOC_QUERY_SLAVE_OK, "{'ping': 1}");
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+   WAIT_UNTIL (_mongoc_connection_pool_n_idle (connection_pool, 1) == 2);
+
+   /* a network error closes the idle connections, they're replaced once the
+    * server is checked again */
+   capture_logs (true);
+   future = _ping (client, &error);
+   request = mock_server_receives_command (
+      server, "admin", MONGOC_QUERY_SLAVE_OK, "{'ping': 1}");
+   mock_server_resets (request);
+   BSON_ASSERT (!future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+   ASSERT_CMPSIZE_T (
+      _mongoc_connection_pool_n_idle (connection_pool, 1), <, (size_t) 2);
+   WAIT_UNTIL (_mongoc_connection_pool_n_idle (connection_pool, 1) == 2);
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
 #ifndef MONGOC_ENABLE_SSL
 static void
 test_mongoc_client_pool_ssl_disabled (void)
@@ -351,6 +671,20 @@ test_client_pool_install (TestSuite *suite)
       suite, "/ClientPool/set_max_size", test_mongoc_client_pool_set_max_size);
    TestSuite_Add (
       suite, "/ClientPool/set_min_size", test_mongoc_client_pool_set_min_size);
+   TestSuite_Add (
+      suite, "/ClientPool/threads", test_mongoc_client_pool_threads);
+   TestSuite_Add (suite, "/ClientPool/steal", test_mongoc_client_pool_steal);
+   TestSuite_Add (suite,
+                  "/ClientPool/wait_queue/timeout",
+                  test_mongoc_client_pool_wait_queue_timeout);
+   TestSuite_Add (suite,
+                  "/ClientPool/wait_queue/timeout_max",
+                  test_mongoc_client_pool_wait_queue_timeout_max);
+   TestSuite_Add (suite,
+                  "/ClientPool/wait_queue/fifo",
+                  test_mongoc_client_pool_wait_queue_fifo);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/prewarm", test_mongoc_client_pool_prewarm);
 
    TestSuite_Add (
       suite, "/ClientPool/handshake", test_mongoc_client_pool_handshake);
@@ -3417,6 +3417,7 @@ test_set_ssl_opts (void)
    ASSERT (opts->crl_file == NULL);
    ASSERT (!opts->weak_cert_validation);
    ASSERT (!opts->allow_invalid_hostname);
+   ASSERT (!opts->kernel_tls);
 }
 #endif
 
@@ -316,6 +316,90 @@ test_cluster_command_timeout_pooled (void)
 }
 
 
+/* run a "ping" on @client, return the client port of its connection */
+static uint16_t
+_ping_port (mock_server_t *server, mongoc_client_t *client)
+{
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+   uint16_t port;
+
+   future = future_client_command_simple (
+      client, "db", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_command (
+      server, "db", MONGOC_QUERY_SLAVE_OK, "{'ping': 1}");
+   port = request_get_client_port (request);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   return port;
+}
+
+
+static void
+_test_cluster_connection_pool (bool max_idle)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client_a;
+   mongoc_client_t *client_b;
+   uint16_t port_a, port_b;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_MIN);
+   mock_server_run (server);
+
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   if (max_idle) {
+      mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 1);
+   }
+
+   pool = mongoc_client_pool_new (uri);
+
+   /* two clients checked out at once use separate connections */
+   client_a = mongoc_client_pool_pop (pool);
+   client_b = mongoc_client_pool_pop (pool);
+   port_a = _ping_port (server, client_a);
+   port_b = _ping_port (server, client_b);
+   ASSERT_CMPUINT16 (port_a, !=, port_b);
+
+   /* client_a's connection is shared with client_b once it's pushed */
+   mongoc_client_pool_push (pool, client_a);
+   mongoc_client_pool_push (pool, client_b);
+   client_a = mongoc_client_pool_pop (pool);
+
+   if (max_idle) {
+      _mongoc_usleep (10 * 1000);
+      port_a = _ping_port (server, client_a);
+      ASSERT_CMPUINT16 (port_a, !=, port_b);
+   } else {
+      /* the most recently returned connection is reused */
+      ASSERT_CMPUINT16 (_ping_port (server, client_a), ==, port_b);
+   }
+
+   mongoc_client_pool_push (pool, client_a);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_cluster_connection_pool (void)
+{
+   _test_cluster_connection_pool (false);
+}
+
+
+static void
+test_cluster_connection_pool_max_idle (void)
+{
+   _test_cluster_connection_pool (true);
+}
+
+
 static void
 _test_write_disconnect (void)
 {
@@ -1755,6 +1839,329 @@ test_cmd_on_unknown_serverid (void)
 }
 
 
+static bool
+_reply_buffer_responder (request_t *request, void *data)
+{
+   char *big;
+   char *reply;
+
+   if (!strcmp (request->command_name, "isMaster")) {
+      return false;
+   }
+
+   if (!strcmp (request->command_name, "big") ||
+       !strcmp (request->command_name, "find")) {
+      /* larger than the reply buffer is kept at */
+      big = bson_malloc (2 * 1024 * 1024);
+      memset (big, 'x', 2 * 1024 * 1024 - 1);
+      big[2 * 1024 * 1024 - 1] = '\0';
+      if (!strcmp (request->command_name, "find")) {
+         reply = bson_strdup_printf ("{'ok': 1, 'cursor': {'id': 0, 'ns': "
+                                     "'db.c', 'firstBatch': [{'big': '%s'}]}}",
+                                     big);
+      } else {
+         reply = bson_strdup_printf ("{'ok': 1, 'big': '%s'}", big);
+      }
+      mock_server_replies_simple (request, reply);
+      bson_free (reply);
+      bson_free (big);
+   } else {
+      mock_server_replies_simple (request, "{'ok': 1, 'n': 42}");
+   }
+
+   request_destroy (request);
+   return true;
+}
+
+
+static bool
+_run_reply_buffer_cmd (mongoc_client_t *client,
+                       const char *name,
+                       bool borrow,
+                       bson_t *reply)
+{
+   mongoc_server_stream_t *server_stream;
+   mongoc_cmd_parts_t cmd_parts;
+   bson_error_t error;
+   bool ret;
+
+   server_stream =
+      mongoc_cluster_stream_for_writes (&client->cluster, NULL, NULL, &error);
+   ASSERT_OR_PRINT (server_stream, error);
+
+   mongoc_cmd_parts_init (&cmd_parts,
+                          client,
+                          "db",
+                          MONGOC_QUERY_NONE,
+                          tmp_bson ("{'%s': 1}", name));
+   ASSERT_OR_PRINT (
+      mongoc_cmd_parts_assemble (&cmd_parts, server_stream, &error), error);
+   cmd_parts.assembled.borrow_reply = borrow;
+
+   ret = mongoc_cluster_run_command_monitored (
+      &client->cluster, &cmd_parts.assembled, reply, &error);
+   ASSERT_OR_PRINT (ret, error);
+
+   mongoc_cmd_parts_cleanup (&cmd_parts);
+   mongoc_server_stream_cleanup (server_stream);
+
+   return ret;
+}
+
+
+static bool
+_in_reply_buffer (mongoc_client_t *client, const bson_t *reply)
+{
+   const uint8_t *data = bson_get_data (reply);
+   const mongoc_buffer_t *buffer = &client->cluster.reply_buffer;
+
+   return data >= buffer->data && data < buffer->data + buffer->len;
+}
+
+
+static void
+_reply_buffer_succeeded (const mongoc_apm_command_succeeded_t *event)
+{
+}
+
+
+static void
+test_cluster_reply_buffer (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_apm_callbacks_t *callbacks;
+   bson_t reply;
+   uint8_t *data;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_autoresponds (server, _reply_buffer_responder, NULL, NULL);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+
+   /* a borrowed reply is a view of the cluster's reply buffer */
+   _run_reply_buffer_cmd (client, "ping", true, &reply);
+   ASSERT_MATCH (&reply, "{'n': 42}");
+   BSON_ASSERT (_in_reply_buffer (client, &reply));
+   bson_destroy (&reply);
+   data = client->cluster.reply_buffer.data;
+
+   /* the buffer is kept for the next reply, which is copied */
+   _run_reply_buffer_cmd (client, "ping", false, &reply);
+   ASSERT_MATCH (&reply, "{'n': 42}");
+   BSON_ASSERT (!_in_reply_buffer (client, &reply));
+   BSON_ASSERT (client->cluster.reply_buffer.data == data);
+   bson_destroy (&reply);
+
+   /* APM callbacks may run commands while they read the reply, so it is
+    * copied for them */
+   callbacks = mongoc_apm_callbacks_new ();
+   mongoc_apm_set_command_succeeded_cb (callbacks, _reply_buffer_succeeded);
+   mongoc_client_set_apm_callbacks (client, callbacks, NULL);
+   _run_reply_buffer_cmd (client, "ping", true, &reply);
+   ASSERT_MATCH (&reply, "{'n': 42}");
+   BSON_ASSERT (!_in_reply_buffer (client, &reply));
+   bson_destroy (&reply);
+   mongoc_client_set_apm_callbacks (client, NULL, NULL);
+   mongoc_apm_callbacks_destroy (callbacks);
+
+   /* a large reply grows the buffer, which is released on the next command */
+   _run_reply_buffer_cmd (client, "big", true, &reply);
+   BSON_ASSERT (bson_has_field (&reply, "big"));
+   BSON_ASSERT (_in_reply_buffer (client, &reply));
+   bson_destroy (&reply);
+   ASSERT_CMPSIZE_T (
+      client->cluster.reply_buffer.datalen, >, (size_t) 2 * 1024 * 1024);
+
+   _run_reply_buffer_cmd (client, "ping", true, &reply);
+   ASSERT_MATCH (&reply, "{'n': 42}");
+   ASSERT_CMPSIZE_T (
+      client->cluster.reply_buffer.datalen, <, (size_t) 1024 * 1024);
+   bson_destroy (&reply);
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_cluster_reply_adopt (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_collection_t *collection;
+   mongoc_cursor_t *cursor;
+   const bson_t *doc;
+   bson_t reply;
+   bson_error_t error;
+
+   server = mock_server_with_autoismaster (WIRE_VERSION_OP_MSG);
+   mock_server_autoresponds (server, _reply_buffer_responder, NULL, NULL);
+   mock_server_run (server);
+   client = mongoc_client_new_from_uri (mock_server_get_uri (server));
+
+   /* a large reply takes the buffer it was read into instead of a copy, and
+    * the cluster starts over with a small buffer */
+   _run_reply_buffer_cmd (client, "big", false, &reply);
+   BSON_ASSERT (bson_has_field (&reply, "big"));
+   BSON_ASSERT (!_in_reply_buffer (client, &reply));
+   ASSERT_CMPSIZE_T (
+      client->cluster.reply_buffer.datalen, <, (size_t) 1024 * 1024);
+
+   /* the adopted reply is an ordinary, growable document */
+   BSON_APPEND_INT32 (&reply, "n", 42);
+   ASSERT_MATCH (&reply, "{'ok': 1, 'n': 42}");
+   bson_destroy (&reply);
+
+   /* a cursor's batch is read from the adopted buffer */
+   collection = mongoc_client_get_collection (client, "db", "c");
+   cursor = mongoc_collection_find_with_opts (
+      collection, tmp_bson ("{}"), NULL, NULL);
+   BSON_ASSERT (mongoc_cursor_next (cursor, &doc));
+   BSON_ASSERT (bson_has_field (doc, "big"));
+   ASSERT_CMPSIZE_T (
+      client->cluster.reply_buffer.datalen, <, (size_t) 1024 * 1024);
+   BSON_ASSERT (!mongoc_cursor_next (cursor, &doc));
+   ASSERT_OR_PRINT (!mongoc_cursor_error (cursor, &error), error);
+
+   mongoc_cursor_destroy (cursor);
+   mongoc_collection_destroy (collection);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+#ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
+static void
+test_cluster_compression_threshold (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_t *client;
+   bson_t cmd = BSON_INITIALIZER;
+   char padding[2000];
+   uint8_t *noise;
+   size_t i;
+   future_t *future;
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_new ();
+   mock_server_auto_ismaster (server,
+                              "{'ok': 1.0,"
+                              " 'ismaster': true,"
+                              " 'minWireVersion': 0,"
+                              " 'maxWireVersion': %d,"
+                              " 'compression': ['zlib']}",
+                              WIRE_VERSION_OP_MSG);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_compressors (uri, "zlib");
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_COMPRESSIONTHRESHOLD, 1000);
+   client = mongoc_client_new_from_uri (uri);
+
+   /* a small command is sent uncompressed */
+   future = future_client_command_simple (
+      client, "admin", tmp_bson ("{'ping': 1}"), NULL, NULL, &error);
+   request = mock_server_receives_msg (server, 0, tmp_bson ("{'ping': 1}"));
+   ASSERT_CMPINT ((int) request->opcode, ==, (int) MONGOC_OPCODE_MSG);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+   future_destroy (future);
+
+   /* a buffer grown to compress a large command is not kept */
+   noise = bson_malloc (2 * 1024 * 1024);
+   for (i = 0; i < 2 * 1024 * 1024; i++) {
+      noise[i] = (uint8_t) rand ();
+   }
+   BSON_APPEND_INT32 (&cmd, "ping", 1);
+   BSON_APPEND_BINARY (
+      &cmd, "noise", BSON_SUBTYPE_BINARY, noise, 2 * 1024 * 1024);
+   future = future_client_command_simple (
+      client, "admin", &cmd, NULL, NULL, &error);
+   request = mock_server_receives_request (server);
+   ASSERT_CMPINT ((int) request->opcode, ==, (int) MONGOC_OPCODE_COMPRESSED);
+   mock_server_hangs_up (request);
+   BSON_ASSERT (!future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+   ASSERT_CMPSIZE_T (
+      client->cluster.compress_buffer.datalen, <, (size_t) 1024 * 1024);
+   bson_reinit (&cmd);
+   bson_free (noise);
+
+   /* a large one is compressed */
+   memset (padding, 'a', sizeof padding - 1);
+   padding[sizeof padding - 1] = '\0';
+   BSON_APPEND_INT32 (&cmd, "ping", 1);
+   BSON_APPEND_UTF8 (&cmd, "padding", padding);
+   future = future_client_command_simple (
+      client, "admin", &cmd, NULL, NULL, &error);
+   request = mock_server_receives_request (server);
+   ASSERT_CMPINT ((int) request->opcode, ==, (int) MONGOC_OPCODE_COMPRESSED);
+   mock_server_hangs_up (request);
+   BSON_ASSERT (!future_get_bool (future));
+   future_destroy (future);
+   request_destroy (request);
+
+   bson_destroy (&cmd);
+   mongoc_client_destroy (client);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+#endif
+
+
+static void
+test_cluster_adaptive_compression (void)
+{
+   mongoc_client_t *client;
+   mongoc_cluster_t *cluster;
+   int i;
+
+   client = mongoc_client_new (
+      "mongodb://localhost/?adaptiveCompression=true&compressionThreshold=100");
+   cluster = &client->cluster;
+
+   ASSERT (!_mongoc_cluster_should_compress (cluster, 1, "find", 99));
+   /* not sampled yet */
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "find", 100));
+
+   /* "find" barely compresses on server 1 */
+   _mongoc_cluster_sample_compression (cluster, 1, "find", 1000, 990);
+   for (i = 1; i < 32; i++) {
+      ASSERT (!_mongoc_cluster_should_compress (cluster, 1, "find", 1000));
+   }
+
+   /* the 32nd message is compressed to sample again */
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "find", 1000));
+
+   /* other servers and commands are sampled separately */
+   ASSERT (_mongoc_cluster_should_compress (cluster, 2, "find", 1000));
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "insert", 1000));
+
+   /* one good sample is enough to turn compression back on */
+   _mongoc_cluster_sample_compression (cluster, 1, "find", 1000, 100);
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "find", 1000));
+
+   /* legacy opcodes have no command name */
+   _mongoc_cluster_sample_compression (cluster, 1, NULL, 1000, 1000);
+   ASSERT (!_mongoc_cluster_should_compress (cluster, 1, NULL, 1000));
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "find", 1000));
+
+   mongoc_client_destroy (client);
+
+   /* without adaptive compression, everything above the threshold is
+    * compressed */
+   client = mongoc_client_new ("mongodb://localhost/");
+   cluster = &client->cluster;
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "find", 1));
+   _mongoc_cluster_sample_compression (cluster, 1, "find", 1000, 1000);
+   ASSERT (_mongoc_cluster_should_compress (cluster, 1, "find", 1000));
+   mongoc_client_destroy (client);
+}
+
+
 void
 test_cluster_install (TestSuite *suite)
 {
@@ -1787,12 +2194,22 @@ test_cluster_install (TestSuite *suite)
                       NULL,
                       NULL,
                       test_framework_skip_if_slow);
+   TestSuite_AddMockServerTest (
+      suite, "/Cluster/reply_buffer", test_cluster_reply_buffer);
+   TestSuite_AddMockServerTest (
+      suite, "/Cluster/reply_adopt", test_cluster_reply_adopt);
    TestSuite_AddMockServerTest (suite,
                                 "/Cluster/command/timeout/single",
                                 test_cluster_command_timeout_single);
    TestSuite_AddMockServerTest (suite,
                                 "/Cluster/command/timeout/pooled",
                                 test_cluster_command_timeout_pooled);
+   TestSuite_AddMockServerTest (suite,
+                                "/Cluster/connection_pool",
+                                test_cluster_connection_pool);
+   TestSuite_AddMockServerTest (suite,
+                                "/Cluster/connection_pool/max_idle",
+                                test_cluster_connection_pool_max_idle);
    TestSuite_AddFull (suite,
                       "/Cluster/write_command/disconnect",
                       test_write_command_disconnect,
@@ -1894,4 +2311,12 @@ test_cluster_install (TestSuite *suite)
       suite, "/Cluster/ismaster_on_unknown/mock", test_ismaster_on_unknown);
    TestSuite_AddLive (
       suite, "/Cluster/cmd_on_unknown_serverid", test_cmd_on_unknown_serverid);
+#ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
+   TestSuite_AddMockServerTest (suite,
+                                "/Cluster/compression_threshold",
+                                test_cluster_compression_threshold);
+#endif
+   TestSuite_Add (suite,
+                  "/Cluster/adaptive_compression",
+                  test_cluster_adaptive_compression);
 }
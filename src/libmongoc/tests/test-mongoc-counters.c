@@ -177,6 +177,9 @@ test_counters_op_compressed (void *ctx)
    DIFF_AND_RESET (op_ingress_msg, ==, 1);
    DIFF_AND_RESET (op_ingress_compressed, ==, 1);
    DIFF_AND_RESET (op_ingress_total, ==, 2);
+   DIFF_AND_RESET (compression_bytes_in, >, 0);
+   DIFF_AND_RESET (compression_bytes_out, >, 0);
+   DIFF_AND_RESET (compression_skipped, ==, 0);
    coll = _drop_and_populate_coll (client);
    DIFF_AND_RESET (op_egress_msg, ==, 4);
    DIFF_AND_RESET (op_egress_compressed, ==, 4);
@@ -338,6 +341,73 @@ test_counters_clients (void)
 }
 
 
+static int32_t
+count_client_pool_pops (void)
+{
+   return (int32_t) (count_client_pool_pops_1ms () +
+                     count_client_pool_pops_10ms () +
+                     count_client_pool_pops_100ms () +
+                     count_client_pool_pops_slow ());
+}
+
+
+static void
+test_counters_client_pool_pops (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   int32_t pops;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=1");
+   pool = mongoc_client_pool_new (uri);
+   reset_all_counters ();
+   pops = count_client_pool_pops ();
+
+   client = mongoc_client_pool_pop (pool);
+   mongoc_client_pool_push (pool, client);
+   client = mongoc_client_pool_pop (pool);
+   ASSERT_CMPINT32 (count_client_pool_pops () - pops, ==, 2);
+
+   /* try_pop doesn't count */
+   BSON_ASSERT (!mongoc_client_pool_try_pop (pool));
+   ASSERT_CMPINT32 (count_client_pool_pops () - pops, ==, 2);
+
+   /* a single thread only ever uses its own shard */
+   mongoc_client_pool_push (pool, client);
+   DIFF_AND_RESET (client_pool_steals, ==, 0);
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+
+static void
+test_counters_client_pool_wait (void)
+{
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+
+   uri = mongoc_uri_new (
+      "mongodb://127.0.0.1/?maxpoolsize=1&waitqueuetimeoutms=10");
+   pool = mongoc_client_pool_new (uri);
+   reset_all_counters ();
+
+   client = mongoc_client_pool_pop (pool);
+   DIFF_AND_RESET (client_pool_waits, ==, 0);
+
+   BSON_ASSERT (!mongoc_client_pool_pop (pool));
+   DIFF_AND_RESET (client_pool_waits, ==, 1);
+   DIFF_AND_RESET (client_pool_wait_timeouts, ==, 1);
+   DIFF_AND_RESET (client_pool_wait_msec, >=, 10);
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+
 static void
 test_counters_streams (void *ctx)
 {
@@ -596,6 +666,10 @@ test_counters_install (TestSuite *suite)
                       test_framework_skip_if_auth);
    TestSuite_AddLive (suite, "/counters/cursors", test_counters_cursors);
    TestSuite_AddLive (suite, "/counters/clients", test_counters_clients);
+   TestSuite_Add (
+      suite, "/counters/client_pool_pops", test_counters_client_pool_pops);
+   TestSuite_Add (
+      suite, "/counters/client_pool_wait", test_counters_client_pool_wait);
    TestSuite_AddFull (suite,
                       "/counters/streams",
                       test_counters_streams,
@@ -8,6 +8,7 @@
 
 #include "TestSuite.h"
 #include "mongoc/mongoc-cluster-private.h"
+#include "mongoc/mongoc-compression-private.h"
 
 
 static uint8_t *
@@ -660,6 +661,114 @@ test_mongoc_rpc_buffer_iov (void)
 }
 
 
+static void
+_test_compress_iov (int32_t compressor_id,
+                    int32_t level,
+                    mongoc_iovec_t *iov,
+                    size_t iovcnt,
+                    const char *expected,
+                    size_t expected_len,
+                    mongoc_buffer_t *compressed)
+{
+   mongoc_compression_ctx_t ctx;
+   uint8_t *uncompressed;
+   size_t uncompressed_len = expected_len;
+   size_t datalen;
+   int i;
+
+   uncompressed = bson_malloc (expected_len);
+   mongoc_compression_ctx_init (&ctx);
+
+   /* the second time reuses the output buffer without growing it, and the
+    * compressor state; the third uses temporary state */
+   for (i = 0; i < 3; i++) {
+      datalen = compressed->datalen;
+      _mongoc_buffer_clear (compressed, false);
+      BSON_ASSERT (mongoc_compress_iovec (i < 2 ? &ctx : NULL,
+                                          compressor_id,
+                                          level,
+                                          iov,
+                                          iovcnt,
+                                          16,
+                                          compressed));
+      if (i > 0) {
+         ASSERT_CMPSIZE_T (compressed->datalen, ==, datalen);
+      }
+
+      uncompressed_len = expected_len;
+      BSON_ASSERT (mongoc_uncompress (i < 2 ? &ctx : NULL,
+                                      compressor_id,
+                                      compressed->data,
+                                      compressed->len,
+                                      uncompressed,
+                                      &uncompressed_len));
+      ASSERT_CMPSIZE_T (uncompressed_len, ==, expected_len);
+      ASSERT_MEMCMP (uncompressed, expected, (int) expected_len);
+   }
+
+   mongoc_compression_ctx_destroy (&ctx);
+   bson_free (uncompressed);
+}
+
+
+static void
+test_mongoc_rpc_compress_iov (void)
+{
+   mongoc_buffer_t compressed;
+   mongoc_iovec_t iov[4];
+   char header[20];
+   char *large;
+   char small[5] = "abcd";
+   char *flat;
+   size_t large_len = 200 * 1024;
+   size_t flat_len;
+   size_t i;
+
+   /* a header whose last 4 bytes belong to the message, a large section
+    * spanning several output chunks, an empty one, and a small one */
+   memset (header, 'h', sizeof header);
+   large = bson_malloc (large_len);
+   for (i = 0; i < large_len; i++) {
+      large[i] = (char) ((i * 7) % 251);
+   }
+
+   iov[0].iov_base = header;
+   iov[0].iov_len = sizeof header;
+   iov[1].iov_base = large;
+   iov[1].iov_len = large_len;
+   iov[2].iov_base = small;
+   iov[2].iov_len = 0;
+   iov[3].iov_base = small;
+   iov[3].iov_len = sizeof small;
+
+   flat_len = sizeof header + large_len + sizeof small - 16;
+   flat = bson_malloc (flat_len);
+   ASSERT_CMPSIZE_T (
+      (size_t) _mongoc_cluster_buffer_iovec (iov, 4, 16, flat), ==, flat_len);
+
+   _mongoc_buffer_init (&compressed, NULL, 0, NULL, NULL);
+
+   _test_compress_iov (
+      MONGOC_COMPRESSOR_NOOP_ID, -1, iov, 4, flat, flat_len, &compressed);
+#ifdef MONGOC_ENABLE_COMPRESSION_SNAPPY
+   _test_compress_iov (
+      MONGOC_COMPRESSOR_SNAPPY_ID, -1, iov, 4, flat, flat_len, &compressed);
+#endif
+#ifdef MONGOC_ENABLE_COMPRESSION_ZLIB
+   _test_compress_iov (
+      MONGOC_COMPRESSOR_ZLIB_ID, 6, iov, 4, flat, flat_len, &compressed);
+#endif
+#ifdef MONGOC_ENABLE_COMPRESSION_ZSTD
+   _test_compress_iov (
+      MONGOC_COMPRESSOR_ZSTD_ID, 3, iov, 4, flat, flat_len, &compressed);
+#endif
+
+   _mongoc_buffer_destroy (&compressed);
+   bson_free (flat);
+   bson_free (large);
+}
+
+
 void
 test_rpc_install (TestSuite *suite)
 {
@@ -683,4 +792,5 @@ test_rpc_install (TestSuite *suite)
    TestSuite_Add (suite, "/Rpc/update/gather", test_mongoc_rpc_update_gather);
    TestSuite_Add (suite, "/Rpc/update/scatter", test_mongoc_rpc_update_scatter);
    TestSuite_Add (suite, "/Rpc/buffer/iov", test_mongoc_rpc_buffer_iov);
+   TestSuite_Add (suite, "/Rpc/compress/iov", test_mongoc_rpc_compress_iov);
 }
@@ -75,6 +75,12 @@ test_set_new (void)
    mongoc_set_add (set, 5, items + 5);
    BSON_ASSERT (mongoc_set_get (set, 5) == items + 5);
 
+   BSON_ASSERT (mongoc_set_steal (set, 7) == items + 7);
+   BSON_ASSERT (destroyed == 3);
+   BSON_ASSERT (!mongoc_set_get (set, 7));
+   BSON_ASSERT (!mongoc_set_steal (set, 7));
+   mongoc_set_add (set, 7, items + 7);
+
    mongoc_set_for_each (set, test_set_visit_cb, &visited);
    BSON_ASSERT (visited == 8);
 
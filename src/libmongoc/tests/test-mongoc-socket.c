@@ -450,6 +450,215 @@ test_mongoc_socket_poll_refusal (void *ctx)
 #endif
 }
 
+static void
+_poller_connect (mongoc_socket_t *listen_sock,
+                 struct sockaddr_in *addr,
+                 mongoc_socket_t **client,
+                 mongoc_socket_t **server)
+{
+   *client = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (*client);
+   BSON_ASSERT (0 == mongoc_socket_connect (
+                        *client, (struct sockaddr *) addr, sizeof *addr, -1));
+   *server = mongoc_socket_accept (listen_sock, -1);
+   BSON_ASSERT (*server);
+}
+
+
+static void
+_poller_poll (mongoc_socket_poller_t *poller,
+              mongoc_socket_t **socks,
+              size_t n,
+              int events,
+              ssize_t expected,
+              int *revents)
+{
+   mongoc_socket_poll_t sds[3];
+   size_t i;
+
+   for (i = 0; i < n; i++) {
+      sds[i].socket = socks[i];
+      sds[i].events = events;
+   }
+
+   ASSERT_CMPSSIZE_T (
+      _mongoc_socket_poller_poll (poller, sds, n, 0), ==, expected);
+
+   for (i = 0; i < n; i++) {
+      revents[i] = sds[i].revents & events;
+   }
+}
+
+
+static void
+test_mongoc_socket_poller (void)
+{
+   mongoc_socket_poller_t *poller;
+   mongoc_socket_t *listen_sock;
+   mongoc_socket_t *clients[3];
+   mongoc_socket_t *servers[3];
+   struct sockaddr_in addr = {0};
+   mongoc_socklen_t addr_len = sizeof addr;
+   int revents[3];
+   char buf[2];
+   int i;
+
+   listen_sock = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (listen_sock);
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   ASSERT_CMPINT (0,
+                  ==,
+                  mongoc_socket_bind (
+                     listen_sock, (struct sockaddr *) &addr, sizeof addr));
+   ASSERT_CMPINT (
+      0,
+      ==,
+      mongoc_socket_getsockname (
+         listen_sock, (struct sockaddr *) &addr, &addr_len));
+   ASSERT_CMPINT (0, ==, mongoc_socket_listen (listen_sock, 10));
+
+   for (i = 0; i < 3; i++) {
+      _poller_connect (listen_sock, &addr, &clients[i], &servers[i]);
+   }
+
+   poller = _mongoc_socket_poller_new ();
+
+   /* nothing to read yet, but every socket can be written */
+   _poller_poll (poller, clients, 3, POLLIN, 0, revents);
+   _poller_poll (poller, clients, 3, POLLOUT, 3, revents);
+   ASSERT_CMPINT (revents[0] & revents[1] & revents[2], ==, POLLOUT);
+
+   /* a socket stays ready until it is drained, though it is only readied
+    * once */
+   ASSERT_CMPSSIZE_T (
+      mongoc_socket_send (servers[1], "ab", 2, -1), ==, (ssize_t) 2);
+   _poller_poll (poller, clients, 3, POLLIN, 1, revents);
+   ASSERT_CMPINT (revents[1], ==, POLLIN);
+   ASSERT_CMPSSIZE_T (mongoc_socket_recv (clients[1], buf, 1, 0, -1),
+                      ==,
+                      (ssize_t) 1);
+   _poller_poll (poller, clients, 3, POLLIN, 1, revents);
+   ASSERT_CMPINT (revents[1], ==, POLLIN);
+   ASSERT_CMPSSIZE_T (mongoc_socket_recv (clients[1], buf, 1, 0, -1),
+                      ==,
+                      (ssize_t) 1);
+   _poller_poll (poller, clients, 3, POLLIN, 0, revents);
+
+   /* a socket left out of a poll is reported when it is polled again */
+   ASSERT_CMPSSIZE_T (
+      mongoc_socket_send (servers[2], "a", 1, -1), ==, (ssize_t) 1);
+   _poller_poll (poller, clients, 2, POLLIN, 0, revents);
+   _poller_poll (poller, clients, 3, POLLIN, 1, revents);
+   ASSERT_CMPINT (revents[2], ==, POLLIN);
+   ASSERT_CMPSSIZE_T (mongoc_socket_recv (clients[2], buf, 1, 0, -1),
+                      ==,
+                      (ssize_t) 1);
+
+   /* a new socket, likely with a closed socket's fd, is registered anew */
+   mongoc_socket_destroy (clients[0]);
+   mongoc_socket_destroy (servers[0]);
+   _poller_connect (listen_sock, &addr, &clients[0], &servers[0]);
+   _poller_poll (poller, clients, 3, POLLIN, 0, revents);
+   ASSERT_CMPSSIZE_T (
+      mongoc_socket_send (servers[0], "a", 1, -1), ==, (ssize_t) 1);
+   _poller_poll (poller, clients, 3, POLLIN, 1, revents);
+   ASSERT_CMPINT (revents[0], ==, POLLIN);
+
+   /* a hangup is reported */
+   mongoc_socket_destroy (servers[1]);
+   servers[1] = NULL;
+   _poller_poll (poller, clients, 3, POLLIN, 2, revents);
+   ASSERT_CMPINT (revents[1], ==, POLLIN);
+
+   _mongoc_socket_poller_destroy (poller);
+
+   for (i = 0; i < 3; i++) {
+      mongoc_socket_destroy (clients[i]);
+      if (servers[i]) {
+         mongoc_socket_destroy (servers[i]);
+      }
+   }
+
+   mongoc_socket_destroy (listen_sock);
+}
+
+
+#ifndef _WIN32
+#include <sys/wait.h>
+/* a forked child must not touch the poller's registrations in the parent */
+static void
+test_mongoc_socket_poller_fork (void)
+{
+   mongoc_socket_poller_t *poller;
+   mongoc_socket_t *listen_sock;
+   mongoc_socket_t *clients[2];
+   mongoc_socket_t *servers[2];
+   mongoc_socket_t *child_client;
+   mongoc_socket_t *child_server;
+   struct sockaddr_in addr = {0};
+   mongoc_socklen_t addr_len = sizeof addr;
+   int revents[2];
+   int child_exit_status;
+   pid_t pid;
+   int i;
+
+   listen_sock = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (listen_sock);
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   ASSERT_CMPINT (0,
+                  ==,
+                  mongoc_socket_bind (
+                     listen_sock, (struct sockaddr *) &addr, sizeof addr));
+   ASSERT_CMPINT (
+      0,
+      ==,
+      mongoc_socket_getsockname (
+         listen_sock, (struct sockaddr *) &addr, &addr_len));
+   ASSERT_CMPINT (0, ==, mongoc_socket_listen (listen_sock, 10));
+
+   for (i = 0; i < 2; i++) {
+      _poller_connect (listen_sock, &addr, &clients[i], &servers[i]);
+   }
+
+   poller = _mongoc_socket_poller_new ();
+   _poller_poll (poller, clients, 2, POLLIN, 0, revents);
+
+   pid = fork ();
+   if (pid == 0) {
+      /* poll only a socket of the child's own, which with a shared epoll
+       * instance would unregister the parent's sockets */
+      _poller_connect (listen_sock, &addr, &child_client, &child_server);
+      ASSERT_CMPSSIZE_T (
+         mongoc_socket_send (child_server, "a", 1, -1), ==, (ssize_t) 1);
+      _poller_poll (poller, &child_client, 1, POLLIN, 1, revents);
+      ASSERT_CMPINT (revents[0], ==, POLLIN);
+      mongoc_socket_destroy (child_client);
+      mongoc_socket_destroy (child_server);
+      _exit (0);
+   }
+
+   BSON_ASSERT (-1 != waitpid (pid, &child_exit_status, 0 /* opts */));
+   BSON_ASSERT (0 == child_exit_status);
+
+   /* the parent's sockets are still registered */
+   ASSERT_CMPSSIZE_T (
+      mongoc_socket_send (servers[1], "a", 1, -1), ==, (ssize_t) 1);
+   _poller_poll (poller, clients, 2, POLLIN, 1, revents);
+   ASSERT_CMPINT (revents[1], ==, POLLIN);
+
+   _mongoc_socket_poller_destroy (poller);
+
+   for (i = 0; i < 2; i++) {
+      mongoc_socket_destroy (clients[i]);
+      mongoc_socket_destroy (servers[i]);
+   }
+
+   mongoc_socket_destroy (listen_sock);
+}
+#endif
+
 void
 test_socket_install (TestSuite *suite)
 {
@@ -473,4 +682,8 @@ test_socket_install (TestSuite *suite)
                       NULL,
                       NULL,
                       test_framework_skip_if_slow);
+   TestSuite_Add (suite, "/Socket/poller", test_mongoc_socket_poller);
+#ifndef _WIN32
+   TestSuite_Add (suite, "/Socket/poller/fork", test_mongoc_socket_poller_fork);
+#endif
 }
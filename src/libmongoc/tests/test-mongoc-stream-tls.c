@@ -181,6 +181,31 @@ test_mongoc_tls_basic (void)
 
 
 #ifdef MONGOC_ENABLE_SSL_OPENSSL
+/* kTLS is used if the kernel and OpenSSL support it, otherwise OpenSSL runs
+ * on the socket and encrypts in user space. Both must work. */
+static void
+test_mongoc_tls_kernel_tls (void)
+{
+   mongoc_ssl_opt_t sopt = {0};
+   mongoc_ssl_opt_t copt = {0};
+   ssl_test_result_t sr;
+   ssl_test_result_t cr;
+
+   sopt.ca_file = CERT_CA;
+   sopt.pem_file = CERT_SERVER;
+   sopt.kernel_tls = true;
+
+   copt.ca_file = CERT_CA;
+   copt.pem_file = CERT_CLIENT;
+   copt.kernel_tls = true;
+
+   ssl_test (&copt, &sopt, "localhost", &cr, &sr);
+
+   ASSERT_CMPINT (cr.result, ==, SSL_TEST_SUCCESS);
+   ASSERT_CMPINT (sr.result, ==, SSL_TEST_SUCCESS);
+}
+
+
 static void
 test_mongoc_tls_weak_cert_validation (void)
 {
@@ -412,6 +437,7 @@ test_stream_tls_install (TestSuite *suite)
    TestSuite_Add (
       suite, "/TLS/weak_cert_validation", test_mongoc_tls_weak_cert_validation);
    TestSuite_Add (suite, "/TLS/crl", test_mongoc_tls_crl);
+   TestSuite_Add (suite, "/TLS/kernel_tls", test_mongoc_tls_kernel_tls);
 #endif
 
 #if !defined(__APPLE__) && !defined(_WIN32) && \
@@ -1684,6 +1684,121 @@ test_cluster_time_updated_during_handshake ()
    mongoc_uri_destroy (uri);
 }
 
+static void
+test_snapshot_pooled (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_topology_t *topology;
+   mongoc_topology_snapshot_t *first;
+   mongoc_topology_snapshot_t *second;
+   mongoc_topology_snapshot_t *third;
+   bson_error_t error;
+   char *cluster_time;
+   bson_t *reply;
+
+   uri = mongoc_uri_new ("mongodb://a,b");
+   topology = mongoc_topology_new (uri, false /* single threaded */);
+
+   first = _mongoc_topology_snapshot_acquire (topology);
+   ASSERT_CMPSIZE_T (first->description.servers->items_len, ==, (size_t) 2);
+   BSON_ASSERT (!first->base);
+   BSON_ASSERT (bson_empty (&first->description.cluster_time));
+
+   /* a later clusterTime publishes a snapshot sharing the servers */
+   cluster_time = cluster_time_fmt (1);
+   reply = tmp_bson ("{'ok': 1, '$clusterTime': %s}", cluster_time);
+   _mongoc_topology_update_cluster_time (topology, reply);
+   second = _mongoc_topology_snapshot_acquire (topology);
+   BSON_ASSERT (second != first);
+   BSON_ASSERT (second->base == first);
+   BSON_ASSERT (second->description.servers == first->description.servers);
+   ASSERT_MATCH (&second->description.cluster_time, cluster_time);
+
+   /* a reader's reference stays valid and unchanged */
+   BSON_ASSERT (bson_empty (&first->description.cluster_time));
+   _mongoc_topology_snapshot_release (first);
+
+   /* the same clusterTime publishes nothing */
+   _mongoc_topology_update_cluster_time (topology, reply);
+   third = _mongoc_topology_snapshot_acquire (topology);
+   BSON_ASSERT (third == second);
+   _mongoc_topology_snapshot_release (third);
+
+   /* other changes publish a full copy */
+   bson_set_error (
+      &error, MONGOC_ERROR_STREAM, MONGOC_ERROR_STREAM_SOCKET, "socket error");
+   mongoc_topology_invalidate_server (topology, 1, &error);
+   third = _mongoc_topology_snapshot_acquire (topology);
+   BSON_ASSERT (third != second);
+   BSON_ASSERT (!third->base);
+   ASSERT_MATCH (&third->description.cluster_time, cluster_time);
+   ASSERT_CMPSIZE_T (third->description.servers->items_len, ==, (size_t) 2);
+
+   _mongoc_topology_snapshot_release (second);
+   _mongoc_topology_snapshot_release (third);
+   bson_free (cluster_time);
+   mongoc_topology_destroy (topology);
+   mongoc_uri_destroy (uri);
+}
+
+typedef struct {
+   mongoc_topology_t *topology;
+   volatile int32_t done;
+} snapshot_race_t;
+
+static void *
+snapshot_reader_thread (void *data)
+{
+   snapshot_race_t *race = (snapshot_race_t *) data;
+   mongoc_topology_snapshot_t *snapshot;
+
+   while (!bson_atomic_int_add (&race->done, 0)) {
+      snapshot = _mongoc_topology_snapshot_acquire (race->topology);
+      BSON_ASSERT (snapshot->ref_count > 0);
+      ASSERT_CMPSIZE_T (
+         snapshot->description.servers->items_len, ==, (size_t) 2);
+      _mongoc_topology_snapshot_release (snapshot);
+   }
+
+   return NULL;
+}
+
+/* readers acquire snapshots while each reply's clusterTime publishes one */
+static void
+test_snapshot_pooled_threads (void)
+{
+   mongoc_uri_t *uri;
+   snapshot_race_t race;
+   bson_thread_t threads[8];
+   char *cluster_time;
+   bson_t *reply;
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://a,b");
+   race.topology = mongoc_topology_new (uri, false /* single threaded */);
+   race.done = 0;
+
+   for (i = 0; i < 8; i++) {
+      BSON_ASSERT (
+         !bson_thread_create (&threads[i], snapshot_reader_thread, &race));
+   }
+
+   for (i = 1; i <= 2000; i++) {
+      cluster_time = cluster_time_fmt (i);
+      reply = tmp_bson ("{'ok': 1, '$clusterTime': %s}", cluster_time);
+      _mongoc_topology_update_cluster_time (race.topology, reply);
+      bson_free (cluster_time);
+   }
+
+   bson_atomic_int_add (&race.done, 1);
+   for (i = 0; i < 8; i++) {
+      BSON_ASSERT (!bson_thread_join (threads[i]));
+   }
+
+   mongoc_topology_destroy (race.topology);
+   mongoc_uri_destroy (uri);
+}
+
 /* returns the last time the topology completed a full scan. */
 static int64_t
 _get_last_scan (mongoc_client_t *client)
@@ -2130,6 +2245,10 @@ test_topology_install (TestSuite *suite)
    TestSuite_AddMockServerTest (suite,
                                 "/Topology/handshake/updates_clustertime",
                                 test_cluster_time_updated_during_handshake);
+   TestSuite_Add (suite, "/Topology/snapshot/pooled", test_snapshot_pooled);
+   TestSuite_Add (suite,
+                  "/Topology/snapshot/pooled/threads",
+                  test_snapshot_pooled_threads);
    TestSuite_AddMockServerTest (
       suite, "/Topology/request_scan_on_error", test_request_scan_on_error);
    TestSuite_AddMockServerTest (suite,
@@ -828,6 +828,51 @@ test_mongoc_uri_new_with_error (void)
       MONGOC_ERROR_COMMAND,
       MONGOC_ERROR_COMMAND_INVALID_ARG,
       "Invalid \"zlibcompressionlevel\" of 10: must be between -1 and 9");
+
+   memset (&error, 0, sizeof (bson_error_t));
+   ASSERT (!mongoc_uri_new_with_error (
+      "mongodb://localhost/db?zstdcompressionlevel=23", &error));
+   ASSERT_ERROR_CONTAINS (
+      error,
+      MONGOC_ERROR_COMMAND,
+      MONGOC_ERROR_COMMAND_INVALID_ARG,
+      "Invalid \"zstdcompressionlevel\" of 23: must be between -131072 and 22");
+
+   memset (&error, 0, sizeof (bson_error_t));
+   ASSERT (!mongoc_uri_new_with_error (
+      "mongodb://localhost/db?compressionthreshold=-1", &error));
+   ASSERT_ERROR_CONTAINS (
+      error,
+      MONGOC_ERROR_COMMAND,
+      MONGOC_ERROR_COMMAND_INVALID_ARG,
+      "Invalid \"compressionthreshold\" of -1: must be non-negative");
+
+   memset (&error, 0, sizeof (bson_error_t));
+   ASSERT (!mongoc_uri_new_with_error (
+      "mongodb://localhost/db?maxidletimems=-1", &error));
+   ASSERT_ERROR_CONTAINS (
+      error,
+      MONGOC_ERROR_COMMAND,
+      MONGOC_ERROR_COMMAND_INVALID_ARG,
+      "Invalid \"maxidletimems\" of -1: must be non-negative");
+
+   memset (&error, 0, sizeof (bson_error_t));
+   ASSERT (!mongoc_uri_new_with_error (
+      "mongodb://localhost/db?minidleconnections=-1", &error));
+   ASSERT_ERROR_CONTAINS (
+      error,
+      MONGOC_ERROR_COMMAND,
+      MONGOC_ERROR_COMMAND_INVALID_ARG,
+      "Invalid \"minidleconnections\" of -1: must be non-negative");
+
+   memset (&error, 0, sizeof (bson_error_t));
+   ASSERT (!mongoc_uri_new_with_error (
+      "mongodb://localhost/db?waitqueuetimeoutms=-1", &error));
+   ASSERT_ERROR_CONTAINS (
+      error,
+      MONGOC_ERROR_COMMAND,
+      MONGOC_ERROR_COMMAND_INVALID_ARG,
+      "Invalid \"waitqueuetimeoutms\" of -1: must be non-negative");
 }
 
 
@@ -2316,6 +2361,12 @@ test_mongoc_uri_duplicates (void)
    capture_logs (true);
 
    /* test all URI options, in the order they are defined in mongoc-uri.h. */
+   RECREATE_URI (MONGOC_URI_ADAPTIVECOMPRESSION
+                 "=false&" MONGOC_URI_ADAPTIVECOMPRESSION "=true");
+   ASSERT_LOG_DUPE (MONGOC_URI_ADAPTIVECOMPRESSION);
+   BSON_ASSERT (mongoc_uri_get_option_as_bool (
+      uri, MONGOC_URI_ADAPTIVECOMPRESSION, false));
+
    RECREATE_URI (MONGOC_URI_APPNAME "=a&" MONGOC_URI_APPNAME "=b");
    ASSERT_LOG_DUPE (MONGOC_URI_APPNAME);
    str = mongoc_uri_get_appname (uri);
@@ -2346,6 +2397,12 @@ test_mongoc_uri_duplicates (void)
    BSON_ASSERT (mongoc_uri_get_option_as_bool (
       uri, MONGOC_URI_CANONICALIZEHOSTNAME, false));
 
+   RECREATE_URI (MONGOC_URI_COMPRESSIONTHRESHOLD
+                 "=1&" MONGOC_URI_COMPRESSIONTHRESHOLD "=2");
+   ASSERT_LOG_DUPE (MONGOC_URI_COMPRESSIONTHRESHOLD);
+   BSON_ASSERT (mongoc_uri_get_option_as_int32 (
+                   uri, MONGOC_URI_COMPRESSIONTHRESHOLD, 0) == 2);
+
    RECREATE_URI (MONGOC_URI_CONNECTTIMEOUTMS "=1&" MONGOC_URI_CONNECTTIMEOUTMS
                                              "=2");
    ASSERT_LOG_DUPE (MONGOC_URI_CONNECTTIMEOUTMS);
@@ -2547,6 +2604,12 @@ test_mongoc_uri_duplicates (void)
    BSON_ASSERT (mongoc_uri_get_option_as_int32 (
                    uri, MONGOC_URI_ZLIBCOMPRESSIONLEVEL, 0) == 2);
 
+   RECREATE_URI (MONGOC_URI_ZSTDCOMPRESSIONLEVEL
+                 "=1&" MONGOC_URI_ZSTDCOMPRESSIONLEVEL "=-2");
+   ASSERT_LOG_DUPE (MONGOC_URI_ZSTDCOMPRESSIONLEVEL);
+   BSON_ASSERT (mongoc_uri_get_option_as_int32 (
+                   uri, MONGOC_URI_ZSTDCOMPRESSIONLEVEL, 0) == -2);
+
    mongoc_uri_destroy (uri);
 }
 
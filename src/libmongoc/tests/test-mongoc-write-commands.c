@@ -576,9 +576,71 @@ test_w0_legacy_insert_many (void)
    mock_server_destroy (server);
 }
 
+static void
+test_insert_append_id (void)
+{
+   mongoc_bulk_write_flags_t write_flags = MONGOC_BULK_WRITE_FLAGS_INIT;
+   mongoc_write_command_t command;
+   bson_t *with_id;
+   bson_t *without_id;
+   bson_t *empty;
+   bson_t doc;
+   bson_iter_t iter;
+   const uint8_t *data;
+   uint32_t len;
+   size_t offset;
+
+   with_id = tmp_bson ("{'_id': 1, 'a': 'x'}");
+   without_id = tmp_bson ("{'a': 'y', 'b': {'c': [1, 2]}}");
+   empty = tmp_bson ("{}");
+
+   _mongoc_write_command_init_insert (
+      &command, without_id, NULL, write_flags, 1);
+   _mongoc_write_command_insert_append (&command, with_id);
+   _mongoc_write_command_insert_append (&command, empty);
+   ASSERT_CMPINT (command.n_documents, ==, 3);
+
+   /* a generated _id comes first, followed by the original elements */
+   data = command.payload.data;
+   offset = 0;
+   memcpy (&len, data + offset, 4);
+   BSON_ASSERT (
+      bson_init_static (&doc, data + offset, BSON_UINT32_FROM_LE (len)));
+   BSON_ASSERT (bson_validate (&doc, BSON_VALIDATE_NONE, NULL));
+   BSON_ASSERT (bson_iter_init (&iter, &doc));
+   BSON_ASSERT (bson_iter_next (&iter));
+   ASSERT_CMPSTR (bson_iter_key (&iter), "_id");
+   BSON_ASSERT (BSON_ITER_HOLDS_OID (&iter));
+   ASSERT_MATCH (&doc,
+                 "{'_id': {'$exists': true}, 'a': 'y', 'b': {'c': [1, 2]}}");
+   ASSERT_CMPUINT32 (doc.len, ==, without_id->len + 17);
+
+   /* an existing _id is kept */
+   offset += doc.len;
+   memcpy (&len, data + offset, 4);
+   BSON_ASSERT (
+      bson_init_static (&doc, data + offset, BSON_UINT32_FROM_LE (len)));
+   ASSERT_CMPINT (bson_compare (&doc, with_id), ==, 0);
+
+   offset += doc.len;
+   memcpy (&len, data + offset, 4);
+   BSON_ASSERT (
+      bson_init_static (&doc, data + offset, BSON_UINT32_FROM_LE (len)));
+   BSON_ASSERT (bson_validate (&doc, BSON_VALIDATE_NONE, NULL));
+   ASSERT_CMPUINT32 (bson_count_keys (&doc), ==, 1);
+   BSON_ASSERT (bson_iter_init_find (&iter, &doc, "_id"));
+   BSON_ASSERT (BSON_ITER_HOLDS_OID (&iter));
+
+   ASSERT_CMPSIZE_T (offset + doc.len, ==, command.payload.len);
+
+   _mongoc_write_command_destroy (&command);
+}
+
 void
 test_write_command_install (TestSuite *suite)
 {
+   TestSuite_Add (
+      suite, "/WriteCommand/insert_append_id", test_insert_append_id);
    TestSuite_AddLive (suite, "/WriteCommand/split_insert", test_split_insert);
    TestSuite_AddLive (
       suite, "/WriteCommand/bypass_not_sent", test_bypass_not_sent);